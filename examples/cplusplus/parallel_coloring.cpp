@@ -0,0 +1,144 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/** \brief Speculative graph coloring on several threads
+ * NOTE: Example is mainly intended for developers of CasADi, it requires WITH_OPENMP.
+ * Random sparsity patterns are colored with parallelUnidirectionalColoring and parallelStarColoring
+ * for all vertex orderings, and the colorings are checked: rows sharing a column must have different colors
+ * for the unidirectional coloring, and there may be no two-colored path on four vertices for the star coloring.
+ * Exits with a nonzero status if a coloring is invalid. Set OMP_NUM_THREADS to change the number of threads.
+ *
+ * \author Joel Andersson
+ * \date 2013
+ */
+
+#include "symbolic/casadi.hpp"
+#include <cstdlib>
+
+using namespace CasADi;
+using namespace std;
+
+// Random pattern with a nonzero diagonal and on average nnz_per_row additional nonzeros per row
+CRSSparsity randomPattern(int n, int m, int nnz_per_row, bool symmetric){
+  vector<int> row, col;
+  for(int i=0; i<min(n,m); ++i){
+    row.push_back(i);
+    col.push_back(i);
+  }
+  for(int k=0; k<n*nnz_per_row; ++k){
+    int i = rand() % n, j = rand() % m;
+    row.push_back(i);
+    col.push_back(j);
+    if(symmetric){
+      row.push_back(j);
+      col.push_back(i);
+    }
+  }
+  vector<int> mapping;
+  return sp_triplet(n,m,row,col,mapping);
+}
+
+// Color of each row of A, -1 if the coloring does not cover every row exactly once
+vector<int> getColors(const CRSSparsity& D, int n){
+  vector<int> color(n,-1);
+  for(int c=0; c<D.size1(); ++c){
+    for(int el=D.rowind(c); el<D.rowind(c+1); ++el){
+      int i = D.col(el);
+      if(color[i]>=0) return vector<int>(n,-1);
+      color[i] = c;
+    }
+  }
+  return color;
+}
+
+// Check a unidirectional coloring of the rows of A
+bool checkUnidirectional(const CRSSparsity& A, const CRSSparsity& D){
+  vector<int> color = getColors(D,A.size1());
+  vector<int> owner(A.size2()*D.size1(),-1);
+  for(int i=0; i<A.size1(); ++i){
+    if(color[i]<0) return false;
+    for(int el=A.rowind(i); el<A.rowind(i+1); ++el){
+      int& o = owner[A.col(el)*D.size1()+color[i]];
+      if(o>=0 && o!=i) return false;
+      o = i;
+    }
+  }
+  return true;
+}
+
+// Check a star coloring of the symmetric pattern A
+bool checkStar(const CRSSparsity& A, const CRSSparsity& D){
+  vector<int> color = getColors(D,A.size1());
+  for(int v=0; v<A.size1(); ++v){
+    if(color[v]<0) return false;
+    for(int el1=A.rowind(v); el1<A.rowind(v+1); ++el1){
+      int p1 = A.col(el1);
+      if(p1==v) continue;
+      if(color[p1]==color[v]) return false;
+      for(int el2=A.rowind(p1); el2<A.rowind(p1+1); ++el2){
+        int p2 = A.col(el2);
+        if(p2==p1 || p2==v || color[p2]!=color[v]) continue;
+        for(int el3=A.rowind(p2); el3<A.rowind(p2+1); ++el3){
+          int p3 = A.col(el3);
+          if(p3!=p2 && p3!=p1 && p3!=v && color[p3]==color[p1]) return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]){
+  int nfail = 0;
+  srand(0);
+  for(int k=0; k<20; ++k){
+    int n = 500 + 100*k;
+
+    // Unidirectional coloring of the rows and the columns
+    CRSSparsity A = randomPattern(n,n+k,3,false);
+    CRSSparsity AT = A.transpose();
+    for(int ordering=0; ordering<4; ++ordering){
+      if(!checkUnidirectional(A,A.parallelUnidirectionalColoring(AT,numeric_limits<int>::max(),ordering))){
+        cout << "Invalid unidirectional coloring of the rows, n = " << n << ", ordering " << ordering << endl;
+        nfail++;
+      }
+      if(!checkUnidirectional(AT,AT.parallelUnidirectionalColoring(A,numeric_limits<int>::max(),ordering))){
+        cout << "Invalid unidirectional coloring of the columns, n = " << n << ", ordering " << ordering << endl;
+        nfail++;
+      }
+    }
+
+    // Star coloring
+    CRSSparsity H = randomPattern(n,n,2,true);
+    for(int ordering=0; ordering<4; ++ordering){
+      if(!checkStar(H,H.parallelStarColoring(ordering))){
+        cout << "Invalid star coloring, n = " << n << ", ordering " << ordering << endl;
+        nfail++;
+      }
+    }
+  }
+
+  if(nfail==0){
+    cout << "All colorings are valid." << endl;
+  }
+  return nfail==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
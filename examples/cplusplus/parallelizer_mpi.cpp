@@ -0,0 +1,90 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "symbolic/casadi.hpp"
+#include "symbolic/fx/parallelizer.hpp"
+#include "symbolic/stl_vector_tools.hpp"
+#include <cmath>
+#include <mpi.h>
+
+using namespace std;
+using namespace CasADi;
+
+/** \brief Evaluating a Parallelizer distributed over the processes of an MPI job
+ * Run with e.g. "mpirun -np 4 ./parallelizer_mpi". All processes run the same program,
+ * the inputs and seeds are taken from the first process and the results are available on all processes.
+ * With the argument "user_init", the program initializes and finalizes MPI itself, otherwise CasADi
+ * initializes it and finalizes it at exit.
+ */
+int main(int argc, char* argv[]){
+  bool user_init = argc>1 && string(argv[1])=="user_init";
+  if(user_init) MPI_Init(&argc,&argv);
+  
+  // Tasks of different cost
+  int ntask = 10;
+  vector<FX> funcs(ntask);
+  for(int task=0; task<ntask; ++task){
+    vector<SXMatrix> arg(2);
+    arg[0] = ssym("x",2);
+    arg[1] = ssym("p");
+    SXMatrix f = arg[0];
+    for(int k=0; k<=task; ++k) f = sin(f) + arg[1];
+    funcs[task] = SXFunction(arg,f);
+    funcs[task].init();
+  }
+  
+  // Evaluate with a forward and an adjoint direction, serially and distributed
+  Parallelizer par[2] = {Parallelizer(funcs), Parallelizer(funcs)};
+  par[0].setOption("parallelization","serial");
+  par[1].setOption("parallelization","mpi");
+  par[1].setOption("gather_stats",true);
+  for(int i=0; i<2; ++i){
+    par[i].init();
+    for(int task=0; task<ntask; ++task){
+      par[i].input(2*task).set(0.1*task);
+      par[i].input(2*task+1).set(1.0/(task+1));
+      par[i].fwdSeed(2*task).set(1.0);
+      par[i].fwdSeed(2*task+1).set(0.0);
+      par[i].adjSeed(task).set(1.0);
+    }
+    par[i].evaluate(1,1);
+  }
+  
+  // Compare
+  double err = 0;
+  for(int task=0; task<ntask; ++task){
+    for(int k=0; k<2; ++k){
+      err = max(err,fabs(par[0].output(task).at(k) - par[1].output(task).at(k)));
+      err = max(err,fabs(par[0].fwdSens(task).at(k) - par[1].fwdSens(task).at(k)));
+      err = max(err,fabs(par[0].adjSens(2*task).at(k) - par[1].adjSens(2*task).at(k)));
+    }
+    err = max(err,fabs(par[0].adjSens(2*task+1).at(0) - par[1].adjSens(2*task+1).at(0)));
+  }
+  
+  int rank = par[1].getStat("mpi_rank");
+  int size = par[1].getStat("mpi_size");
+  cout << "process " << rank << " of " << size << ": task allocation " << par[1].getStat("task_allocation") << ", max deviation from serial evaluation " << err << endl;
+  
+  // CasADi must leave the finalization to the program if the program initialized MPI
+  if(user_init) MPI_Finalize();
+  return err < 1e-12 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/** \brief Benchmark of the virtual machines for numerical evaluation of SXFunction
+ * NOTE: Example is mainly intended for developers of CasADi.
+ * Evaluates a large expression graph, a chain of nonlinear mass-spring elements integrated
+ * with explicit Euler steps, with the default (switch) and the threaded interpreter and 
+ * compares the results and the timings.
+ * 
+ * \author Joel Andersson
+ * \date 2013
+ */
+
+#include "symbolic/casadi.hpp"
+#include <ctime>
+
+using namespace CasADi;
+using namespace std;
+
+int main(int argc, char* argv[]){
+  // Size of the problem
+  int n = 200;        // Number of masses
+  int nsteps = 100;   // Number of integrator steps
+  int nrep = 50;      // Number of repeated evaluations
+  
+  // States and parameters
+  SXMatrix x = ssym("x",n);
+  SXMatrix v = ssym("v",n);
+  SXMatrix k = ssym("k",n);
+  
+  // Build up the expression graph
+  SXMatrix xk = x, vk = v;
+  double h = 0.01;
+  for(int s=0; s<nsteps; ++s){
+    SXMatrix ak(n,1,0);
+    for(int i=0; i<n; ++i){
+      SX f = -k.at(i)*xk.at(i) - 0.1*vk.at(i)*vk.at(i)*vk.at(i);
+      if(i>0) f += 0.5*sin(xk.at(i-1)-xk.at(i));
+      if(i<n-1) f += 0.5*sin(xk.at(i+1)-xk.at(i));
+      ak.at(i) = f;
+    }
+    xk = xk + h*vk;
+    vk = vk + h*ak;
+  }
+  vector<SXMatrix> arg(3);
+  arg[0] = x;
+  arg[1] = v;
+  arg[2] = k;
+  vector<SXMatrix> res(2);
+  res[0] = xk;
+  res[1] = vk;
+  
+  // Evaluate with each interpreter
+  const char* interpreters[2] = {"switch","threaded"};
+  vector<DMatrix> xf(2);
+  for(int vm=0; vm<2; ++vm){
+    SXFunction f(arg,res);
+    f.setOption("interpreter",interpreters[vm]);
+    f.init();
+    if(vm==0) cout << "Algorithm size: " << f.getAlgorithmSize() << " operations" << endl;
+    f.setInput(DMatrix(n,1,0.1),0);
+    f.setInput(DMatrix(n,1,0.0),1);
+    f.setInput(DMatrix(n,1,1.0),2);
+    
+    clock_t time1 = clock();
+    for(int r=0; r<nrep; ++r) f.evaluate();
+    clock_t time2 = clock();
+    cout << interpreters[vm] << " interpreter: " << (double(time2 - time1)/CLOCKS_PER_SEC*1000/nrep) << " ms per evaluation" << endl;
+    xf[vm] = f.output(0);
+  }
+  
+  // Make sure that the results are identical
+  double err = 0;
+  for(int i=0; i<n; ++i) err = std::max(err,std::abs(xf[0].at(i)-xf[1].at(i)));
+  cout << "Maximum difference: " << err << endl;
+  
+  return 0;
+}
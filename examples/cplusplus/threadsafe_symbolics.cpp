@@ -0,0 +1,114 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/** \brief Sharing expressions between threads
+ * NOTE: Example is mainly intended for developers of CasADi, it requires WITH_THREADSAFE_SYMBOLICS.
+ * Expression graphs built in the main thread are handed to several threads, which extend them with
+ * new operations and constants, create sparsity patterns and evaluate them, and then release them 
+ * concurrently, so that the last references to the shared nodes are dropped in different threads. 
+ * Exits with a nonzero status if a result differs from the serial one.
+ * 
+ * \author Joel Andersson
+ * \date 2013
+ */
+
+#include "symbolic/casadi.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+using namespace CasADi;
+using namespace std;
+
+// Build a chain of nonlinear operations, deep enough for the non-recursive destructor of the nodes
+SXMatrix buildChain(const SXMatrix& x, int depth, double offset){
+  SXMatrix y = x;
+  for(int k=0; k<depth; ++k){
+    y = sin(y) + (offset + 0.001*k)*y;
+  }
+  return y;
+}
+
+int main(int argc, char* argv[]){
+  int nthreads = 4;   // Number of threads
+  int nrounds = 50;   // Number of expressions handed to the threads
+  int n = 10;         // Size of the expressions
+  int depth = 200;    // Depth of the expressions
+  
+  SXMatrix x = ssym("x",n);
+  atomic<int> nfail(0);
+  
+  // Sorting the algorithm of a function marks the nodes of the graph, so functions of overlapping graphs must be created one at a time
+  mutex init_mutex;
+  
+  for(int r=0; r<nrounds; ++r){
+    // Shared expression, the threads hold the only references once the main thread has released its own
+    SXMatrix* shared = new SXMatrix(buildChain(x,depth,0.5+0.1*(r%3)));
+    
+    // Reference result, evaluated serially
+    SXFunction f_ref(x,*shared);
+    f_ref.init();
+    f_ref.setInput(DMatrix(n,1,0.3));
+    f_ref.evaluate();
+    DMatrix ref = f_ref.output();
+    f_ref = SXFunction();
+    
+    vector<thread> threads;
+    for(int t=0; t<nthreads; ++t){
+      threads.push_back(thread([=,&nfail,&init_mutex](SXMatrix e){
+        // Extend the shared graph with new nodes and constants, which are in the constant cache
+        SXMatrix e2 = buildChain(e,10,1.5+t);
+        
+        // Sparsity patterns, which are in the sparsity cache
+        CRSSparsity sp = sp_tril(n+t%2);
+        SXMatrix e3 = SXMatrix(sp,1.0+0.5*(r%4));
+        
+        // Evaluate the shared part
+        SXFunction f;
+        {
+          lock_guard<mutex> lock(init_mutex);
+          f = SXFunction(x,e);
+          f.init();
+        }
+        f.setInput(DMatrix(n,1,0.3));
+        f.evaluate();
+        for(int i=0; i<n; ++i){
+          if(f.output().at(i)!=ref.at(i)) nfail++;
+        }
+        
+        // All references, including the last ones to the shared nodes, are released here
+      },*shared));
+    }
+    
+    // Release the main thread's reference while the threads are running
+    delete shared;
+    
+    for(int t=0; t<nthreads; ++t) threads[t].join();
+  }
+  
+  if(nfail>0){
+    cout << "threadsafe_symbolics: " << nfail << " results differ" << endl;
+    return 1;
+  }
+  cout << "threadsafe_symbolics: " << nrounds << " shared expressions built and released on " << nthreads << " threads" << endl;
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef DORMAND_PRINCE_INTEGRATOR_HPP
+#define DORMAND_PRINCE_INTEGRATOR_HPP
+
+#include "symbolic/fx/integrator.hpp"
+
+namespace CasADi{
+  
+class DormandPrinceIntegratorInternal;
+  
+/**
+  \brief Adaptive explicit Runge-Kutta integrator
+  ODE integrator based on the embedded Dormand-Prince 5(4) pair with step size control.
+  
+  The right hand side function is evaluated numerically in every stage, no expression graph of
+  the integration is built. Quadratures are integrated along with the states, but are not part of
+  the error control. Forward sensitivities requested with reset() (e.g. by a Simulator) are integrated
+  on the same step sequence using directional derivatives of the right hand side. Output between the 
+  steps is obtained by cubic Hermite interpolation. Algebraic states and backward integration are not supported.
+  
+  The scenarios of evaluateEnsemble share their steps when the right hand side is an SXFunction, each stage 
+  is then evaluated for all scenarios in a single sweep through the algorithm.
+  
+  \author Joel Andersson
+  \date 2013
+*/
+class DormandPrinceIntegrator : public Integrator {
+  public:
+    /** \brief  Default constructor */
+    DormandPrinceIntegrator();
+    
+    /** \brief  Create an integrator for explicit ODEs
+    *   \param f dynamical system
+    * \copydoc scheme_DAEInput
+    * \copydoc scheme_DAEOutput
+    *
+    */
+    explicit DormandPrinceIntegrator(const FX& f, const FX& g=FX());
+
+    /// Access functions of the node
+    DormandPrinceIntegratorInternal* operator->();
+    const DormandPrinceIntegratorInternal* operator->() const;
+
+    /// Check if the node is pointing to the right type of object
+    virtual bool checkNode() const;
+
+    /// Static creator function
+    #ifdef SWIG
+    %callback("%s_cb");
+    #endif
+    static Integrator creator(const FX& f, const FX& g){ return DormandPrinceIntegrator(f,g);}
+    #ifdef SWIG
+    %nocallback;
+    #endif
+    
+};
+
+} // namespace CasADi
+
+#endif //DORMAND_PRINCE_INTEGRATOR_HPP
@@ -0,0 +1,390 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "dormand_prince_integrator_internal.hpp"
+#include "symbolic/stl_vector_tools.hpp"
+#include "symbolic/fx/sx_function_internal.hpp"
+#include <cmath>
+
+using namespace std;
+namespace CasADi{
+
+// Dormand-Prince 5(4) Butcher tableau, the last stage is evaluated at the new solution (first same as last)
+static const double dp_c[7] = {0, 1./5, 3./10, 4./5, 8./9, 1, 1};
+static const double dp_a[7][6] = {
+  {0,                0,               0,              0,             0,                0},
+  {1./5,             0,               0,              0,             0,                0},
+  {3./40,            9./40,           0,              0,             0,                0},
+  {44./45,           -56./15,         32./9,          0,             0,                0},
+  {19372./6561,      -25360./2187,    64448./6561,    -212./729,     0,                0},
+  {9017./3168,       -355./33,        46732./5247,    49./176,       -5103./18656,     0},
+  {35./384,          0,               500./1113,      125./192,      -2187./6784,      11./84}};
+
+// Difference between the fifth and the fourth order solution
+static const double dp_e[7] = {71./57600, 0, -71./16695, 71./1920, -17253./339200, 22./525, -1./40};
+
+DormandPrinceIntegratorInternal::DormandPrinceIntegratorInternal(const FX& f, const FX& g) : IntegratorInternal(f,g){
+  addOption("abstol",                        OT_REAL,     1e-8,  "Absolute tolerance for the states");
+  addOption("reltol",                        OT_REAL,     1e-6,  "Relative tolerance for the states");
+  addOption("max_num_steps",                 OT_INTEGER,  10000, "Maximum number of steps, accepted or rejected");
+  addOption("initial_step_size",             OT_REAL,     0.0,   "Size of the first step, 0 for automatic");
+  addOption("max_step_size",                 OT_REAL,     0.0,   "Maximum step size, 0 for no limit");
+  addOption("safety_factor",                 OT_REAL,     0.9,   "Safety factor of the step size prediction");
+  addOption("min_step_factor",               OT_REAL,     0.2,   "Smallest factor by which the step size may decrease");
+  addOption("max_step_factor",               OT_REAL,     10.0,  "Largest factor by which the step size may increase");
+  addOption("ensemble_shared_steps",         OT_BOOLEAN,  true,  "Integrate the scenarios of evaluateEnsemble together, with a common step size and one batched evaluation "
+                                                                   "of the right hand side per stage (SXFunction right hand sides only)");
+}
+
+DormandPrinceIntegratorInternal::~DormandPrinceIntegratorInternal(){
+}
+
+void DormandPrinceIntegratorInternal::init(){
+  // Call the base class init
+  IntegratorInternal::init();
+  casadi_assert_message(nz_==0, "DormandPrinceIntegrator: algebraic states not supported.");
+  casadi_assert_message(nrx_==0, "DormandPrinceIntegrator: backward integration not supported.");
+  
+  // Read options
+  abstol_ = getOption("abstol");
+  reltol_ = getOption("reltol");
+  max_num_steps_ = getOption("max_num_steps");
+  h_init_ = getOption("initial_step_size");
+  h_max_ = getOption("max_step_size");
+  safety_ = getOption("safety_factor");
+  fac_min_ = getOption("min_step_factor");
+  fac_max_ = getOption("max_step_factor");
+  ensemble_shared_steps_ = getOption("ensemble_shared_steps");
+  
+  // Number of forward directions of the right hand side function, at least one is needed for the sensitivities
+  if(int(f_.getOption("number_of_fwd_dir"))<1) f_.requestNumSens(1,0);
+  nfdir_f_ = f_.getOption("number_of_fwd_dir");
+  casadi_assert_message(nfdir_f_>0, "DormandPrinceIntegrator: the right hand side function must allow at least one forward direction, check its option \"max_number_of_fwd_dir\"");
+  
+  // States followed by quadratures
+  nw_ = nx_ + nq_;
+}
+  
+void DormandPrinceIntegratorInternal::evalRHS(double t, const std::vector<double>& w, std::vector<double>& k){
+  // Pass the state
+  f_.setInput(t,DAE_T);
+  f_.input(DAE_X).setArray(getPtr(w),nx_);
+  f_.setInput(input(INTEGRATOR_P),DAE_P);
+  
+  // Calculate the forward sensitivities, nfdir_f_ directions at a time
+  int j=0;
+  do{
+    int nfdir = std::min(nfdir_f_,nsens_-j);
+    for(int dir=0; dir<nfdir; ++dir){
+      f_.fwdSeed(DAE_T,dir).setZero();
+      f_.fwdSeed(DAE_X,dir).setArray(getPtr(w)+(j+dir+1)*nw_,nx_);
+      f_.setFwdSeed(fwdSeed(INTEGRATOR_P,j+dir),DAE_P,dir);
+    }
+    f_.evaluate(nfdir,0);
+    for(int dir=0; dir<nfdir; ++dir){
+      f_.fwdSens(DAE_ODE,dir).getArray(getPtr(k)+(j+dir+1)*nw_,nx_);
+      if(nq_>0) f_.fwdSens(DAE_QUAD,dir).getArray(getPtr(k)+(j+dir+1)*nw_+nx_,nq_);
+    }
+    j += nfdir;
+  } while(j<nsens_);
+  
+  // Get the nondifferentiated result
+  f_.output(DAE_ODE).getArray(getPtr(k),nx_);
+  if(nq_>0) f_.output(DAE_QUAD).getArray(getPtr(k)+nx_,nq_);
+  num_rhs_evals_++;
+}
+
+void DormandPrinceIntegratorInternal::reset(int nsens, int nsensB, int nsensB_store){
+  // Call the base class method
+  IntegratorInternal::reset(nsens,nsensB,nsensB_store);
+  casadi_assert_message(nsensB==0, "DormandPrinceIntegrator: backward integration not supported.");
+  
+  // Allocate memory for the state and the stages
+  int nwtot = nw_*(1+nsens_);
+  w_.resize(nwtot);
+  w_prev_.resize(nwtot);
+  w_stage_.resize(nwtot);
+  k_prev_.resize(nwtot);
+  for(int s=0; s<7; ++s) k_[s].resize(nwtot);
+  
+  // Initial state, zero quadratures and initial sensitivities
+  std::fill(w_.begin(),w_.end(),0);
+  input(INTEGRATOR_X0).getArray(getPtr(w_),nx_);
+  for(int dir=0; dir<nsens_; ++dir){
+    fwdSeed(INTEGRATOR_X0,dir).getArray(getPtr(w_)+(dir+1)*nw_,nx_);
+  }
+  t_ = t_prev_ = t0_;
+  num_steps_ = num_rejected_ = num_rhs_evals_ = 0;
+  
+  // Derivative at the initial time
+  evalRHS(t_,w_,k_[0]);
+
+  // Initial step size
+  if(h_init_>0){
+    h_ = h_init_;
+  } else {
+    // Ratio between the scaled norms of the state and its derivative
+    double d0=0, d1=0;
+    for(int i=0; i<nx_; ++i){
+      double sc = abstol_ + reltol_*fabs(w_[i]);
+      d0 += (w_[i]/sc)*(w_[i]/sc);
+      d1 += (k_[0][i]/sc)*(k_[0][i]/sc);
+    }
+    d0 = sqrt(d0/std::max(nx_,1));
+    d1 = sqrt(d1/std::max(nx_,1));
+    h_ = (d0<1e-5 || d1<1e-5) ? 1e-6 : 0.01*d0/d1;
+  }
+  h_ = std::min(h_,tf_-t0_);
+  if(h_max_>0) h_ = std::min(h_,h_max_);
+  
+  // Output at the initial time
+  setOutputs(t0_);
+}
+
+void DormandPrinceIntegratorInternal::step(){
+  int nwtot = w_.size();
+  while(true){
+    casadi_assert_message(num_steps_+num_rejected_<max_num_steps_, "DormandPrinceIntegrator: maximum number of steps (" << max_num_steps_ << ") reached at t = " << t_);
+    
+    // Do not step past the end of the time horizon
+    bool last = t_+h_ >= tf_;
+    double h = last ? tf_-t_ : h_;
+    
+    // Evaluate the stages, the last stage state is the new solution
+    for(int s=1; s<7; ++s){
+      w_stage_ = w_;
+      for(int j=0; j<s; ++j){
+        double ha = h*dp_a[s][j];
+        if(ha==0) continue;
+        const vector<double>& kj = k_[j];
+        for(int i=0; i<nwtot; ++i) w_stage_[i] += ha*kj[i];
+      }
+      evalRHS(t_+dp_c[s]*h,w_stage_,k_[s]);
+    }
+    
+    // Scaled root mean square norm of the error estimate of the states
+    double err = 0;
+    for(int i=0; i<nx_; ++i){
+      double e = 0;
+      for(int s=0; s<7; ++s) e += dp_e[s]*k_[s][i];
+      e *= h/(abstol_ + reltol_*std::max(fabs(w_[i]),fabs(w_stage_[i])));
+      err += e*e;
+    }
+    err = sqrt(err/std::max(nx_,1));
+    
+    if(err<=1){
+      // Accept the step
+      t_prev_ = t_;
+      t_ = last ? tf_ : t_+h;
+      w_prev_.swap(w_);
+      w_.swap(w_stage_);
+      k_prev_.swap(k_[0]);
+      k_[0].swap(k_[6]);
+      num_steps_++;
+      
+      // Step size for the next step, unless limited by the end of the time horizon
+      if(!last) h_ = h*stepFactor(err);
+      if(h_max_>0) h_ = std::min(h_,h_max_);
+      return;
+    } else {
+      // Reject the step
+      num_rejected_++;
+      h_ = h*std::min(1.0,stepFactor(err));
+    }
+  }
+}
+
+double DormandPrinceIntegratorInternal::stepFactor(double err) const{
+  double fac = err==0 ? fac_max_ : safety_*pow(err,-0.2);
+  return std::min(fac_max_,std::max(fac_min_,fac));
+}
+
+void DormandPrinceIntegratorInternal::setOutputs(double t_out){
+  int nwtot = w_.size();
+  
+  // Cubic Hermite interpolation in the last step
+  const double* w = getPtr(w_);
+  if(t_out<t_){
+    double h = t_-t_prev_;
+    double th = (t_out-t_prev_)/h;
+    double h00 = (1+2*th)*(1-th)*(1-th), h10 = th*(1-th)*(1-th), h01 = th*th*(3-2*th), h11 = th*th*(th-1);
+    for(int i=0; i<nwtot; ++i){
+      w_stage_[i] = h00*w_prev_[i] + h*h10*k_prev_[i] + h01*w_[i] + h*h11*k_[0][i];
+    }
+    w = getPtr(w_stage_);
+  }
+  
+  // Pass to the outputs
+  output(INTEGRATOR_XF).setArray(w,nx_);
+  if(nq_>0) output(INTEGRATOR_QF).setArray(w+nx_,nq_);
+  for(int dir=0; dir<nsens_; ++dir){
+    fwdSens(INTEGRATOR_XF,dir).setArray(w+(dir+1)*nw_,nx_);
+    if(nq_>0) fwdSens(INTEGRATOR_QF,dir).setArray(w+(dir+1)*nw_+nx_,nq_);
+  }
+}
+
+void DormandPrinceIntegratorInternal::integrate(double t_out){
+  casadi_assert_message(t_out<=tf_, "DormandPrinceIntegrator::integrate: cannot integrate past the end of the time horizon, tf = " << tf_);
+  casadi_assert_message(t_out>=t_prev_, "DormandPrinceIntegrator::integrate: output times must be increasing");
+  
+  // Step until t_out is in the last step
+  while(t_<t_out) step();
+  
+  // Get the solution at t_out
+  setOutputs(t_out);
+  
+  // Save statistics
+  stats_["num_steps"] = num_steps_;
+  stats_["num_rejected_steps"] = num_rejected_;
+  stats_["num_rhs_evals"] = num_rhs_evals_;
+}
+
+void DormandPrinceIntegratorInternal::evalRHSEnsemble(int nscen, double t, const std::vector<double>& w, const DMatrix& p, std::vector<double>& k){
+  // Arguments and results, one row per nonzero and one column per scenario
+  t_ensemble_.resize(nscen);
+  std::fill(t_ensemble_.begin(),t_ensemble_.end(),t);
+  const double* arg[DAE_NUM_IN];
+  arg[DAE_X] = getPtr(w);
+  arg[DAE_Z] = 0;
+  arg[DAE_P] = p.size()>0 ? getPtr(p.data()) : 0;
+  arg[DAE_T] = getPtr(t_ensemble_);
+  double* res[DAE_NUM_OUT];
+  res[DAE_ODE] = getPtr(k);
+  res[DAE_ALG] = 0;
+  res[DAE_QUAD] = nq_>0 ? getPtr(k)+nx_*nscen : 0;
+  
+  // Walk the algorithm once for all scenarios
+  static_cast<SXFunctionInternal*>(f_.get())->evaluateBatch(nscen,arg,res);
+  num_rhs_evals_++;
+}
+
+void DormandPrinceIntegratorInternal::evaluateEnsemble(const DMatrix& x0, const DMatrix& p, DMatrix& xf, DMatrix& qf){
+  // Independent integrations unless the right hand side can be evaluated for all scenarios at once
+  if(!ensemble_shared_steps_ || !is_a<SXFunction>(f_)){
+    IntegratorInternal::evaluateEnsemble(x0,p,xf,qf);
+    return;
+  }
+  casadi_assert_message(f_.output(DAE_QUAD).dense(), "DormandPrinceIntegrator::evaluateEnsemble: quadratures must be dense");
+  
+  // States followed by quadratures, one row per component and one column per scenario
+  int nscen = x0.size2();
+  int nwtot = nw_*nscen;
+  w_.resize(nwtot);
+  w_stage_.resize(nwtot);
+  for(int s=0; s<7; ++s) k_[s].resize(nwtot);
+  std::copy(x0.data().begin(),x0.data().end(),w_.begin());
+  std::fill(w_.begin()+nx_*nscen,w_.end(),0);
+  t_ = t0_;
+  num_steps_ = num_rejected_ = num_rhs_evals_ = 0;
+  
+  // Derivative at the initial time
+  evalRHSEnsemble(nscen,t_,w_,p,k_[0]);
+  
+  // Initial step size, the smallest one of all scenarios
+  if(h_init_>0){
+    h_ = h_init_;
+  } else {
+    h_ = tf_-t0_;
+    for(int j=0; j<nscen; ++j){
+      double d0=0, d1=0;
+      for(int i=0; i<nx_; ++i){
+        double sc = abstol_ + reltol_*fabs(w_[i*nscen+j]);
+        d0 += (w_[i*nscen+j]/sc)*(w_[i*nscen+j]/sc);
+        d1 += (k_[0][i*nscen+j]/sc)*(k_[0][i*nscen+j]/sc);
+      }
+      d0 = sqrt(d0/std::max(nx_,1));
+      d1 = sqrt(d1/std::max(nx_,1));
+      h_ = std::min(h_, (d0<1e-5 || d1<1e-5) ? 1e-6 : 0.01*d0/d1);
+    }
+  }
+  h_ = std::min(h_,tf_-t0_);
+  if(h_max_>0) h_ = std::min(h_,h_max_);
+  
+  // Step with the step size required by the scenario with the largest error
+  vector<double> err_scen(nscen);
+  while(t_<tf_){
+    casadi_assert_message(num_steps_+num_rejected_<max_num_steps_, "DormandPrinceIntegrator: maximum number of steps (" << max_num_steps_ << ") reached at t = " << t_);
+    bool last = t_+h_ >= tf_;
+    double h = last ? tf_-t_ : h_;
+    
+    // Evaluate the stages
+    for(int s=1; s<7; ++s){
+      w_stage_ = w_;
+      for(int j=0; j<s; ++j){
+        double ha = h*dp_a[s][j];
+        if(ha==0) continue;
+        const vector<double>& kj = k_[j];
+        for(int i=0; i<nwtot; ++i) w_stage_[i] += ha*kj[i];
+      }
+      evalRHSEnsemble(nscen,t_+dp_c[s]*h,w_stage_,p,k_[s]);
+    }
+    
+    // Largest scaled root mean square norm of the error estimate
+    std::fill(err_scen.begin(),err_scen.end(),0);
+    for(int i=0; i<nx_*nscen; ++i){
+      double e = 0;
+      for(int s=0; s<7; ++s) e += dp_e[s]*k_[s][i];
+      e *= h/(abstol_ + reltol_*std::max(fabs(w_[i]),fabs(w_stage_[i])));
+      err_scen[i%nscen] += e*e;
+    }
+    double err = 0;
+    for(int j=0; j<nscen; ++j) err = std::max(err,err_scen[j]);
+    err = sqrt(err/std::max(nx_,1));
+    
+    if(err<=1){
+      t_ = last ? tf_ : t_+h;
+      w_.swap(w_stage_);
+      k_[0].swap(k_[6]);
+      num_steps_++;
+      if(!last) h_ = h*stepFactor(err);
+      if(h_max_>0) h_ = std::min(h_,h_max_);
+    } else {
+      num_rejected_++;
+      h_ = h*std::min(1.0,stepFactor(err));
+    }
+  }
+  
+  // Get the results
+  std::copy(w_.begin(),w_.begin()+nx_*nscen,xf.data().begin());
+  std::copy(w_.begin()+nx_*nscen,w_.end(),qf.data().begin());
+  
+  // Save statistics
+  stats_["num_steps"] = num_steps_;
+  stats_["num_rejected_steps"] = num_rejected_;
+  stats_["num_rhs_evals"] = num_rhs_evals_;
+}
+
+void DormandPrinceIntegratorInternal::resetB(){
+  casadi_error("DormandPrinceIntegrator: backward integration not supported.");
+}
+
+void DormandPrinceIntegratorInternal::integrateB(double t_out){
+  casadi_error("DormandPrinceIntegrator: backward integration not supported.");
+}
+
+void DormandPrinceIntegratorInternal::printStats(std::ostream &stream) const{
+  stream << "number of accepted steps:                  " << num_steps_ << std::endl;
+  stream << "number of rejected steps:                  " << num_rejected_ << std::endl;
+  stream << "number of right hand side evaluations:     " << num_rhs_evals_ << std::endl;
+}
+
+} // namespace CasADi
@@ -0,0 +1,123 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef DORMAND_PRINCE_INTEGRATOR_INTERNAL_HPP
+#define DORMAND_PRINCE_INTEGRATOR_INTERNAL_HPP
+
+#include "dormand_prince_integrator.hpp"
+#include "symbolic/fx/integrator_internal.hpp"
+
+namespace CasADi{
+    
+class DormandPrinceIntegratorInternal : public IntegratorInternal{
+
+public:
+  
+  /// Constructor
+  explicit DormandPrinceIntegratorInternal(const FX& f, const FX& g);
+
+  /// Clone
+  virtual DormandPrinceIntegratorInternal* clone() const{ return new DormandPrinceIntegratorInternal(*this);}
+
+  /// Create a new integrator
+  virtual DormandPrinceIntegratorInternal* create(const FX& f, const FX& g) const{ return new DormandPrinceIntegratorInternal(f,g);}
+  
+  /// Destructor
+  virtual ~DormandPrinceIntegratorInternal();
+
+  /// Initialize stage
+  virtual void init();
+  
+  /// Reset the forward problem and bring the time back to t0
+  virtual void reset(int nsens, int nsensB, int nsensB_store);
+
+  /// Reset the backward problem and take time to tf
+  virtual void resetB();
+
+  ///  Integrate until a specified time point
+  virtual void integrate(double t_out);
+
+  /// Integrate backward in time until a specified time point
+  virtual void integrateB(double t_out);
+
+  /// Print solver statistics
+  virtual void printStats(std::ostream &stream) const;
+  
+  /// Integrate an ensemble of scenarios with shared steps and batched right hand side evaluations
+  virtual void evaluateEnsemble(const DMatrix& x0, const DMatrix& p, DMatrix& xf, DMatrix& qf);
+  
+  /// Take one accepted step, retrying with smaller step sizes if needed
+  void step();
+  
+  /// Evaluate the ODE right hand side and quadratures, and their forward sensitivities, for all blocks of w
+  void evalRHS(double t, const std::vector<double>& w, std::vector<double>& k);
+  
+  /// Pass the state at t_out, interpolating in the last step, to the outputs
+  void setOutputs(double t_out);
+  
+  /// Evaluate the ODE right hand side and quadratures for all scenarios of an ensemble in one sweep
+  void evalRHSEnsemble(int nscen, double t, const std::vector<double>& w, const DMatrix& p, std::vector<double>& k);
+  
+  /// Factor by which to multiply the step size, given the scaled error
+  double stepFactor(double err) const;
+  
+  /// Tolerances
+  double abstol_, reltol_;
+  
+  /// Step size control
+  double h_init_, h_max_, safety_, fac_min_, fac_max_;
+  int max_num_steps_;
+  
+  /// Let the scenarios of an ensemble share the steps
+  bool ensemble_shared_steps_;
+  
+  /// Number of forward directions of the right hand side function
+  int nfdir_f_;
+  
+  /// Length of a block: states followed by quadratures. The nondifferentiated block is followed by a block for each sensitivity
+  int nw_;
+  
+  /// Current time, start of the last step and step size of the next step
+  double t_, t_prev_, h_;
+  
+  /// Solution at t_ and at t_prev_, with all blocks
+  std::vector<double> w_, w_prev_;
+  
+  /// Stage derivatives, the first one is the derivative at t_
+  std::vector<double> k_[7];
+  
+  /// Derivative at t_prev_
+  std::vector<double> k_prev_;
+  
+  /// Stage state
+  std::vector<double> w_stage_;
+  
+  /// Time of each scenario of an ensemble
+  std::vector<double> t_ensemble_;
+  
+  /// Statistics
+  int num_steps_, num_rejected_, num_rhs_evals_;
+};
+
+} // namespace CasADi
+
+#endif //DORMAND_PRINCE_INTEGRATOR_INTERNAL_HPP
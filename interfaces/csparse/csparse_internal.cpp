@@ -27,6 +27,9 @@ using namespace std;
 namespace CasADi{
 
 CSparseInternal::CSparseInternal(const CRSSparsity& sparsity)  : LinearSolverInternal(sparsity){
+  addOption("refactorize",      OT_BOOLEAN, false, "Keep the pivot sequence and the structure of L and U of the previous factorization, factorizing from scratch only when a pivot has become too small");
+  addOption("refactorize_tol",  OT_REAL,    1e-6,  "A refactorization is rejected if a pivot is smaller than this tolerance times the largest entry in its column");
+  addOption("nrhs_block",       OT_INTEGER, 8,     "Number of right hand sides solved together");
   N_ = 0;
   S_ = 0;
 }
@@ -51,8 +54,22 @@ void CSparseInternal::init(){
   AT_.x = &input().front(); // row indices, size nzmax
   AT_.nz = -1; // of entries in triplet matrix, -1 for compressed-col 
 
+  // Read options
+  refactorize_ = getOption("refactorize");
+  refactorize_tol_ = getOption("refactorize_tol");
+  nrhs_block_ = getOption("nrhs_block");
+  casadi_assert_message(nrhs_block_>0,"CSparseInternal::init: \"nrhs_block\" must be positive");
+
   // Temporary
-  temp_.resize(AT_.n);
+  temp_.resize(AT_.n*nrhs_block_);
+  work_.resize(AT_.n);
+  
+  // Discard the factorizations of a previous initialization
+  if(N_){
+    cs_nfree(N_);
+    N_ = 0;
+  }
+  n_factorizations_ = n_refactorizations_ = 0;
   
   // Has the routine been called once
   called_once_ = false;
@@ -73,20 +90,22 @@ void CSparseInternal::prepare(){
   prepared_ = false;
   called_once_ = true;
   
-  // Get a referebce to the nonzeros of the linear system
-  const vector<double>& linsys_nz = input().data();
-  
   // Make sure that all entries of the linear system are valid
-  for(int k=0; k<linsys_nz.size(); ++k){
-	casadi_assert_message(!isnan(linsys_nz[k]),"Nonzero " << k << " is not-a-number");
-	casadi_assert_message(!isinf(linsys_nz[k]),"Nonzero " << k << " is infinite");
-  }
+  checkFinite();
   
   if(verbose()){
 	cout << "CSparseInternal::prepare: numeric factorization" << endl;
 	cout << "linear system to be factorized = " << endl;
 	input(0).printSparse();
   }
+  
+  // Try to reuse the previous factorization
+  if(refactorize_ && N_!=0 && refactorize()){
+    n_refactorizations_++;
+    stats_["n_refactorizations"] = n_refactorizations_;
+    prepared_ = true;
+    return;
+  }
 
   double tol = 1e-8;
   
@@ -114,30 +133,151 @@ void CSparseInternal::prepare(){
     }
   }
   casadi_assert(N_!=0);
+  n_factorizations_++;
+  stats_["n_factorizations"] = n_factorizations_;
 
   prepared_ = true;
 }
+
+void CSparseInternal::checkFinite() const{
+  const vector<double>& linsys_nz = input().data();
+  
+  // A product with zero is not-a-number exactly if the nonzero is not-a-number or infinite
+  double test = 0;
+  for(vector<double>::const_iterator it=linsys_nz.begin(); it!=linsys_nz.end(); ++it){
+    test += 0*(*it);
+  }
+  if(test==0) return;
+  
+  // Locate the offending nonzero
+  for(int k=0; k<linsys_nz.size(); ++k){
+	casadi_assert_message(!isnan(linsys_nz[k]),"Nonzero " << k << " is not-a-number");
+	casadi_assert_message(!isinf(linsys_nz[k]),"Nonzero " << k << " is infinite");
+  }
+}
+
+bool CSparseInternal::refactorize(){
+  int n = AT_.n;
+  const int *Ap = AT_.p, *Ai = AT_.i;
+  const double *Ax = AT_.x;
+  const int *q = S_->q, *pinv = N_->pinv;
+  const int *Lp = N_->L->p, *Li = N_->L->i, *Up = N_->U->p, *Ui = N_->U->i;
+  double *Lx = N_->L->x, *Ux = N_->U->x;
+  double *x = &work_.front();
+  
+  // Left-looking LU with the pivot sequence of the previous factorization: the entries of U(:,k) are stored in 
+  // topological order with the diagonal last, the rows of L are already permuted and the diagonal, 1, is stored first
+  for(int k=0; k<n; ++k){
+    // Scatter column k of the permuted matrix
+    for(int p=Up[k]; p<Up[k+1]; ++p) x[Ui[p]] = 0;
+    for(int p=Lp[k]; p<Lp[k+1]; ++p) x[Li[p]] = 0;
+    int col = q ? q[k] : k;
+    for(int p=Ap[col]; p<Ap[col+1]; ++p) x[pinv[Ai[p]]] = Ax[p];
+    
+    // Sparse triangular solve with the columns of L to the left
+    for(int p=Up[k]; p<Up[k+1]-1; ++p){
+      int j = Ui[p];
+      double ujk = Ux[p] = x[j];
+      for(int pp=Lp[j]+1; pp<Lp[j+1]; ++pp){
+        x[Li[pp]] -= Lx[pp]*ujk;
+      }
+    }
+    
+    // Reject the pivot if it has become too small
+    double pivot = x[k];
+    double amax = fabs(pivot);
+    for(int p=Lp[k]+1; p<Lp[k+1]; ++p) amax = std::max(amax,fabs(x[Li[p]]));
+    if(!(fabs(pivot) > refactorize_tol_*amax)){
+      if(verbose()){
+        cout << "CSparseInternal::refactorize: pivot " << k << " too small, factorizing from scratch" << endl;
+      }
+      return false;
+    }
+    
+    // Divide by pivot
+    Ux[Up[k+1]-1] = pivot;
+    for(int p=Lp[k]+1; p<Lp[k+1]; ++p) Lx[p] = x[Li[p]]/pivot;
+  }
+  return true;
+}
   
 void CSparseInternal::solve(double* x, int nrhs, bool transpose){
   casadi_assert(prepared_);
   casadi_assert(N_!=0);
   
+  int n = AT_.n;
+  const int *q = S_->q, *pinv = N_->pinv;
+  const int *Lp = N_->L->p, *Li = N_->L->i, *Up = N_->U->p, *Ui = N_->U->i;
+  const double *Lx = N_->L->x, *Ux = N_->U->x;
   double *t = &temp_.front();
   
-  for(int k=0; k<nrhs; ++k){
+  // Solve for nb right hand sides at a time, interleaved in t so that each column of L and U is traversed once per block
+  for(int k=0; k<nrhs; k+=nrhs_block_){
+    int nb = std::min(nrhs_block_,nrhs-k);
     if(transpose){
-      cs_ipvec (N_->pinv, x, t, AT_.n) ;   // t = P1\b
-      cs_lsolve (N_->L, t) ;               // t = L\t 
-      cs_usolve (N_->U, t) ;               // t = U\t 
-      cs_ipvec (S_->q, t, x, AT_.n) ;      // x = P2\t 
+      // t = P1\b
+      for(int i=0; i<n; ++i){
+        for(int r=0; r<nb; ++r) t[pinv[i]*nb+r] = x[r*n+i];
+      }
+      
+      // t = L\t
+      for(int j=0; j<n; ++j){
+        double* tj = t+j*nb;
+        for(int r=0; r<nb; ++r) tj[r] /= Lx[Lp[j]];
+        for(int p=Lp[j]+1; p<Lp[j+1]; ++p){
+          double* ti = t+Li[p]*nb;
+          for(int r=0; r<nb; ++r) ti[r] -= Lx[p]*tj[r];
+        }
+      }
+      
+      // t = U\t
+      for(int j=n-1; j>=0; --j){
+        double* tj = t+j*nb;
+        for(int r=0; r<nb; ++r) tj[r] /= Ux[Up[j+1]-1];
+        for(int p=Up[j]; p<Up[j+1]-1; ++p){
+          double* ti = t+Ui[p]*nb;
+          for(int r=0; r<nb; ++r) ti[r] -= Ux[p]*tj[r];
+        }
+      }
+      
+      // x = P2\t
+      for(int i=0; i<n; ++i){
+        int qi = q ? q[i] : i;
+        for(int r=0; r<nb; ++r) x[r*n+qi] = t[i*nb+r];
+      }
     } else {
-      cs_pvec (S_->q, x, t, AT_.n) ;       // t = P2*b 
-      casadi_assert(N_->U!=0);
-      cs_utsolve (N_->U, t) ;              // t = U'\t 
-      cs_ltsolve (N_->L, t) ;              // t = L'\t 
-      cs_pvec (N_->pinv, t, x, AT_.n) ;    // x = P1*t 
+      // t = P2*b
+      for(int i=0; i<n; ++i){
+        int qi = q ? q[i] : i;
+        for(int r=0; r<nb; ++r) t[i*nb+r] = x[r*n+qi];
+      }
+      
+      // t = U'\t
+      for(int j=0; j<n; ++j){
+        double* tj = t+j*nb;
+        for(int p=Up[j]; p<Up[j+1]-1; ++p){
+          const double* ti = t+Ui[p]*nb;
+          for(int r=0; r<nb; ++r) tj[r] -= Ux[p]*ti[r];
+        }
+        for(int r=0; r<nb; ++r) tj[r] /= Ux[Up[j+1]-1];
+      }
+      
+      // t = L'\t
+      for(int j=n-1; j>=0; --j){
+        double* tj = t+j*nb;
+        for(int p=Lp[j]+1; p<Lp[j+1]; ++p){
+          const double* ti = t+Li[p]*nb;
+          for(int r=0; r<nb; ++r) tj[r] -= Lx[p]*ti[r];
+        }
+        for(int r=0; r<nb; ++r) tj[r] /= Lx[Lp[j]];
+      }
+      
+      // x = P1*t
+      for(int i=0; i<n; ++i){
+        for(int r=0; r<nb; ++r) x[r*n+i] = t[pinv[i]*nb+r];
+      }
     }
-    x += nrow();
+    x += nb*n;
   }
 }
 
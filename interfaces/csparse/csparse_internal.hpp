@@ -55,6 +55,12 @@ class CSparseInternal : public LinearSolverInternal{
     // Solve the system of equations
     virtual void solve(double* x, int nrhs, bool transpose);
     
+    // Numeric factorization reusing the pivot sequence and the structure of L and U in N_, returns false if a pivot is too small
+    bool refactorize();
+    
+    // Report a matrix with not-a-number or infinite nonzeros
+    void checkFinite() const;
+    
     // Clone
     virtual CSparseInternal* clone() const;
     
@@ -70,8 +76,23 @@ class CSparseInternal : public LinearSolverInternal{
     // The numeric factorization
     csn *N_;
     
-    // Temporary
+    // Temporary, nrhs_block_ right hand sides interleaved
     std::vector<double> temp_;
+    
+    // Reuse the previous factorization if possible
+    bool refactorize_;
+    
+    // Relative pivot tolerance below which a refactorization is rejected
+    double refactorize_tol_;
+    
+    // Number of right hand sides solved together
+    int nrhs_block_;
+    
+    // Work vector for the refactorization, indexed by pivot row
+    std::vector<double> work_;
+    
+    // Number of full factorizations and refactorizations
+    int n_factorizations_, n_refactorizations_;
 
     
 };
@@ -0,0 +1,88 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef CSPARSE_LDL_HPP
+#define CSPARSE_LDL_HPP
+
+#include "symbolic/fx/linear_solver.hpp"
+
+namespace CasADi{
+
+  
+/** \brief  Forward declaration of internal class */
+class CSparseLDLInternal;
+
+/** \brief  LinearSolver for symmetric matrices using a sparse LDL' factorization
+*
+ @copydoc LinearSolver_doc
+*  
+* CSparseLDL is an CasADi::FX mapping from 2 inputs [ A (matrix),b (vector)] to one output [x (vector)].
+*
+* The matrix A must be symmetric and have an LDL' factorization without pivoting, which is the case for
+* positive definite matrices and for quasi-definite matrices such as regularized KKT systems. 
+* The fill-reducing ordering (approximate minimum degree), the elimination tree and the nonzero pattern 
+* of L are computed once in init(), prepare() only computes the numerical values of L and D.
+*
+* The usual procedure to use CSparseLDL is: \n
+*  -# init()
+*  -# set the first input (A)
+*  -# prepare()
+*  -# set the second input (b)
+*  -# solve()
+*  -# Repeat steps 4 and 5 to work with other b vectors.
+*
+* The method evaluate() combines the prepare() and solve() step and is therefore more expensive if A is invariant.
+*
+*/
+class CSparseLDL : public LinearSolver{
+public:
+
+  /// Default (empty) constructor
+  CSparseLDL();
+  
+  /// Create a linear solver given a sparsity pattern
+  CSparseLDL(const CRSSparsity& sp);
+  
+  /** \brief  Access internal functions and data members */
+  CSparseLDLInternal* operator->();
+  
+  /** \brief  Access internal functions and data members */
+  const CSparseLDLInternal* operator->() const;
+  
+  /// Check if the node is pointing to the right type of object
+  virtual bool checkNode() const;
+  
+  /// Static creator function
+  #ifdef SWIG
+  %callback("%s_cb");
+  #endif
+  static LinearSolver creator(const CRSSparsity& sp){ return CSparseLDL(sp);}
+  #ifdef SWIG
+  %nocallback;
+  #endif
+  
+};
+
+} // namespace CasADi
+
+#endif //CSPARSE_LDL_HPP
@@ -0,0 +1,190 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "csparse_ldl_internal.hpp"
+#include "symbolic/matrix/crs_sparsity_internal.hpp"
+#include "symbolic/matrix/matrix_tools.hpp"
+
+using namespace std;
+namespace CasADi{
+
+CSparseLDLInternal::CSparseLDLInternal(const CRSSparsity& sparsity)  : LinearSolverInternal(sparsity){
+  addOption("ordering", OT_STRING, "amd", "Fill-reducing ordering","amd|natural");
+}
+
+CSparseLDLInternal::CSparseLDLInternal(const CSparseLDLInternal& linsol) : LinearSolverInternal(linsol){
+}
+
+CSparseLDLInternal::~CSparseLDLInternal(){
+}
+
+void CSparseLDLInternal::init(){
+  // Call the init method of the base class
+  LinearSolverInternal::init();
+  
+  // Only the upper triangular part is read, the factorization assumes that the lower part mirrors it
+  casadi_assert_message(sparsity_.isTranspose(sparsity_),"CSparseLDLInternal::init: the sparsity pattern must be symmetric");
+  
+  int n = nrow();
+  
+  // Fill-reducing ordering of A+A'
+  if(getOption("ordering")=="amd"){
+    p_ = sparsity_->approximateMinimumDegree(1);
+    p_.resize(n);
+  } else {
+    p_ = range(n);
+  }
+  pinv_ = CRSSparsityInternal::invertPermutation(p_);
+  
+  // Elimination tree and column counts of the permuted matrix
+  CRSSparsity C = sparsity_->permute(pinv_,p_,0);
+  parent_ = C.eliminationTree();
+  vector<int> post = CRSSparsityInternal::postorder(parent_,n);
+  vector<int> colcount = C->counts(getPtr(parent_),getPtr(post),0);
+  
+  // Allocate L, the diagonal is stored separately in D
+  lp_.resize(n+1);
+  lp_[0] = 0;
+  for(int j=0; j<n; ++j) lp_[j+1] = lp_[j] + colcount[j] - 1;
+  li_.resize(lp_[n]);
+  lx_.resize(lp_[n]);
+  d_.resize(n);
+  
+  // Work vectors
+  lnz_.resize(n);
+  flag_.resize(n);
+  pattern_.resize(n);
+  y_.resize(n);
+  
+  if(verbose()){
+    cout << "CSparseLDLInternal::init: symbolic factorization, " << lp_[n] << " nonzeros in L" << endl;
+  }
+}
+
+void CSparseLDLInternal::prepare(){
+  prepared_ = false;
+  
+  int n = nrow();
+  const int* ap = getPtr(sparsity_.rowind());
+  const int* ai = getPtr(sparsity_.col());
+  const double* ax = getPtr(input().data());
+  const int *p = getPtr(p_), *pinv = getPtr(pinv_), *parent = getPtr(parent_), *lp = getPtr(lp_);
+  int *li = getPtr(li_), *lnz = getPtr(lnz_), *flag = getPtr(flag_), *pattern = getPtr(pattern_);
+  double *lx = getPtr(lx_), *d = getPtr(d_), *y = getPtr(y_);
+  
+  // Up-looking LDL': row k of L from a sparse triangular solve with the rows above, the pattern of which is given by the elimination tree
+  for(int k=0; k<n; ++k){
+    y[k] = 0;
+    int top = n;
+    flag[k] = k;
+    lnz[k] = 0;
+    
+    // Scatter the upper triangular part of column k of the permuted matrix and find the pattern of row k of L
+    int kk = p[k];
+    for(int pp=ap[kk]; pp<ap[kk+1]; ++pp){
+      int i = pinv[ai[pp]];
+      if(i<=k){
+        y[i] += ax[pp];
+        int len;
+        for(len=0; flag[i]!=k; i=parent[i]){
+          pattern[len++] = i;
+          flag[i] = k;
+        }
+        while(len>0) pattern[--top] = pattern[--len];
+      }
+    }
+    
+    // Compute the numerical values of row k of L
+    d[k] = y[k];
+    y[k] = 0;
+    for(; top<n; ++top){
+      int i = pattern[top];
+      double yi = y[i];
+      y[i] = 0;
+      int p2 = lp[i] + lnz[i];
+      for(int pp=lp[i]; pp<p2; ++pp){
+        y[li[pp]] -= lx[pp]*yi;
+      }
+      double l_ki = yi/d[i];
+      d[k] -= l_ki*yi;
+      li[p2] = k;
+      lx[p2] = l_ki;
+      lnz[i]++;
+    }
+    
+    // Zero or invalid pivot
+    if(!(d[k]!=0 && d[k]-d[k]==0)){
+      stringstream ss;
+      ss << "CSparseLDLInternal::prepare: factorization failed, pivot " << k << " is " << d[k] << ". The matrix must be symmetric and quasi-definite." << endl;
+      if(verbose()){
+        ss << "Sparsity of the linear system: " << endl;
+        sparsity_.print(ss); // print detailed
+      }
+      throw CasadiException(ss.str());
+    }
+  }
+  
+  prepared_ = true;
+}
+  
+void CSparseLDLInternal::solve(double* x, int nrhs, bool transpose){
+  casadi_assert(prepared_);
+  
+  // The matrix is symmetric, transpose has no effect
+  int n = nrow();
+  const int *p = getPtr(p_), *lp = getPtr(lp_), *li = getPtr(li_);
+  const double *lx = getPtr(lx_), *d = getPtr(d_);
+  double *y = getPtr(y_);
+  
+  for(int r=0; r<nrhs; ++r){
+    // y = P*b
+    for(int k=0; k<n; ++k) y[k] = x[p[k]];
+    
+    // y = L\y
+    for(int j=0; j<n; ++j){
+      for(int pp=lp[j]; pp<lp[j+1]; ++pp){
+        y[li[pp]] -= lx[pp]*y[j];
+      }
+    }
+    
+    // y = D\y
+    for(int j=0; j<n; ++j) y[j] /= d[j];
+    
+    // y = L'\y
+    for(int j=n-1; j>=0; --j){
+      for(int pp=lp[j]; pp<lp[j+1]; ++pp){
+        y[j] -= lx[pp]*y[li[pp]];
+      }
+    }
+    
+    // x = P'*y
+    for(int k=0; k<n; ++k) x[p[k]] = y[k];
+    x += n;
+  }
+}
+
+CSparseLDLInternal* CSparseLDLInternal::clone() const{
+  return new CSparseLDLInternal(sparsity_);
+}
+
+} // namespace CasADi
@@ -0,0 +1,81 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef CSPARSE_LDL_INTERNAL_HPP
+#define CSPARSE_LDL_INTERNAL_HPP
+
+#include "csparse_ldl.hpp"
+#include "symbolic/fx/linear_solver_internal.hpp"
+
+namespace CasADi{
+
+/**
+ @copydoc LinearSolver_doc
+*/
+class CSparseLDLInternal : public LinearSolverInternal{
+  public:
+    // Create a linear solver given a sparsity pattern
+    CSparseLDLInternal(const CRSSparsity& sp);
+
+    // Copy constructor
+    CSparseLDLInternal(const CSparseLDLInternal& linsol);
+
+    // Destructor
+    virtual ~CSparseLDLInternal();
+    
+    // Initialize the solver: ordering and symbolic factorization
+    virtual void init();
+
+    // Numeric factorization
+    virtual void prepare();
+    
+    // Solve the system of equations
+    virtual void solve(double* x, int nrhs, bool transpose);
+    
+    // Clone
+    virtual CSparseLDLInternal* clone() const;
+    
+    // Fill-reducing permutation and its inverse
+    std::vector<int> p_, pinv_;
+    
+    // Elimination tree of the permuted matrix
+    std::vector<int> parent_;
+    
+    // Strictly lower triangular factor L in compressed column form, the nonzero pattern is fixed in init()
+    std::vector<int> lp_, li_;
+    std::vector<double> lx_;
+    
+    // Diagonal factor D
+    std::vector<double> d_;
+    
+    // Number of nonzeros in each column of L during the factorization
+    std::vector<int> lnz_;
+    
+    // Work vectors
+    std::vector<int> flag_, pattern_;
+    std::vector<double> y_;
+};
+
+} // namespace CasADi
+
+#endif //CSPARSE_LDL_INTERNAL_HPP
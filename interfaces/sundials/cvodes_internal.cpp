@@ -151,6 +151,7 @@ void CVodesInternal::init(){
       initIterativeLinearSolver();
       break;
     case SD_USER_DEFINED:
+    case SD_SPARSE:
       initUserDefinedLinearSolver();
       break;
   }
@@ -270,19 +271,8 @@ void CVodesInternal::init(){
       rq_ = N_VMake_Serial(nrq_,output(INTEGRATOR_RQF).ptr());
 //     }
     
-    // Get the number of steos per checkpoint
-    int Nd = getOption("steps_per_checkpoint");
-
-    // Get the interpolation type
-    int interpType;
-    if(getOption("interpolation_type")=="hermite")
-      interpType = CV_HERMITE;
-    else if(getOption("interpolation_type")=="polynomial")
-      interpType = CV_POLYNOMIAL;
-    else throw CasadiException("\"interpolation_type\" must be \"hermite\" or \"polynomial\"");
-      
     // Initialize adjoint sensitivities
-    flag = CVodeAdjInit(mem_, Nd, interpType);
+    flag = CVodeAdjInit(mem_, steps_per_checkpoint_, hermite_ ? CV_HERMITE : CV_POLYNOMIAL);
     if(flag != CV_SUCCESS) cvodes_error("CVodeAdjInit",flag);
           
     isInitAdj_ = false;
@@ -311,6 +301,10 @@ void CVodesInternal::initAdj(){
   flag = CVodeSetUserDataB(mem_, whichB_, this);
   if(flag != CV_SUCCESS) cvodes_error("CVodeSetUserDataB",flag);
 
+  // Maximum number of steps, the backward problem is integrated over one interval between two checkpoints at a time
+  flag = CVodeSetMaxNumStepsB(mem_, whichB_, max_num_steps_);
+  if(flag != CV_SUCCESS) cvodes_error("CVodeSetMaxNumStepsB",flag);
+
   // attach linear solver to backward problem
   switch(linsol_g_){
     case SD_DENSE:
@@ -323,6 +317,7 @@ void CVodesInternal::initAdj(){
       initIterativeLinearSolverB();
       break;
     case SD_USER_DEFINED:
+    case SD_SPARSE:
       initUserDefinedLinearSolverB();
       break;
   }
@@ -353,7 +348,9 @@ void CVodesInternal::rhs(double t, const double* x, double* xdot){
   // Pass input
   f_.setInput(&t,DAE_T);
   f_.setInput(x,DAE_X);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
+
+  // Finite difference sensitivities perturb the parameters in place
+  if(finite_difference_fsens_) f_.setInput(input(INTEGRATOR_P),DAE_P);
 
   if(monitor_rhs_) {
     cout << "t       = " << t << endl;
@@ -433,6 +430,17 @@ void CVodesInternal::reset(int nsens, int nsensB, int nsensB_store){
   
   // Re-initialize backward integration
   if(nrx_>0){
+    // Adapt the number of steps per checkpoint to the memory budget
+    int nd = adaptStepsPerCheckpoint(nx_, lmm_==CV_ADAMS ? 12 : 5);
+    if(nd!=steps_per_checkpoint_){
+      // Reallocate the adjoint memory, the backward problem is created anew in resetB
+      CVodeAdjFree(mem_);
+      steps_per_checkpoint_ = nd;
+      flag = CVodeAdjInit(mem_, steps_per_checkpoint_, hermite_ ? CV_HERMITE : CV_POLYNOMIAL);
+      if(flag != CV_SUCCESS) cvodes_error("CVodeAdjInit",flag);
+      isInitAdj_ = false;
+    }
+    
     flag = CVodeAdjReInit(mem_);
     if(flag != CV_SUCCESS) cvodes_error("CVodeAdjReInit",flag);
   }
@@ -446,6 +454,7 @@ void CVodesInternal::integrate(double t_out){
   casadi_log("CVodesInternal::integrate(" << t_out << ") begin");
   
   casadi_assert_message(t_out>=t0_,"CVodesInternal::integrate(" << t_out << "): Cannot integrate to a time earlier than t0 (" << t0_ << ")");
+  passParameters();
   casadi_assert_message(t_out<=tf_ || !stop_at_end_,"CVodesInternal::integrate(" << t_out << "): Cannot integrate past a time later than tf (" << tf_ << ") unless stop_at_end is set to False.");
   
   int flag;
@@ -504,6 +513,13 @@ void CVodesInternal::integrate(double t_out){
 void CVodesInternal::resetB(){
   casadi_log("CVodesInternal::resetB begin");
   int flag;
+  passParameters();
+  
+  // Check the data stored in the forward integration against the memory budget
+  long nsteps;
+  flag = CVodeGetNumSteps(mem_, &nsteps);
+  if(flag != CV_SUCCESS) cvodes_error("CVodeGetNumSteps",flag);
+  checkCheckpointMemory(nx_, lmm_==CV_ADAMS ? 12 : 5, nsteps);
   
   if(isInitAdj_){
     
@@ -526,6 +542,7 @@ void CVodesInternal::resetB(){
 void CVodesInternal::integrateB(double t_out){
   casadi_log("CVodesInternal::integrateB(" << t_out << ") begin");
   int flag;
+  passParameters();
   
   // Integrate backward to t_out
   flag = CVodeB(mem_, t_out, CV_NORMAL);
@@ -696,7 +713,6 @@ void CVodesInternal::rhsS(int Ns, double t, N_Vector x, N_Vector xdot, N_Vector
     // Pass input
   f_.setInput(&t,DAE_T);
   f_.setInput(NV_DATA_S(x),DAE_X);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
 
    // Calculate the forward sensitivities, nfdir_f_ directions at a time
    for(int j=0; j<nfdir_; j += nfdir_f_){
@@ -739,7 +755,6 @@ void CVodesInternal::rhsS1(int Ns, double t, N_Vector x, N_Vector xdot, int iS,
     // Pass input
   f_.setInput(&t,DAE_T);
   f_.setInput(NV_DATA_S(x),DAE_X);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
 
   // Pass forward seeds
   f_.fwdSeed(DAE_T).setZero();
@@ -781,7 +796,9 @@ void CVodesInternal::rhsQ(double t, const double* x, double* qdot){
   // Pass input
   f_.setInput(&t,DAE_T);
   f_.setInput(x,DAE_X);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
+
+  // Finite difference sensitivities perturb the parameters in place
+  if(finite_difference_fsens_) f_.setInput(input(INTEGRATOR_P),DAE_P);
 
   // Evaluate
   f_.evaluate();
@@ -796,7 +813,6 @@ void CVodesInternal::rhsQS(int Ns, double t, N_Vector x, N_Vector *xF, N_Vector
   // Pass input
   f_.setInput(&t,DAE_T);
   f_.setInput(NV_DATA_S(x),DAE_X);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
 
   for(int i=0; i<nfdir_; ++i){
     // Pass forward seeds
@@ -835,8 +851,6 @@ void CVodesInternal::rhsB(double t, const double* x, const double *rx, double* r
   // Pass inputs
   g_.setInput(&t,RDAE_T);
   g_.setInput(x,RDAE_X);
-  g_.setInput(input(INTEGRATOR_P),RDAE_P);
-  g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
   g_.setInput(rx,RDAE_RX);
 
   if(monitor_rhsB_){
@@ -869,8 +883,6 @@ void CVodesInternal::rhsBS(double t, N_Vector x, N_Vector *xF, N_Vector rx, N_Ve
   // Pass input
   g_.setInput(&t,RDAE_T);
   g_.setInput(NV_DATA_S(x),RDAE_X);
-  g_.setInput(input(INTEGRATOR_P),RDAE_P);
-  g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
   
   // Pass backward state
   const double *rx_data = NV_DATA_S(rx);
@@ -946,8 +958,6 @@ void CVodesInternal::rhsQB(double t, const double* x, const double* rx, double*
   // Pass inputs
   g_.setInput(&t,RDAE_T);
   g_.setInput(x,RDAE_X);
-  g_.setInput(input(INTEGRATOR_P),RDAE_P);
-  g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
   g_.setInput(rx,RDAE_RX);
 
   if(monitor_rhsB_){
@@ -1009,7 +1019,6 @@ void CVodesInternal::jtimes(N_Vector v, N_Vector Jv, double t, N_Vector x, N_Vec
   // Pass input
   f_.setInput(&t,DAE_T);
   f_.setInput(NV_DATA_S(x),DAE_X);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
 
   // Pass input seeds
   f_.fwdSeed(DAE_T).setZero();
@@ -1037,9 +1046,7 @@ void CVodesInternal::jtimesB(N_Vector vB, N_Vector JvB, double t, N_Vector x, N_
   // Pass input
   g_.setInput(&t,RDAE_T);
   g_.setInput(NV_DATA_S(x),RDAE_X);
-  g_.setInput(input(INTEGRATOR_P),RDAE_P);
   g_.setInput(NV_DATA_S(xB),RDAE_RX);
-  g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
   
   // Pass input seeds
   g_.fwdSeed(RDAE_T).setZero();
@@ -1490,10 +1497,64 @@ void CVodesInternal::lsetup(CVodeMem cv_mem, int convfail, N_Vector x, N_Vector
   // Scaling factor before J
   double gamma = cv_mem->cv_gamma;
 
+  // Sparse direct linear solver
+  if(linsol_f_==SD_SPARSE){
+    lsetupSparse(cv_mem, convfail, x, jcurPtr);
+    return;
+  }
+
   // Call the preconditioner setup function (which sets up the linear solver)
   psetup(t, x, xdot, FALSE, jcurPtr, gamma, vtemp1, vtemp2, vtemp3);
 }
 
+void CVodesInternal::lsetupSparse(CVodeMem cv_mem, int convfail, N_Vector x, booleantype *jcurPtr){
+  log("CVodesInternal::lsetupSparse","begin");
+  
+  // Get time
+  time1 = clock();
+  
+  // Current time and scaling factor before J
+  double t = cv_mem->cv_tn;
+  double gamma = cv_mem->cv_gamma;
+  
+  // Reevaluate the Jacobian with the criteria of CVDENSE: at most 50 steps old, and not after a convergence failure with an old Jacobian
+  double dgamma = fabs(gamma/cv_mem->cv_gammap - 1);
+  bool jbad = cv_mem->cv_nst==0 || cv_mem->cv_nst > nstlj_ + 50 || (convfail==CV_FAIL_BAD_J && dgamma<0.2) || convfail==CV_FAIL_OTHER;
+  if(jbad){
+    nstlj_ = cv_mem->cv_nst;
+    *jcurPtr = TRUE;
+    
+    // Evaluate the Jacobian of the ODE right hand side
+    jac_.setInput(&t,DAE_T);
+    jac_.setInput(NV_DATA_S(x),DAE_X);
+    jac_.setInput(input(INTEGRATOR_P),DAE_P);
+    jac_.setInput(1.0,DAE_NUM_IN);
+    jac_.setInput(0.0,DAE_NUM_IN+1);
+    jac_.evaluate();
+    jac_.getOutput(jac_saved_);
+  } else {
+    *jcurPtr = FALSE;
+  }
+  
+  // Log time duration
+  time2 = clock();
+  t_lsetup_jac += double(time2-time1)/CLOCKS_PER_SEC;
+
+  // Newton matrix I - gamma*J, with the sparsity of the Jacobian
+  vector<double>& m = linsol_.input(0).data();
+  for(int k=0; k<m.size(); ++k) m[k] = -gamma*jac_saved_[k];
+  for(int i=0; i<nx_; ++i) m[jac_diag_[i]] += 1;
+  
+  // Factorize
+  linsol_.prepare();
+
+  // Log time duration
+  time1 = clock();
+  t_lsetup_fac += double(time1-time2)/CLOCKS_PER_SEC;
+  
+  log("CVodesInternal::lsetupSparse","end");
+}
+
 void CVodesInternal::lsetupB(double t, double gamma, int convfail, N_Vector x, N_Vector xB, N_Vector xdotB, booleantype *jcurPtr, N_Vector vtemp1, N_Vector vtemp2, N_Vector vtemp3) {
   // Call the preconditioner setup function (which sets up the linear solver)
   psetupB(t, x, xB, xdotB, FALSE, jcurPtr, gamma, vtemp1, vtemp2, vtemp3);
@@ -1687,6 +1748,18 @@ void CVodesInternal::initUserDefinedLinearSolver(){
   cv_mem->cv_lsetup = lsetup_wrapper;
   cv_mem->cv_lsolve = lsolve_wrapper;
   cv_mem->cv_setupNonNull = TRUE;
+  
+  // Locate the diagonal of the Newton matrix, where the identity is added to the Jacobian
+  if(linsol_f_==SD_SPARSE){
+    const CRSSparsity& sp = jac_.output().sparsity();
+    jac_diag_.resize(nx_);
+    for(int i=0; i<nx_; ++i){
+      jac_diag_[i] = sp.getNZ(i,i);
+      casadi_assert_message(jac_diag_[i]>=0,"CVodesInternal::initUserDefinedLinearSolver: the Jacobian must be structurally nonzero on the diagonal");
+    }
+    jac_saved_.resize(sp.size());
+    nstlj_ = 0;
+  }
 }
 
 void CVodesInternal::initDenseLinearSolverB(){
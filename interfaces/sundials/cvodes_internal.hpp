@@ -212,6 +212,14 @@ public:
   // Initialize the user defined linear solver
   void initUserDefinedLinearSolver();
   
+  // Set up the sparse direct linear solver, reusing the Jacobian of a previous setup when possible
+  void lsetupSparse(CVodeMem cv_mem, int convfail, N_Vector x, booleantype *jcurPtr);
+  
+  // Sparse direct linear solver: Jacobian of the last evaluation, nonzero of each diagonal entry, step of the last evaluation
+  std::vector<double> jac_saved_;
+  std::vector<int> jac_diag_;
+  long nstlj_;
+  
   // Initialize the dense linear solver (backward integration)
   void initDenseLinearSolverB();
   
@@ -217,6 +217,7 @@ void IdasInternal::init(){
       initIterativeLinearSolver();
       break;
     case SD_USER_DEFINED:
+    case SD_SPARSE:
       initUserDefinedLinearSolver();
       break;
     default: casadi_error("Uncaught switch");
@@ -376,19 +377,8 @@ void IdasInternal::initTaping(){
   casadi_assert(!isInitTaping_);
   int flag;
   
-  // Get the number of steos per checkpoint
-  int Nd = getOption("steps_per_checkpoint");
-
-  // Get the interpolation type
-  int interpType;
-  if(getOption("interpolation_type")=="hermite")
-    interpType = IDA_HERMITE;
-  else if(getOption("interpolation_type")=="polynomial")
-    interpType = IDA_POLYNOMIAL;
-  else throw CasadiException("\"interpolation_type\" must be \"hermite\" or \"polynomial\"");
-      
   // Initialize adjoint sensitivities
-  flag = IDAAdjInit(mem_, Nd, interpType);
+  flag = IDAAdjInit(mem_, steps_per_checkpoint_, hermite_ ? IDA_HERMITE : IDA_POLYNOMIAL);
   if(flag != IDA_SUCCESS) idas_error("IDAAdjInit",flag);
   
   isInitTaping_ = true;
@@ -445,6 +435,7 @@ void IdasInternal::initAdj(){
       initIterativeLinearSolverB();
       break;
     case SD_USER_DEFINED:
+    case SD_SPARSE:
       initUserDefinedLinearSolverB();
       break;
     default: casadi_error("Uncaught switch");
@@ -481,7 +472,9 @@ void IdasInternal::res(double t, const double* xz, const double* xzdot, double*
   f_.setInput(&t,DAE_T);
   f_.setInput(xz,DAE_X);
   f_.setInput(xz+nx_,DAE_Z);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
+
+  // Finite difference sensitivities perturb the parameters in place
+  if(finite_difference_fsens_) f_.setInput(input(INTEGRATOR_P),DAE_P);
 
   if(monitored("res")){
     cout << "DAE_T    = " << t << endl;
@@ -552,7 +545,6 @@ void IdasInternal::jtimes(double t, const double *xz, const double *xzdot, const
   f_.setInput(&t,DAE_T);
   f_.setInput(xz,DAE_X);
   f_.setInput(xz+nx_,DAE_Z);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
     
   // Pass seeds of the state vectors
   f_.setFwdSeed(v,DAE_X);
@@ -596,11 +588,9 @@ void IdasInternal::jtimesB(double t, const double *xz, const double *xzdot, cons
   g_.setInput(&t,RDAE_T);
   g_.setInput(xz,RDAE_X);
   g_.setInput(xz+nx_,RDAE_Z);
-  g_.setInput(input(INTEGRATOR_P),RDAE_P);
 
   g_.setInput(xzB,RDAE_RX);
   g_.setInput(xzB+nrx_,RDAE_RZ);
-  g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
   
   // Pass seeds of the state vectors
   g_.fwdSeed(RDAE_T).setZero();
@@ -685,7 +675,6 @@ void IdasInternal::resS(int Ns, double t, const double* xz, const double* xzdot,
   f_.setInput(&t,DAE_T);
   f_.setInput(xz,DAE_X);
   f_.setInput(xz+nx_,DAE_Z);
-  f_.setInput(input(INTEGRATOR_P),DAE_P);
   
   // Calculate the forward sensitivities, nfdir_f_ directions at a time
   for(int offset=0; offset<nfdir_; offset += nfdir_f_){
@@ -737,6 +726,19 @@ void IdasInternal::reset(int nsens, int nsensB, int nsensB_store){
   // Reset the base classes
   SundialsInternal::reset(nsens,nsensB,nsensB_store);
   
+  // Adapt the number of steps per checkpoint to the memory budget
+  if(nrx_>0){
+    int nd = adaptStepsPerCheckpoint(nx_+nz_, getOption("max_multistep_order"));
+    if(nd!=steps_per_checkpoint_){
+      // Reallocate the adjoint memory, the backward problem is created anew in resetB
+      if(isInitTaping_){
+        IDAAdjFree(mem_);
+        isInitTaping_ = isInitAdj_ = false;
+      }
+      steps_per_checkpoint_ = nd;
+    }
+  }
+  
   if(nrx_>0 && !isInitTaping_)
     initTaping();
   
@@ -860,6 +862,7 @@ void IdasInternal::integrate(double t_out){
   casadi_log("IdasInternal::integrate(" << t_out << ") begin");
   
   casadi_assert_message(t_out>=t0_,"IdasInternal::integrate(" << t_out << "): Cannot integrate to a time earlier than t0 (" << t0_ << ")");
+  passParameters();
   casadi_assert_message(t_out<=tf_ || !stop_at_end_,"IdasInternal::integrate(" << t_out << "): Cannot integrate past a time later than tf (" << tf_ << ") unless stop_at_end is set to False.");
   
   int flag;
@@ -936,6 +939,13 @@ void IdasInternal::resetB(){
   log("IdasInternal::resetB","begin");
 
   int flag;
+  passParameters();
+  
+  // Check the data stored in the forward integration against the memory budget
+  long nsteps;
+  flag = IDAGetNumSteps(mem_, &nsteps);
+  if(flag != IDA_SUCCESS) idas_error("IDAGetNumSteps",flag);
+  checkCheckpointMemory(nx_+nz_, getOption("max_multistep_order"), nsteps);
   
   // Reset adjoint sensitivities for the parameters
   N_VConst(0.0, rq_);
@@ -981,6 +991,7 @@ void IdasInternal::resetB(){
 void IdasInternal::integrateB(double t_out){
   casadi_log("IdasInternal::integrateB(" << t_out << ") begin");
   int flag;
+  passParameters();
   // Integrate backwards to t_out
   flag = IDASolveB(mem_, t_out, IDA_NORMAL);
   if(flag<IDA_SUCCESS) idas_error("IDASolveB",flag);
@@ -1107,7 +1118,9 @@ void IdasInternal::rhsQ(double t, const double* xz, const double* xzdot, double*
    f_.setInput(&t,DAE_T);
    f_.setInput(xz,DAE_X);
    f_.setInput(xz+nx_,DAE_Z);
-   f_.setInput(input(INTEGRATOR_P),DAE_P);
+   
+   // Finite difference sensitivities perturb the parameters in place
+   if(finite_difference_fsens_) f_.setInput(input(INTEGRATOR_P),DAE_P);
 
     // Evaluate
    f_.evaluate();
@@ -1126,7 +1139,6 @@ void IdasInternal::rhsQS(int Ns, double t, N_Vector xz, N_Vector xzdot, N_Vector
    f_.setInput(&t,DAE_T);
    f_.setInput(NV_DATA_S(xz),DAE_X);
    f_.setInput(NV_DATA_S(xz)+nx_,DAE_Z);
-   f_.setInput(input(INTEGRATOR_P),DAE_P);
      
    // Pass forward seeds
   for(int i=0; i<nfdir_; ++i){
@@ -1164,8 +1176,6 @@ void IdasInternal::resB(double t, const double* xz, const double* xzdot, const d
   g_.setInput(&t,RDAE_T);
   g_.setInput(xz,RDAE_X);
   g_.setInput(xz+nx_,RDAE_Z);
-  g_.setInput(input(INTEGRATOR_P),RDAE_P);
-  g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
   g_.setInput(xzA,RDAE_RX);
   g_.setInput(xzA+nrx_,RDAE_RZ);
 
@@ -1235,8 +1245,6 @@ void IdasInternal::rhsQB(double t, const double* xz, const double* xzdot, const
   g_.setInput(&t,RDAE_T);
   g_.setInput(xz,RDAE_X);
   g_.setInput(xz+nx_,RDAE_Z);
-  g_.setInput(input(INTEGRATOR_P),RDAE_P);
-  g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
   g_.setInput(xzA,RDAE_RX);
   g_.setInput(xzA+nrx_,RDAE_RZ);
   
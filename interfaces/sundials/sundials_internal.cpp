@@ -27,6 +27,8 @@
 #include "symbolic/sx/sx_tools.hpp"
 #include "symbolic/fx/mx_function.hpp"
 #include "symbolic/fx/sx_function.hpp"
+#include <cmath>
+#include <cstdlib>
 
 INPUTSCHEME(IntegratorInput)
 OUTPUTSCHEME(IntegratorOutput)
@@ -42,7 +44,7 @@ SundialsInternal::SundialsInternal(const FX& f, const FX& g) : IntegratorInterna
   addOption("exact_jacobianB",             OT_BOOLEAN,          GenericType(),  "Use exact Jacobian information for the backward integration [default: equal to exact_jacobian]");
   addOption("upper_bandwidth",             OT_INTEGER,          GenericType(),  "Upper band-width of banded Jacobian (estimations)");
   addOption("lower_bandwidth",             OT_INTEGER,          GenericType(),  "Lower band-width of banded Jacobian (estimations)");
-  addOption("linear_solver_type",          OT_STRING,           "dense",        "","user_defined|dense|banded|iterative");
+  addOption("linear_solver_type",          OT_STRING,           "dense",        "Sparse: keep the Jacobian in sparse form and solve with the sparse direct solver given by linear_solver. Requires exact_jacobian. Only the forward problem of CVodes has a dedicated sparse mode, for IDAS and for the backward problems it is an alias of user_defined","user_defined|dense|banded|iterative|sparse");
   addOption("iterative_solver",            OT_STRING,           "gmres",        "","gmres|bcgstab|tfqmr");
   addOption("pretype",                     OT_STRING,           "none",         "","none|left|right|both");
   addOption("max_krylov",                  OT_INTEGER,          10,             "Maximum Krylov subspace size");
@@ -66,9 +68,15 @@ SundialsInternal::SundialsInternal(const FX& f, const FX& g) : IntegratorInterna
   // Adjoint sensivity problem
   addOption("steps_per_checkpoint",        OT_INTEGER,          20,             "Number of steps between two consecutive checkpoints");
   addOption("interpolation_type",          OT_STRING,           "hermite",      "Type of interpolation for the adjoint sensitivities","hermite|polynomial");
+  addOption("checkpoint_memory_budget",    OT_REAL,             0.0,            "Memory budget in megabytes for the checkpoints and the interpolation data of the adjoint sensitivity analysis. "
+                                                                                 "If positive, steps_per_checkpoint is kept as long as the data estimated for the number of steps of the previous "
+                                                                                 "forward integration (before the first one: expected_num_steps) fits into the budget, otherwise it is chosen at reset "
+                                                                                 "to minimize the stored data. A warning is issued if the budget is exceeded");
+  addOption("expected_num_steps",          OT_INTEGER,          GenericType(),  "Estimate of the number of steps of the forward integration, used with checkpoint_memory_budget before the "
+                                                                                 "first forward integration [default: max_num_steps, which bounds the stored data]");
   addOption("upper_bandwidthB",            OT_INTEGER,          GenericType(),  "Upper band-width of banded jacobians for backward integration [default: equal to upper_bandwidth]");
   addOption("lower_bandwidthB",            OT_INTEGER,          GenericType(),  "lower band-width of banded jacobians for backward integration [default: equal to lower_bandwidth]");
-  addOption("linear_solver_typeB",         OT_STRING,           GenericType(),  "","user_defined|dense|banded|iterative");
+  addOption("linear_solver_typeB",         OT_STRING,           GenericType(),  "Sparse: an alias of user_defined, requires exact_jacobianB","user_defined|dense|banded|iterative|sparse");
   addOption("iterative_solverB",           OT_STRING,           GenericType(),  "","gmres|bcgstab|tfqmr");
   addOption("pretypeB",                    OT_STRING,           GenericType(),  "","none|left|right|both");
   addOption("max_krylovB",                 OT_INTEGER,          GenericType(),  "Maximum krylov subspace size");
@@ -89,6 +97,7 @@ void SundialsInternal::init(){
  
   // Reset checkpoints counter
   ncheck_ = 0;
+  num_steps_taped_ = 0;
 
   // Read options
   abstol_ = getOption("abstol");
@@ -107,6 +116,15 @@ void SundialsInternal::init(){
   max_krylov_ = getOption("max_krylov");
   max_krylovB_ =  hasSetOption("max_krylovB") ? int(getOption("max_krylovB")): max_krylov_;
   
+  // Checkpointing
+  steps_per_checkpoint_ = getOption("steps_per_checkpoint");
+  if(getOption("interpolation_type")=="hermite") hermite_ = true;
+  else if(getOption("interpolation_type")=="polynomial") hermite_ = false;
+  else throw CasadiException("\"interpolation_type\" must be \"hermite\" or \"polynomial\"");
+  checkpoint_memory_budget_ = 1e6*double(getOption("checkpoint_memory_budget"));
+  expected_num_steps_ = hasSetOption("expected_num_steps") ? int(getOption("expected_num_steps")) : max_num_steps_;
+  casadi_assert_message(expected_num_steps_>0, "SundialsInternal: \"expected_num_steps\" must be positive");
+  
   // Linear solver for forward integration
   if(getOption("linear_solver_type")=="dense"){
     linsol_f_ = SD_DENSE;
@@ -132,6 +150,8 @@ void SundialsInternal::init(){
     else                                           throw CasadiException("Unknown preconditioning type for forward integration");
   } else if(getOption("linear_solver_type")=="user_defined") {
     linsol_f_ = SD_USER_DEFINED;
+  } else if(getOption("linear_solver_type")=="sparse") {
+    linsol_f_ = SD_SPARSE;
   } else throw CasadiException("Unknown linear solver for forward integration");
   
   
@@ -164,6 +184,8 @@ void SundialsInternal::init(){
     else                                           throw CasadiException("Unknown preconditioning type for backward integration");
   } else if(linear_solver_typeB=="user_defined") {
     linsol_g_ = SD_USER_DEFINED;
+  } else if(linear_solver_typeB=="sparse") {
+    linsol_g_ = SD_SPARSE;
   } else {
    casadi_error("Unknown linear solver for backward integration: " << iterative_solverB);
   }
@@ -190,6 +212,12 @@ void SundialsInternal::init(){
     casadi_assert_message(!isSingular(jacB_.output().sparsity()),"SundialsInternal::init: singularity - the jacobian of the backward problem is structurally rank-deficient. sprank(J)=" << sprank(jacB_.output()) << " (in stead of "<< jacB_.output().size1() << ")");
   }
   
+  // A sparse direct solver is required with the sparse linear solver type
+  casadi_assert_message(linsol_f_!=SD_SPARSE || hasSetOption("linear_solver"), "SundialsInternal::init: linear_solver_type \"sparse\" requires a sparse direct linear solver, set the option \"linear_solver\", e.g. to CSparse");
+  casadi_assert_message(linsol_g_!=SD_SPARSE || g_.isNull() || hasSetOption("linear_solver") || hasSetOption("linear_solverB"), "SundialsInternal::init: linear_solver_typeB \"sparse\" requires a sparse direct linear solver, set the option \"linear_solverB\" or \"linear_solver\", e.g. to CSparse");
+  casadi_assert_message(linsol_f_!=SD_SPARSE || !jac_.isNull(), "SundialsInternal::init: linear_solver_type \"sparse\" requires a Jacobian, set the option \"exact_jacobian\" to true");
+  casadi_assert_message(linsol_g_!=SD_SPARSE || g_.isNull() || !jacB_.isNull(), "SundialsInternal::init: linear_solver_typeB \"sparse\" requires a Jacobian, set the option \"exact_jacobianB\" to true");
+  
   if(hasSetOption("linear_solver") && !jac_.isNull()){
     // Create a linear solver
     linearSolverCreator creator = getOption("linear_solver");
@@ -228,6 +256,59 @@ void SundialsInternal::reset(int nsens, int nsensB, int nsensB_store){
   
   // Go to the start time
   t_ = t0_;
+  
+  // Pass the parameters
+  passParameters();
+}
+
+double SundialsInternal::checkpointMemory(int nvec, int maxord, int ncheck, int nd) const{
+  // Hermite interpolation stores the solution and its derivative at every step, polynomial interpolation the solution only
+  int nvec_point = hermite_ ? 2 : 1;
+  return sizeof(double)*double(nvec)*(double(ncheck)*(maxord+1) + double(nd+1)*nvec_point);
+}
+
+int SundialsInternal::adaptStepsPerCheckpoint(int nvec, int maxord) const{
+  if(checkpoint_memory_budget_<=0) return steps_per_checkpoint_;
+  
+  // Number of steps of the previous forward integration, or the estimate before the first one
+  long nsteps = num_steps_taped_>0 ? num_steps_taped_ : expected_num_steps_;
+  
+  // Keep the current value as long as the data fits into the budget
+  if(checkpointMemory(nvec,maxord,(nsteps+steps_per_checkpoint_-1)/steps_per_checkpoint_,steps_per_checkpoint_)<=checkpoint_memory_budget_){
+    return steps_per_checkpoint_;
+  }
+  
+  // With N steps, N/nd checkpoints of maxord+1 vectors and nd interpolation points are stored, which is minimal for nd = sqrt(N*(maxord+1)/nvec_point)
+  int nvec_point = hermite_ ? 2 : 1;
+  return std::max(1,int(ceil(sqrt(double(nsteps)*(maxord+1)/nvec_point))));
+}
+
+void SundialsInternal::checkCheckpointMemory(int nvec, int maxord, long nsteps){
+  num_steps_taped_ = nsteps;
+  double mem = checkpointMemory(nvec,maxord,ncheck_,steps_per_checkpoint_);
+  if(gather_stats_){
+    stats_["steps_per_checkpoint"] = steps_per_checkpoint_;
+    stats_["checkpoint_memory"] = mem;
+  }
+  if(checkpoint_memory_budget_>0 && mem>checkpoint_memory_budget_){
+    int nd = adaptStepsPerCheckpoint(nvec,maxord);
+    double mem_min = checkpointMemory(nvec,maxord,(nsteps+nd-1)/nd,nd);
+    if(nd!=steps_per_checkpoint_ && mem_min<=checkpoint_memory_budget_){
+      casadi_warning("SundialsInternal: the data stored for the adjoint sensitivities (" << mem/1e6 << " MB) exceeds checkpoint_memory_budget (" 
+                     << checkpoint_memory_budget_/1e6 << " MB), steps_per_checkpoint will be changed from " << steps_per_checkpoint_ << " to " << nd << " at the next reset.");
+    } else {
+      casadi_warning("SundialsInternal: the data stored for the adjoint sensitivities (" << mem/1e6 << " MB) exceeds checkpoint_memory_budget (" 
+                     << checkpoint_memory_budget_/1e6 << " MB). With " << nsteps << " steps, at least " << mem_min/1e6 << " MB is needed.");
+    }
+  }
+}
+
+void SundialsInternal::passParameters(){
+  f_.setInput(input(INTEGRATOR_P),DAE_P);
+  if(!g_.isNull()){
+    g_.setInput(input(INTEGRATOR_P),RDAE_P);
+    g_.setInput(input(INTEGRATOR_RP),RDAE_RP);
+  }
 }
 
 } // namespace CasADi
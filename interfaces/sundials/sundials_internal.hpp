@@ -53,6 +53,12 @@ public:
   /** \brief  Set stop time for the integration */
   virtual void setStopTime(double tf) = 0;
   
+  /** \brief  Pass the parameters to the DAE functions
+   * The parameters are constant during the integration, so they are passed when the integration is reset or resumed
+   * rather than in every call of the right hand sides. 
+   */
+  void passParameters();
+  
   /// Linear solver forward, backward
   LinearSolver linsol_, linsolB_;
   
@@ -73,8 +79,38 @@ public:
   /// number of checkpoints stored so far
   int ncheck_; 
   
+  /// Number of steps between two consecutive checkpoints, adapted at reset if there is a memory budget
+  int steps_per_checkpoint_;
+  
+  /// Hermite (or polynomial) interpolation of the forward solution in the adjoint sensitivity analysis
+  bool hermite_;
+  
+  /// Memory budget in bytes for the data stored for the adjoint sensitivity analysis, 0 if none
+  double checkpoint_memory_budget_;
+  
+  /// Number of steps taken by the last forward integration with checkpointing
+  long num_steps_taped_;
+  
+  /// Estimate of the number of steps of the first forward integration with checkpointing
+  long expected_num_steps_;
+  
+  /** \brief Estimated memory in bytes of the data stored for the adjoint sensitivity analysis
+   * Every checkpoint holds the history array of the multistep method, maxord+1 vectors of length nvec, 
+   * and the interpolation data of one interval between two checkpoints is kept at a time.
+   */
+  double checkpointMemory(int nvec, int maxord, int ncheck, int nd) const;
+  
+  /** \brief Number of steps per checkpoint for the next forward integration
+   * If there is a memory budget, the current value is kept if the data for the number of steps of the last forward integration 
+   * (or expected_num_steps before the first one) fits into it, otherwise the stored data is minimized.
+   */
+  int adaptStepsPerCheckpoint(int nvec, int maxord) const;
+  
+  /** \brief Record the number of steps of a forward integration with checkpointing and check the stored data against the budget */
+  void checkCheckpointMemory(int nvec, int maxord, long nsteps);
+  
   /// Supported linear solvers in Sundials
-  enum LinearSolverType{SD_USER_DEFINED, SD_DENSE, SD_BANDED, SD_ITERATIVE};
+  enum LinearSolverType{SD_USER_DEFINED, SD_DENSE, SD_BANDED, SD_ITERATIVE, SD_SPARSE};
 
   /// Supported iterative solvers in Sundials
   enum IterativeSolverType{SD_GMRES,SD_BCGSTAB,SD_TFQMR};
@@ -84,8 +84,10 @@
 #ifdef WITH_CSPARSE
 %{
 #include "interfaces/csparse/csparse.hpp"
+#include "interfaces/csparse/csparse_ldl.hpp"
 %}
 %include "interfaces/csparse/csparse.hpp"
+%include "interfaces/csparse/csparse_ldl.hpp"
 #endif
 
 #ifdef WITH_DSDP
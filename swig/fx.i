@@ -71,6 +71,8 @@
 
 %{
 #include "integration/rk_integrator.hpp"
+#include "integration/dormand_prince_integrator.hpp"
 %}
 
 %include "integration/rk_integrator.hpp"
+%include "integration/dormand_prince_integrator.hpp"
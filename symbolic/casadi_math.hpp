@@ -96,6 +96,9 @@ struct casadi_math{
   /** \brief Evaluate the function and the derivative function */
   static inline void derF(unsigned char op, const T& x, const T& y, T& f, T* d);
   
+  /** \brief Evaluate a built in function elementwise for n arguments, the operation is dispatched only once */
+  static inline void fun(unsigned char op, const T* x, const T* y, T* f, int n);
+  
   /** \brief Number of dependencies */
   static inline int ndeps(unsigned char op);
   
@@ -307,6 +310,59 @@ inline void casadi_math<T>::derF(unsigned char op, const T& x, const T& y, T& f,
   }
 }
 
+template<typename T>
+inline void casadi_math<T>::fun(unsigned char op, const T* x, const T* y, T* f, int n){
+// NOTE: The loop is placed inside each case so that the switch is only evaluated once for all n elements
+#define CASADI_MATH_FUN_BUILTIN_N(X,Y,F,N) \
+    case OP_ASSIGN:     for(int i=0; i<N; ++i) BinaryOperation<OP_ASSIGN>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ADD:        for(int i=0; i<N; ++i) BinaryOperation<OP_ADD>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_SUB:        for(int i=0; i<N; ++i) BinaryOperation<OP_SUB>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_MUL:        for(int i=0; i<N; ++i) BinaryOperation<OP_MUL>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_DIV:        for(int i=0; i<N; ++i) BinaryOperation<OP_DIV>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_NEG:        for(int i=0; i<N; ++i) BinaryOperation<OP_NEG>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_EXP:        for(int i=0; i<N; ++i) BinaryOperation<OP_EXP>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_LOG:        for(int i=0; i<N; ++i) BinaryOperation<OP_LOG>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_POW:        for(int i=0; i<N; ++i) BinaryOperation<OP_POW>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_CONSTPOW:   for(int i=0; i<N; ++i) BinaryOperation<OP_CONSTPOW>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_SQRT:       for(int i=0; i<N; ++i) BinaryOperation<OP_SQRT>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_SIN:        for(int i=0; i<N; ++i) BinaryOperation<OP_SIN>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_COS:        for(int i=0; i<N; ++i) BinaryOperation<OP_COS>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_TAN:        for(int i=0; i<N; ++i) BinaryOperation<OP_TAN>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ASIN:       for(int i=0; i<N; ++i) BinaryOperation<OP_ASIN>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ACOS:       for(int i=0; i<N; ++i) BinaryOperation<OP_ACOS>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ATAN:       for(int i=0; i<N; ++i) BinaryOperation<OP_ATAN>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_LT:         for(int i=0; i<N; ++i) BinaryOperation<OP_LT>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_LE:         for(int i=0; i<N; ++i) BinaryOperation<OP_LE>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_EQ:         for(int i=0; i<N; ++i) BinaryOperation<OP_EQ>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_NE:         for(int i=0; i<N; ++i) BinaryOperation<OP_NE>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_NOT:        for(int i=0; i<N; ++i) BinaryOperation<OP_NOT>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_AND:        for(int i=0; i<N; ++i) BinaryOperation<OP_AND>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_OR:         for(int i=0; i<N; ++i) BinaryOperation<OP_OR>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_IF_ELSE_ZERO:for(int i=0; i<N; ++i) BinaryOperation<OP_IF_ELSE_ZERO>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_FLOOR:      for(int i=0; i<N; ++i) BinaryOperation<OP_FLOOR>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_CEIL:       for(int i=0; i<N; ++i) BinaryOperation<OP_CEIL>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_FABS:       for(int i=0; i<N; ++i) BinaryOperation<OP_FABS>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_SIGN:       for(int i=0; i<N; ++i) BinaryOperation<OP_SIGN>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ERF:        for(int i=0; i<N; ++i) BinaryOperation<OP_ERF>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_FMIN:       for(int i=0; i<N; ++i) BinaryOperation<OP_FMIN>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_FMAX:       for(int i=0; i<N; ++i) BinaryOperation<OP_FMAX>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_INV:        for(int i=0; i<N; ++i) BinaryOperation<OP_INV>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_SINH:       for(int i=0; i<N; ++i) BinaryOperation<OP_SINH>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_COSH:       for(int i=0; i<N; ++i) BinaryOperation<OP_COSH>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_TANH:       for(int i=0; i<N; ++i) BinaryOperation<OP_TANH>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ASINH:      for(int i=0; i<N; ++i) BinaryOperation<OP_ASINH>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ACOSH:      for(int i=0; i<N; ++i) BinaryOperation<OP_ACOSH>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ATANH:      for(int i=0; i<N; ++i) BinaryOperation<OP_ATANH>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ATAN2:      for(int i=0; i<N; ++i) BinaryOperation<OP_ATAN2>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_ERFINV:     for(int i=0; i<N; ++i) BinaryOperation<OP_ERFINV>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_LIFT:       for(int i=0; i<N; ++i) BinaryOperation<OP_LIFT>::fcn(X[i],Y[i],F[i]); break;\
+    case OP_PRINTME:    for(int i=0; i<N; ++i) BinaryOperation<OP_PRINTME>::fcn(X[i],Y[i],F[i]); break;
+  
+  switch(op){
+    CASADI_MATH_FUN_BUILTIN_N(x,y,f,n)
+  }
+}
+
 template<typename T>
 inline int casadi_math<T>::ndeps(unsigned char op){
 #define CASADI_MATH_BINARY_BUILTIN \
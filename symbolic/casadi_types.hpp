@@ -28,6 +28,14 @@
 #include <vector>
 #include <utility>
 
+#ifdef WITH_THREADSAFE_SYMBOLICS
+#ifndef USE_CXX11
+#error "WITH_THREADSAFE_SYMBOLICS requires a C++11 compiler"
+#endif // USE_CXX11
+#include <atomic>
+#include <mutex>
+#endif // WITH_THREADSAFE_SYMBOLICS
+
 namespace CasADi{
   
   /// Forward declarations
@@ -78,6 +86,37 @@ namespace CasADi{
   // Number of directions we can deal with at a time
   const int bvec_size = CHAR_BIT*sizeof(bvec_t); // the size of bvec_t in bits (CHAR_BIT is the number of bits per byte, usually 8)
 
+  // Type of the reference counters of SharedObjectNode and SXNode. If WITH_THREADSAFE_SYMBOLICS is defined, the counters are 
+  // atomic and the global caches are protected by mutexes, so that expressions and sparsity patterns can be shared between threads
+  // Creating functions is not covered: sorting an algorithm marks the nodes of the graph, so it must not run concurrently on overlapping graphs
+  #ifdef WITH_THREADSAFE_SYMBOLICS
+  typedef std::atomic<unsigned int> refcount_t;
+  #define CASADI_CACHE_LOCK(m) std::lock_guard<std::mutex> casadi_cache_lock_(m)
+  #else // WITH_THREADSAFE_SYMBOLICS
+  typedef unsigned int refcount_t;
+  #define CASADI_CACHE_LOCK(m)
+  #endif // WITH_THREADSAFE_SYMBOLICS
+  
+  /// Increase a reference counter unless it is zero, i.e. unless the object is being deleted in another thread
+  inline bool refcount_acquire(refcount_t& count){
+  #ifdef WITH_THREADSAFE_SYMBOLICS
+    unsigned int c = count.load();
+    while(c!=0){
+      if(count.compare_exchange_weak(c,c+1)) return true;
+    }
+    return false;
+  #else // WITH_THREADSAFE_SYMBOLICS
+    if(count==0) return false;
+    count++;
+    return true;
+  #endif // WITH_THREADSAFE_SYMBOLICS
+  }
+
+  /// Decrease a reference counter and return the new value. Only the caller that gets zero may delete the object
+  inline unsigned int refcount_release(refcount_t& count){
+    return --count;
+  }
+
   // Make sure that the integer datatype is indeed smaller or equal to the double
   //assert(sizeof(bvec_t) <= sizeof(double)); // doesn't work - very strange
 #endif // SWIG  
@@ -24,6 +24,7 @@
 #include "../mx/evaluation_mx.hpp"
 #include "../fx/mx_function.hpp"
 #include <typeinfo> 
+#include <fstream>
 #include "../stl_vector_tools.hpp"
 #include "../matrix/matrix_tools.hpp"
 #include "parallelizer.hpp"
@@ -117,7 +118,11 @@ void FX::evaluate(int nfdir, int nadir){
   assertInit();
   casadi_assert(nfdir<=(*this)->nfdir_);
   casadi_assert(nadir<=(*this)->nadir_);
-  (*this)->evaluate(nfdir,nadir);
+  if((*this)->hasResultCache()){
+    (*this)->evaluateCached(nfdir,nadir);
+  } else {
+    (*this)->evaluate(nfdir,nadir);
+  }
 }
 
 void FX::evaluateCompressed(int nfdir, int nadir){
@@ -414,5 +419,18 @@ void FX::generateCode(const string& filename){
   (*this)->generateCode(filename);
 }
 
+void FX::save(const string& filename) const{
+  ofstream f(filename.c_str(), ios::out | ios::binary);
+  casadi_assert_message(f.good(), "FX::save: Cannot open " << filename);
+  FXInternal::writeFunction(f,*this);
+  casadi_assert_message(f.good(), "FX::save: Error writing " << filename);
+}
+
+FX FX::load(const string& filename){
+  ifstream f(filename.c_str(), ios::in | ios::binary);
+  casadi_assert_message(f.good(), "FX::load: Cannot open " << filename);
+  return FXInternal::readFunction(f,filename);
+}
+
 } // namespace CasADi
 
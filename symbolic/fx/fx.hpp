@@ -338,6 +338,16 @@ class FX : public OptionsFunctionality{
 
   /** \brief Export / Generate C code for the function */
   void generateCode(const std::string& filename);
+
+  /** \brief Save the function to a file in a binary format (SXFunction and MXFunction only)
+  *
+  * The format is versioned and stores the algorithm and the input/output sparsity patterns,
+  * not the options. Embedded functions of an MXFunction are saved along with it.
+  */
+  void save(const std::string& filename) const;
+  
+  /** \brief Load a function saved with save, the function is returned uninitialized */
+  static FX load(const std::string& filename);
   
 #ifndef SWIG 
   /// Construct a function that has only the k'th output
@@ -24,11 +24,30 @@
 #include "../mx/evaluation_mx.hpp"
 #include <typeinfo> 
 #include "../stl_vector_tools.hpp"
-#include "mx_function.hpp"
+#include "mx_function_internal.hpp"
+#include "sx_function_internal.hpp"
 #include "../matrix/matrix_tools.hpp"
 #include "../sx/sx_tools.hpp"
 #include "../mx/mx_tools.hpp"
 #include "../matrix/sparsity_tools.hpp"
+#include "thread_pool.hpp"
+#include <fstream>
+#include <cstdio>
+#include <ctime>
+#include <cstring>
+#include <algorithm>
+#ifdef WITH_OPENMP
+#include <omp.h>
+#endif //WITH_OPENMP
+#ifndef _WIN32
+#include <unistd.h>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif // _WIN32
+#ifdef WITH_THREADS
+#include <atomic>
+#endif //WITH_THREADS
 
 using namespace std;
 
@@ -46,12 +65,19 @@ FXInternal::FXInternal(){
   addOption("numeric_jacobian",         OT_BOOLEAN,             false,          "Calculate Jacobians numerically (using directional derivatives) rather than with the built-in method");
   addOption("numeric_hessian",          OT_BOOLEAN,             false,          "Calculate Hessians numerically (using directional derivatives) rather than with the built-in method");
   addOption("ad_mode",                  OT_STRING,              "automatic",    "How to calculate the Jacobians.","forward: only forward mode|reverse: only adjoint mode|automatic: a heuristic decides which is more appropriate");
+  addOption("coloring",                 OT_STRING,              "serial",       "Graph coloring algorithm for the compression of Jacobians and Hessians","serial|parallel: speculative coloring with conflict resolution, concurrent if compiled with OpenMP");
+  addOption("coloring_ordering",        OT_STRING,              "largest_first","Vertex ordering of the coloring. For the unidirectional coloring (Jacobians), the ordering is only used if the option is set explicitly","natural|largest_first|smallest_last|incidence_degree");
   addOption("jacobian_generator",       OT_JACOBIANGENERATOR,   GenericType(),  "Function pointer that returns a Jacobian function given a set of desired Jacobian blocks, overrides internal routines");
   addOption("sparsity_generator",       OT_SPARSITYGENERATOR,   GenericType(),  "Function that provides sparsity for a given input output block, overrides internal routines");
   addOption("user_data",                OT_VOIDPTR,             GenericType(),  "A user-defined field that can be used to identify the function or pass additional information");
   addOption("monitor",      OT_STRINGVECTOR, GenericType(),  "Monitors to be activated","inputs|outputs");
   addOption("regularity_check",         OT_BOOLEAN,             true,          "Throw exceptions when NaN or Inf appears during evaluation");
   addOption("gather_stats",             OT_BOOLEAN,             false,         "Flag to indicate wether statistics must be gathered");
+  addOption("derivative_cache",         OT_STRING,              GenericType(), "Directory for a persistent cache of Jacobian sparsity patterns, seed colorings and Jacobian functions (if they can be saved with FX::save), "
+                                                                                       "keyed by a structural hash of the function and verified against the function when read. "
+                                                                                       "Files that are not owned by the user or are writable by the group or others are ignored");
+  addOption("sparsity_threads",         OT_INTEGER,             1,             "Number of threads propagating the sparsity pattern of Jacobians, each working on a deep copy of the function (requires compilation with WITH_THREADS)");
+  addOption("result_cache_size",        OT_INTEGER,             0,             "Number of evaluation results to keep, the least recently used are discarded. An evaluation with the same inputs and seeds as a cached one returns the cached outputs and sensitivities without evaluating. Only for functions whose results depend on nothing else (0: disabled)");
   
   verbose_ = false;
   jacgen_ = 0;
@@ -59,9 +85,12 @@ FXInternal::FXInternal(){
   user_data_ = 0;
   monitor_inputs_ = false;
   monitor_outputs_ = false;
+  result_cache_size_ = 0;
+  sp_pool_ = 0;
   
   inputScheme  = SCHEME_unknown;
   outputScheme = SCHEME_unknown;
+  function_cache_signature_set_ = false;
 }
 
 
@@ -109,6 +138,21 @@ void FXInternal::init(){
   
   gather_stats_ = getOption("gather_stats");
 
+  // On-disk cache for derivative information
+  if(hasSetOption("derivative_cache")){
+    derivative_cache_ = getOption("derivative_cache").toString();
+  } else {
+    derivative_cache_.clear();
+  }
+  function_cache_signature_.clear();
+  function_cache_signature_set_ = false;
+  
+  // Cache for evaluation results
+  result_cache_size_ = getOption("result_cache_size");
+  casadi_assert_message(result_cache_size_>=0, "FXInternal::init: result_cache_size must be nonnegative");
+  result_cache_.clear();
+  result_cache_hits_ = result_cache_misses_ = 0;
+
   // Mark the function as initialized
   is_init_ = true;
 }
@@ -235,12 +279,22 @@ FX FXInternal::getHessian(int iind, int oind){
   FX g = gradient(iind,oind);
   g.setOption("numeric_jacobian",getOption("numeric_hessian"));
   g.setOption("verbose",getOption("verbose"));
+  if(hasSetOption("derivative_cache")) g.setOption("derivative_cache",getOption("derivative_cache"));
+  g.setOption("coloring",getOption("coloring"));
+  g.setOption("coloring_ordering",getOption("coloring_ordering"));
   g.setInputScheme(inputScheme);
   g.init();
   
   // Return the Jacobian of the gradient, exploiting symmetry (the gradient has output index 0)
   log("FXInternal::getHessian generating Jacobian of gradient");
-  return g.jacobian(iind,0,false,true);
+  FX ret = g.jacobian(iind,0,false,true);
+  
+  // Report the coloring of the Hessian
+  const Dictionary& g_stats = g.getStats();
+  for(Dictionary::const_iterator it=g_stats.begin(); it!=g_stats.end(); ++it){
+    if(it->first=="coloring_time" || it->first=="num_colors") stats_[it->first] = it->second;
+  }
+  return ret;
 }
   
 void FXInternal::log(const string& msg) const{
@@ -353,7 +407,7 @@ CRSSparsity FXInternal::getJacSparsityPlain(int iind, int oind){
     }
     
     // Reset the virtual machine
-    spInit(use_fwd);
+    spInitSweeps(use_fwd);
 
     // Clear the forward seeds/adjoint sensitivities
     for(int ind=0; ind<getNumInputs(); ++ind){
@@ -367,12 +421,6 @@ CRSSparsity FXInternal::getJacSparsityPlain(int iind, int oind){
       if(!v.empty()) fill_n(get_bvec_t(v),v.size(),bvec_t(0));
     }
     
-    // Get seeds and sensitivities
-    bvec_t* input_v = get_bvec_t(inputNoCheck(iind).data());
-    bvec_t* output_v = get_bvec_t(outputNoCheck(oind).data());
-    bvec_t* seed_v = use_fwd ? input_v : output_v;
-    bvec_t* sens_v = use_fwd ? output_v : input_v;
-    
     // Number of sweeps needed
     int nsweep = use_fwd ? nsweep_fwd : nsweep_adj;
     
@@ -386,12 +434,20 @@ CRSSparsity FXInternal::getJacSparsityPlain(int iind, int oind){
       std::cout << nsweep << " sweeps needed for " << nz_seed << " directions" << endl;
     }
     
+    // Each nonzero of the sensitivities is a row block of its own
+    std::vector<int> coarse_row(2,0); coarse_row[1] = nz_sens;
+    std::vector<int> fine_row = range(nz_sens+1);
+    
     // Progress
     int progress = -10;
 
     // Temporary vectors
     std::vector<int> jrow, jcol;
     
+    // Sweeps to be propagated
+    std::vector<SpSweep> sweeps;
+    int group_size = spSweepGroupSize();
+    
     // Loop over the variables, ndir variables at a time
     for(int s=0; s<nsweep; ++s){
       
@@ -410,44 +466,19 @@ CRSSparsity FXInternal::getJacSparsityPlain(int iind, int oind){
 
       // Number of local seed directions
       int ndir_local = std::min(bvec_size,nz_seed-offset);
-
-      for(int i=0; i<ndir_local; ++i){
-        seed_v[offset+i] |= bvec_t(1)<<i;
-      }
-      
-      // Propagate the dependencies
-      spEvaluate(use_fwd);
       
-      // Loop over the nonzeros of the output
-      for(int el=0; el<nz_sens; ++el){
-
-        // Get the sparsity sensitivity
-        bvec_t spsens = sens_v[el];
-
-        // Clear the sensitivities for the next sweep
-        if(!use_fwd){
-          sens_v[el] = 0;
-        }
-  
-        // If there is a dependency in any of the directions
-        if(0!=spsens){
-          
-          // Loop over seed directions
-          for(int i=0; i<ndir_local; ++i){
-            
-            // If dependents on the variable
-            if((bvec_t(1) << i) & spsens){
-              // Add to pattern
-              jrow.push_back(el);
-              jcol.push_back(i+offset);
-            }
-          }
-        }
-      }
+      // One seed direction per bit
+      SpSweep sweep;
+      sweep.begin = range(offset,offset+ndir_local);
+      sweep.end = range(offset+1,offset+ndir_local+1);
+      sweep.bit = range(ndir_local);
+      sweep.lookup = IMatrix(1,bvec_size,offset);
+      sweeps.push_back(sweep);
       
-      // Remove the seeds
-      for(int i=0; i<bvec_size && offset+i<nz_seed; ++i){
-        seed_v[offset+i] = 0;
+      // Propagate the dependencies
+      if(sweeps.size()==group_size || s==nsweep-1){
+        spEvaluateSweeps(iind,oind,use_fwd,sweeps,coarse_row,fine_row,fine_row,false,jrow,jcol);
+        sweeps.clear();
       }
     }
     
@@ -520,7 +551,7 @@ CRSSparsity FXInternal::getJacSparsityHierarchicalSymm(int iind, int oind){
       casadi_log("Star coloring: " << D.size1() << " <-> " << D.size2());
       
       // Reset the virtual machine
-      spInit(true);
+      spInitSweeps(true);
       
       // Get seeds and sensitivities
       bvec_t* input_v = get_bvec_t(inputNoCheck(iind).data());
@@ -554,6 +585,11 @@ CRSSparsity FXInternal::getJacSparsityHierarchicalSymm(int iind, int oind){
       std::vector<int> lookup_col;
       std::vector<int> lookup_value;
       
+      // Sweeps to be propagated
+      std::vector<SpSweep> sweeps;
+      SpSweep sweep;
+      int group_size = spSweepGroupSize();
+      
       // Loop over all coarse seed directions from the coloring
       for(int csd=0; csd<D.size1(); ++csd) {
          // The maximum number of fine blocks contained in one coarse block
@@ -594,7 +630,9 @@ CRSSparsity FXInternal::getJacSparsityHierarchicalSymm(int iind, int oind){
                }
 
                // Toggle on seeds
-               bvec_toggle(seed_v,fine[fci+fci_start],fine[fci+fci_start+1],bvec_i+bvec_i_mod);
+               sweep.begin.push_back(fine[fci+fci_start]);
+               sweep.end.push_back(fine[fci+fci_start+1]);
+               sweep.bit.push_back(bvec_i+bvec_i_mod);
                bvec_i_mod++;
              }
            }
@@ -610,7 +648,8 @@ CRSSparsity FXInternal::getJacSparsityHierarchicalSymm(int iind, int oind){
               nsweeps+=1;
               
               // Construct lookup table
-              IMatrix lookup = IMatrix::sparse(lookup_row,lookup_col,lookup_value,coarse.size(),bvec_size);
+              IMatrix& lookup = sweep.lookup;
+              lookup = IMatrix::sparse(lookup_row,lookup_col,lookup_value,coarse.size(),bvec_size);
 
               std::reverse(lookup_row.begin(),lookup_row.end());
               std::reverse(lookup_col.begin(),lookup_col.end());
@@ -619,39 +658,14 @@ CRSSparsity FXInternal::getJacSparsityHierarchicalSymm(int iind, int oind){
               makeSparse(duplicates);
               lookup(duplicates.sparsity()) = -bvec_size;
               
-              // Propagate the dependencies
-              spEvaluate(true);
-              
-              // Temporary bit work vector
-              bvec_t spsens;
-              
-              // Loop over the rows of coarse blocks
-              for (int cri=0;cri<coarse.size()-1;++cri) {
-
-                // Loop over the rows of fine blocks within the current coarse block
-                for (int fri=fine_lookup[coarse[cri]];fri<fine_lookup[coarse[cri+1]];++fri) {
-                  // Lump individual sensitivities together into fine block
-                  bvec_or(sens_v,spsens,fine[fri],fine[fri+1]);
-  
-                  // Loop over all bvec_bits
-                  for (int bvec_i=0;bvec_i<bvec_size;++bvec_i) {
-                    if (spsens & (bvec_t(1) << bvec_i)) {
-                      // if dependency is found, add it to the new sparsity pattern
-                      int lk = lookup.elem(cri,bvec_i);
-                      if (lk>-bvec_size) {
-                        jcol.push_back(bvec_i+lk);
-                        jrow.push_back(fri);
-                        jcol.push_back(fri);
-                        jrow.push_back(bvec_i+lk);
-                      }
-                    }
-                  }
-                }
+              // Propagate the dependencies once enough sweeps have been collected
+              sweeps.push_back(sweep);
+              sweep = SpSweep();
+              if(sweeps.size()==group_size){
+                spEvaluateSweeps(iind,oind,true,sweeps,coarse,fine,fine_lookup,true,jrow,jcol);
+                sweeps.clear();
               }
               
-              // Clean seed vector, ready for next bvec sweep
-              for(int i=0; i<nz; ++i) seed_v[i]=0;
-              
               // Clean lookup table
               lookup_row.clear();
               lookup_col.clear();
@@ -669,6 +683,9 @@ CRSSparsity FXInternal::getJacSparsityHierarchicalSymm(int iind, int oind){
          }
          
       }
+      
+      // Propagate the dependencies of the remaining sweeps
+      if(!sweeps.empty()) spEvaluateSweeps(iind,oind,true,sweeps,coarse,fine,fine_lookup,true,jrow,jcol);
 
       // Construct fine sparsity pattern
       r = sp_triplet(fine.size()-1, fine.size()-1, jrow, jcol);
@@ -772,7 +789,7 @@ CRSSparsity FXInternal::getJacSparsityHierarchical(int iind, int oind){
       }
       
       // Reset the virtual machine
-      spInit(use_fwd);
+      spInitSweeps(use_fwd);
       
       // Get seeds and sensitivities
       bvec_t* input_v = get_bvec_t(inputNoCheck(iind).data());
@@ -831,6 +848,11 @@ CRSSparsity FXInternal::getJacSparsityHierarchical(int iind, int oind){
       std::vector<int> lookup_col;
       std::vector<int> lookup_value;
       
+      // Sweeps to be propagated
+      std::vector<SpSweep> sweeps;
+      SpSweep sweep;
+      int group_size = spSweepGroupSize();
+      
       // Loop over all coarse seed directions from the coloring
       for(int csd=0; csd<D.size1(); ++csd) {
       
@@ -870,7 +892,9 @@ CRSSparsity FXInternal::getJacSparsityHierarchical(int iind, int oind){
                }
 
                // Toggle on seeds
-               bvec_toggle(seed_v,fine_col[fci+fci_start],fine_col[fci+fci_start+1],bvec_i+bvec_i_mod);
+               sweep.begin.push_back(fine_col[fci+fci_start]);
+               sweep.end.push_back(fine_col[fci+fci_start+1]);
+               sweep.bit.push_back(bvec_i+bvec_i_mod);
                bvec_i_mod++;
              }
            }
@@ -886,36 +910,16 @@ CRSSparsity FXInternal::getJacSparsityHierarchical(int iind, int oind){
               nsweeps+=1; 
               
               // Construct lookup table
-              IMatrix lookup = IMatrix::sparse(lookup_row,lookup_col,lookup_value,coarse_row.size(),bvec_size);
-
-              // Propagate the dependencies
-              spEvaluate(use_fwd);
-              
-              // Temporary bit work vector
-              bvec_t spsens;
+              sweep.lookup = IMatrix::sparse(lookup_row,lookup_col,lookup_value,coarse_row.size(),bvec_size);
               
-              // Loop over the rows of coarse blocks
-              for (int cri=0;cri<coarse_row.size()-1;++cri) {
-
-                // Loop over the rows of fine blocks within the current coarse block
-                for (int fri=fine_row_lookup[coarse_row[cri]];fri<fine_row_lookup[coarse_row[cri+1]];++fri) {
-                  // Lump individual sensitivities together into fine block
-                  bvec_or(sens_v,spsens,fine_row[fri],fine_row[fri+1]);
-  
-                  // Loop over all bvec_bits
-                  for (int bvec_i=0;bvec_i<bvec_size;++bvec_i) {
-                    if (spsens & (bvec_t(1) << bvec_i)) {
-                      // if dependency is found, add it to the new sparsity pattern
-                      jcol.push_back(bvec_i+lookup.elem(cri,bvec_i));
-                      jrow.push_back(fri);
-                    }
-                  }
-                }
+              // Propagate the dependencies once enough sweeps have been collected
+              sweeps.push_back(sweep);
+              sweep = SpSweep();
+              if(sweeps.size()==group_size){
+                spEvaluateSweeps(iind,oind,use_fwd,sweeps,coarse_row,fine_row,fine_row_lookup,false,jrow,jcol);
+                sweeps.clear();
               }
               
-              // Clean seed vector, ready for next bvec sweep
-              for(int i=0; i<nz_seed; ++i) seed_v[i]=0;
-              
               // Clean lookup table
               lookup_row.clear();
               lookup_col.clear();
@@ -933,6 +937,9 @@ CRSSparsity FXInternal::getJacSparsityHierarchical(int iind, int oind){
          }
          
       }
+      
+      // Propagate the dependencies of the remaining sweeps
+      if(!sweeps.empty()) spEvaluateSweeps(iind,oind,use_fwd,sweeps,coarse_row,fine_row,fine_row_lookup,false,jrow,jcol);
 
       // Swap results if adjoint mode was used
       if (use_fwd) {
@@ -957,16 +964,46 @@ CRSSparsity FXInternal::getJacSparsity(int iind, int oind, bool symmetric){
   // Check if we are able to propagate dependencies through the function
   if(spCanEvaluate(true) || spCanEvaluate(false)){
     
-    if (input(iind).size()>1 && output(oind).size()>1) {
-      if (symmetric) {
-        return getJacSparsityHierarchicalSymm(iind, oind);
+    // Propagate on several threads, each with its own copy of the function
+    int sparsity_threads = getOption("sparsity_threads");
+    if(sparsity_threads>1){
+#ifdef WITH_THREADS
+      for(int t=1; t<sparsity_threads; ++t){
+        sp_copies_.push_back(deepcopy(shared_from_this<FX>()));
+      }
+      sp_pool_ = new ThreadPool(sparsity_threads,false);
+#else // WITH_THREADS
+      casadi_warning("FXInternal::getJacSparsity: sparsity_threads requires thread pool support, propagating on one thread. Recompile CasADi with C++11 support and the option WITH_THREADS set to ON.");
+#endif // WITH_THREADS
+    }
+    
+    CRSSparsity ret;
+    try{
+      if (input(iind).size()>1 && output(oind).size()>1) {
+        if (symmetric) {
+          ret = getJacSparsityHierarchicalSymm(iind, oind);
+        } else {
+          ret = getJacSparsityHierarchical(iind, oind);
+        }
       } else {
-        return getJacSparsityHierarchical(iind, oind);
+        ret = getJacSparsityPlain(iind, oind);
       }
-    } else {
-      return getJacSparsityPlain(iind, oind);
+    } catch(...){
+      sp_copies_.clear();
+#ifdef WITH_THREADS
+      delete sp_pool_;
+#endif // WITH_THREADS
+      sp_pool_ = 0;
+      throw;
     }
-
+    
+    // Free the copies and the threads
+    sp_copies_.clear();
+#ifdef WITH_THREADS
+    delete sp_pool_;
+#endif // WITH_THREADS
+    sp_pool_ = 0;
+    return ret;
 
   } else {
     // Dense sparsity by default
@@ -974,6 +1011,117 @@ CRSSparsity FXInternal::getJacSparsity(int iind, int oind, bool symmetric){
   }
 }
 
+void FXInternal::spInitSweeps(bool use_fwd){
+  spInit(use_fwd);
+  for(vector<FX>::iterator it=sp_copies_.begin(); it!=sp_copies_.end(); ++it){
+    FXInternal* f = static_cast<FXInternal*>(it->get());
+    
+    // Clear all seeds and sensitivities of the copy
+    for(int ind=0; ind<f->getNumInputs(); ++ind){
+      vector<double> &v = f->inputNoCheck(ind).data();
+      if(!v.empty()) fill_n(get_bvec_t(v),v.size(),bvec_t(0));
+    }
+    for(int ind=0; ind<f->getNumOutputs(); ++ind){
+      vector<double> &v = f->outputNoCheck(ind).data();
+      if(!v.empty()) fill_n(get_bvec_t(v),v.size(),bvec_t(0));
+    }
+    f->spInit(use_fwd);
+  }
+}
+
+int FXInternal::spSweepGroupSize() const{
+#ifdef WITH_THREADS
+  // A few sweeps per thread for load balancing
+  if(sp_pool_!=0) return 4*sp_pool_->size();
+#endif // WITH_THREADS
+  return 1;
+}
+
+void FXInternal::spEvaluateSweeps(int iind, int oind, bool use_fwd, const std::vector<SpSweep>& sweeps, const std::vector<int>& coarse_row, 
+                                  const std::vector<int>& fine_row, const std::vector<int>& fine_row_lookup, bool symmetric, 
+                                  std::vector<int>& jrow, std::vector<int>& jcol){
+#ifdef WITH_THREADS
+  if(sp_pool_!=0 && sweeps.size()>1){
+    // Dependencies found by each sweep
+    int nsweeps = sweeps.size();
+    vector<vector<int> > sweep_jrow(nsweeps), sweep_jcol(nsweeps);
+    
+    // The threads take the sweeps in turn, thread 0 propagates through this function
+    atomic<int> next(0);
+    sp_pool_->run([&](int thread){
+      FXInternal* f = thread==0 ? this : static_cast<FXInternal*>(sp_copies_[thread-1].get());
+      for(int k=next++; k<nsweeps; k=next++){
+        spEvaluateSweep(f,iind,oind,use_fwd,sweeps[k],coarse_row,fine_row,fine_row_lookup,symmetric,sweep_jrow[k],sweep_jcol[k]);
+      }
+    });
+    
+    // Collect in the order of the sweeps
+    for(int k=0; k<nsweeps; ++k){
+      jrow.insert(jrow.end(),sweep_jrow[k].begin(),sweep_jrow[k].end());
+      jcol.insert(jcol.end(),sweep_jcol[k].begin(),sweep_jcol[k].end());
+    }
+    return;
+  }
+#endif // WITH_THREADS
+  for(vector<SpSweep>::const_iterator it=sweeps.begin(); it!=sweeps.end(); ++it){
+    spEvaluateSweep(this,iind,oind,use_fwd,*it,coarse_row,fine_row,fine_row_lookup,symmetric,jrow,jcol);
+  }
+}
+
+void FXInternal::spEvaluateSweep(FXInternal* f, int iind, int oind, bool use_fwd, const SpSweep& sweep, const std::vector<int>& coarse_row, 
+                                 const std::vector<int>& fine_row, const std::vector<int>& fine_row_lookup, bool symmetric, 
+                                 std::vector<int>& jrow, std::vector<int>& jcol){
+  // Get seeds and sensitivities
+  bvec_t* input_v = get_bvec_t(f->inputNoCheck(iind).data());
+  bvec_t* output_v = get_bvec_t(f->outputNoCheck(oind).data());
+  bvec_t* seed_v = use_fwd ? input_v : output_v;
+  bvec_t* sens_v = use_fwd ? output_v : input_v;
+  
+  // Toggle on seeds
+  for(int k=0; k<sweep.bit.size(); ++k){
+    bvec_toggle(seed_v,sweep.begin[k],sweep.end[k],sweep.bit[k]);
+  }
+  
+  // Propagate the dependencies
+  f->spEvaluate(use_fwd);
+  
+  // Temporary bit work vector
+  bvec_t spsens;
+  
+  // Loop over the rows of coarse blocks
+  for (int cri=0;cri<coarse_row.size()-1;++cri) {
+    
+    // Loop over the rows of fine blocks within the current coarse block
+    for (int fri=fine_row_lookup[coarse_row[cri]];fri<fine_row_lookup[coarse_row[cri+1]];++fri) {
+      // Lump individual sensitivities together into fine block
+      bvec_or(sens_v,spsens,fine_row[fri],fine_row[fri+1]);
+      if(spsens==0) continue;
+      
+      // Loop over all bvec_bits
+      for (int bvec_i=0;bvec_i<bvec_size;++bvec_i) {
+        if (spsens & (bvec_t(1) << bvec_i)) {
+          // if dependency is found, add it to the new sparsity pattern
+          int lk = sweep.lookup.elem(cri,bvec_i);
+          if (lk>-bvec_size) {
+            jcol.push_back(bvec_i+lk);
+            jrow.push_back(fri);
+            if(symmetric){
+              jcol.push_back(fri);
+              jrow.push_back(bvec_i+lk);
+            }
+          }
+        }
+      }
+    }
+  }
+  
+  // Clean the seeds, and the sensitivities in adjoint mode, ready for the next sweep
+  for(int k=0; k<sweep.bit.size(); ++k){
+    bvec_clear(seed_v,sweep.begin[k],sweep.end[k]);
+  }
+  if(!use_fwd) bvec_clear(sens_v,0,fine_row.back());
+}
+
 void FXInternal::setJacSparsity(const CRSSparsity& sp, int iind, int oind, bool compact){
   if(compact){
     jac_sparsity_compact_[iind][oind] = sp;
@@ -992,8 +1140,21 @@ CRSSparsity& FXInternal::jacSparsity(int iind, int oind, bool compact, bool symm
   if(jsp.isNull()){
     if(compact){
       if(spgen_==0){
-        // Use internal routine to determine sparsity
-        jsp = getJacSparsity(iind,oind,symmetric);
+        // Look for the sparsity pattern in the on-disk cache
+        string fname = derivativeCacheFile(symmetric ? "jacsp_sym" : "jacsp",iind,oind);
+        string signature = fname.empty() ? string() : derivativeCacheSignature();
+        vector<CRSSparsity> cached;
+        if(!fname.empty() && readSparsityCache(fname,signature,cached) && cached.size()==1 && !cached.front().isNull()
+           && cached.front().size1()==output(oind).size() && cached.front().size2()==input(iind).size()){
+          if(verbose()) cout << "FXInternal::jacSparsity: loaded from " << fname << endl;
+          jsp = cached.front();
+        } else {
+          // Use internal routine to determine sparsity
+          jsp = getJacSparsity(iind,oind,symmetric);
+          
+          // Save to the cache
+          if(!fname.empty() && !jsp.isNull()) writeSparsityCache(fname,signature,vector<CRSSparsity>(1,jsp));
+        }
       } else {
         // Create a temporary FX instance
         FX tmp;
@@ -1043,6 +1204,15 @@ CRSSparsity& FXInternal::jacSparsity(int iind, int oind, bool compact, bool symm
   return jsp;
 }
 
+/// Time in seconds, for timing the graph coloring (wall time if compiled with OpenMP, otherwise processor time)
+static double coloringTime(){
+#ifdef WITH_OPENMP
+  return omp_get_wtime();
+#else // WITH_OPENMP
+  return double(clock())/CLOCKS_PER_SEC;
+#endif // WITH_OPENMP
+}
+
 void FXInternal::getPartition(int iind, int oind, CRSSparsity& D1, CRSSparsity& D2, bool compact, bool symmetric){
   log("FXInternal::getPartition begin");
   
@@ -1062,12 +1232,63 @@ void FXInternal::getPartition(int iind, int oind, CRSSparsity& D1, CRSSparsity&
     casadi_error("FXInternal::jac: Unknown ad_mode \"" << getOption("ad_mode") << "\". Possible values are \"forward\", \"reverse\" and \"automatic\".");
   }
   
+  // Look for the coloring in the on-disk cache, the coloring depends on the options for the mode and the algorithm
+  double time_start = coloringTime();
+  stringstream kind;
+  kind << "partition_" << getOption("ad_mode") << "_" << getOption("coloring") << "_" << getOption("coloring_ordering") 
+       << (compact ? "_compact" : "") << (symmetric ? "_sym" : "");
+  string fname = derivativeCacheFile(kind.str(),iind,oind);
+  string signature;
+  if(!fname.empty()){
+    // Otherwise, the coloring only depends on the sparsity pattern, which is stored along with it
+    signature = derivativeCacheSignature();
+    vector<CRSSparsity> cached;
+    if(readSparsityCache(fname,signature,cached) && cached.size()==3 && !cached[0].isNull() && cached[0]==A
+       && (cached[1].isNull() || cached[1].size2()==A.size2()) && (cached[2].isNull() || cached[2].size2()==A.size1())
+       && !(cached[1].isNull() && cached[2].isNull()) && !(symmetric && cached[1].isNull())){
+      if(verbose()) cout << "FXInternal::getPartition: loaded from " << fname << endl;
+      D1 = cached[1];
+      D2 = cached[2];
+      
+      // Report the size of the coloring and the time it took to load it
+      stats_["coloring_time"] = coloringTime()-time_start;
+      stats_["num_colors"] = D1.isNull() ? D2.size1() : D1.size1();
+      log("FXInternal::getPartition end");
+      return;
+    }
+  }
+  
+  // Coloring algorithm
+  bool parallel_coloring;
+  if(getOption("coloring")=="serial"){
+    parallel_coloring = false;
+  } else if(getOption("coloring")=="parallel"){
+    parallel_coloring = true;
+  } else {
+    casadi_error("FXInternal::getPartition: Unknown coloring \"" << getOption("coloring") << "\". Possible values are \"serial\" and \"parallel\".");
+  }
+  time_start = coloringTime();
+  
+  // Vertex ordering
+  int ordering;
+  if(getOption("coloring_ordering")=="natural"){
+    ordering = 0;
+  } else if(getOption("coloring_ordering")=="largest_first"){
+    ordering = 1;
+  } else if(getOption("coloring_ordering")=="smallest_last"){
+    ordering = 2;
+  } else if(getOption("coloring_ordering")=="incidence_degree"){
+    ordering = 3;
+  } else {
+    casadi_error("FXInternal::getPartition: Unknown coloring_ordering \"" << getOption("coloring_ordering") << "\". Possible values are \"natural\", \"largest_first\", \"smallest_last\" and \"incidence_degree\".");
+  }
+  
   // Get seed matrices by graph coloring
   if(symmetric){
   
     // Star coloring if symmetric
     log("FXInternal::getPartition starColoring");
-    D1 = A.starColoring();
+    D1 = parallel_coloring ? A.parallelStarColoring(ordering) : A.starColoring(ordering);
     if(verbose()){
       cout << "Star coloring completed: " << D1.size1() << " directional derivatives needed (" << A.size2() << " without coloring)." << endl;
     }
@@ -1077,6 +1298,9 @@ void FXInternal::getPartition(int iind, int oind, CRSSparsity& D1, CRSSparsity&
     // Adjoint mode penalty factor (adjoint mode is usually more expensive to calculate)
     int adj_penalty = 2;
 
+    // The ordering needs the graph of the rows sharing a column, which can be much denser than A, so only use it if requested
+    int uni_ordering = hasSetOption("coloring_ordering") ? ordering : 0;
+
     // Best coloring encountered so far
     int best_coloring = numeric_limits<int>::max();
 
@@ -1096,7 +1320,7 @@ void FXInternal::getPartition(int iind, int oind, CRSSparsity& D1, CRSSparsity&
       // Perform the coloring
       if(fwd){
 	log("FXInternal::getPartition unidirectional coloring (forward mode)");
-	D1 = AT.unidirectionalColoring(A,best_coloring);
+	D1 = parallel_coloring ? AT.parallelUnidirectionalColoring(A,best_coloring,uni_ordering) : AT.unidirectionalColoring(A,best_coloring,uni_ordering);
 	if(D1.isNull()){
 	  if(verbose()) cout << "Forward mode coloring interrupted (more than " << best_coloring << " needed)." << endl; 
 	} else {
@@ -1107,7 +1331,7 @@ void FXInternal::getPartition(int iind, int oind, CRSSparsity& D1, CRSSparsity&
       } else {
 	log("FXInternal::getPartition unidirectional coloring (adjoint mode)");
 	int max_colorings_to_test = best_coloring/adj_penalty;
-	D2 = A.unidirectionalColoring(AT,max_colorings_to_test);	
+	D2 = parallel_coloring ? A.parallelUnidirectionalColoring(AT,max_colorings_to_test,uni_ordering) : A.unidirectionalColoring(AT,max_colorings_to_test,uni_ordering);
 	if(D2.isNull()){
 	  if(verbose()) cout << "Adjoint mode coloring interrupted (more than " << max_colorings_to_test << " needed)." << endl; 
 	} else {
@@ -1118,7 +1342,284 @@ void FXInternal::getPartition(int iind, int oind, CRSSparsity& D1, CRSSparsity&
       }
     }
 
-    log("FXInternal::getPartition end");
+  }
+  
+  // Report the size of the coloring and the time it took
+  double coloring_time = coloringTime()-time_start;
+  stats_["coloring_time"] = coloring_time;
+  stats_["num_colors"] = D1.isNull() ? D2.size1() : D1.size1();
+  if(verbose()) cout << "FXInternal::getPartition: coloring took " << coloring_time << " s" << endl;
+  
+  // Save to the cache
+  if(!fname.empty()){
+    vector<CRSSparsity> D(3);
+    D[0] = A;
+    D[1] = D1;
+    D[2] = D2;
+    writeSparsityCache(fname,signature,D);
+  }
+  log("FXInternal::getPartition end");
+}
+
+std::string FXInternal::derivativeCacheFile(const std::string& kind, int iind, int oind, const std::string& ext) const{
+  // Quick return if disabled
+  if(derivative_cache_.empty()) return std::string();
+  
+  // Hash the structure of the function
+  std::size_t h = 0;
+  if(!structuralHash(h)) return std::string();
+  
+  // Assemble the file name
+  stringstream ss;
+  ss << derivative_cache_ << "/casadi_" << hex << h << dec << "_" << kind << "_" << iind << "_" << oind << ext;
+  return ss.str();
+}
+
+std::string FXInternal::derivativeCacheSignature() const{
+  stringstream ss;
+  
+  // Structural hash with another seed than the one in the file name
+  std::size_t h = 0x5bd1e995;
+  structuralHash(h);
+  writeBinary(ss,h);
+  
+  // Input and output sparsity patterns
+  writeBinary(ss,getNumInputs());
+  for(int ind=0; ind<getNumInputs(); ++ind) writeBinary(ss,input(ind).sparsity());
+  writeBinary(ss,getNumOutputs());
+  for(int ind=0; ind<getNumOutputs(); ++ind) writeBinary(ss,output(ind).sparsity());
+  return ss.str();
+}
+
+/// Check a file of the derivative cache before deserializing it: it must be a regular file owned by the user that nobody else can modify
+static bool cacheFileIsPrivate(const std::string& fname){
+#ifndef _WIN32
+  struct stat st;
+  if(lstat(fname.c_str(),&st)!=0) return false;
+  if(S_ISREG(st.st_mode) && st.st_uid==geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH))==0) return true;
+  casadi_warning("FXInternal: Ignoring " << fname << " in the derivative cache, it must be a regular file owned by the user and not writable by the group or others");
+  return false;
+#else // _WIN32
+  return true;
+#endif // _WIN32
+}
+
+/// Write a file of the derivative cache: the data goes to a temporary file with a unique name, which is then moved in place so that readers never see an incomplete file
+static void writeCacheFile(const std::string& fname, const std::string& data, const std::string& caller){
+#ifndef _WIN32
+  // Created with permissions for the user only
+  string tmpname = fname + ".XXXXXX";
+  int fd = mkstemp(&tmpname[0]);
+  if(fd<0){
+    casadi_warning(caller << ": Cannot create a temporary file for " << fname);
+    return;
+  }
+  FILE* f = fdopen(fd,"wb");
+  bool written = f!=0 && fwrite(data.data(),1,data.size(),f)==data.size();
+  if(f!=0) written = fclose(f)==0 && written;
+  else close(fd);
+#else // _WIN32
+  stringstream ss;
+  ss << fname << ".tmp" << time(0) << "_" << &data;
+  string tmpname = ss.str();
+  ofstream f(tmpname.c_str(), ios::out | ios::binary);
+  f.write(data.data(),data.size());
+  f.close();
+  bool written = f.good();
+#endif // _WIN32
+  if(!written){
+    remove(tmpname.c_str());
+    casadi_warning(caller << ": Cannot write to " << tmpname);
+    return;
+  }
+  
+  // The file may have been published by another process in the meantime
+  if(rename(tmpname.c_str(),fname.c_str())!=0) remove(tmpname.c_str());
+}
+
+bool FXInternal::readSparsityCache(const std::string& fname, const std::string& signature, std::vector<CRSSparsity>& sp){
+  if(!cacheFileIsPrivate(fname)) return false;
+  ifstream f(fname.c_str(), ios::in | ios::binary);
+  if(!f.good()) return false;
+  
+  // Check the header
+  char magic[8];
+  int version=0, n=0;
+  f.read(magic,8);
+  readBinary(f,version);
+  if(!f.good() || string(magic,8)!="CASADISP" || version!=2) return false;
+  
+  // Check that the file was written for the same function
+  string file_signature;
+  try{
+    readBinary(f,file_signature);
+  } catch(exception& ex){
+    return false;
+  }
+  if(!f.good() || file_signature!=signature) return false;
+  
+  // Read the patterns
+  readBinary(f,n);
+  if(!f.good() || n<0) return false;
+  sp.resize(n);
+  try{
+    for(int k=0; k<n; ++k) readBinary(f,sp[k]);
+  } catch(exception& ex){
+    return false;
+  }
+  return f.good();
+}
+
+void FXInternal::writeSparsityCache(const std::string& fname, const std::string& signature, const std::vector<CRSSparsity>& sp){
+  stringstream f;
+  
+  // Header
+  int version=2, n=sp.size();
+  f.write("CASADISP",8);
+  writeBinary(f,version);
+  writeBinary(f,signature);
+  writeBinary(f,n);
+  
+  // Patterns
+  for(vector<CRSSparsity>::const_iterator it=sp.begin(); it!=sp.end(); ++it){
+    writeBinary(f,*it);
+  }
+  writeCacheFile(fname,f.str(),"FXInternal::writeSparsityCache");
+}
+
+const std::string& FXInternal::functionCacheSignature() const{
+  if(!function_cache_signature_set_){
+    function_cache_signature_set_ = true;
+    stringstream signature;
+    try{
+      serialize(signature);
+      function_cache_signature_ = signature.str();
+    } catch(exception& ex){
+      if(verbose()) cout << "FXInternal::functionCacheSignature: function files are not cached: " << ex.what() << endl;
+      function_cache_signature_.clear();
+    }
+  }
+  return function_cache_signature_;
+}
+
+FX FXInternal::readFunctionCache(const std::string& fname) const{
+  // Functions that cannot be serialized are not cached
+  const string& signature = functionCacheSignature();
+  if(signature.empty() || !cacheFileIsPrivate(fname)) return FX();
+  ifstream f(fname.c_str(), ios::in | ios::binary);
+  if(!f.good()) return FX();
+  try{
+    // Check that the file was written for the same function
+    string file_signature;
+    readBinary(f,file_signature);
+    if(!f.good() || file_signature!=signature) return FX();
+    
+    // Read the derivative function
+    return readFunction(f,fname);
+  } catch(exception& ex){
+    if(verbose()) cout << "FXInternal::readFunctionCache: cannot read " << fname << ": " << ex.what() << endl;
+    return FX();
+  }
+}
+
+void FXInternal::writeFunctionCache(const std::string& fname, const FX& fcn) const{
+  // Serialize both functions, functions that cannot be serialized are not cached
+  const string& signature = functionCacheSignature();
+  if(signature.empty()) return;
+  stringstream data;
+  writeBinary(data,signature);
+  try{
+    writeFunction(data,fcn);
+  } catch(exception& ex){
+    if(verbose()) cout << "FXInternal::writeFunctionCache: not cached: " << ex.what() << endl;
+    return;
+  }
+  writeCacheFile(fname,data.str(),"FXInternal::writeFunctionCache");
+}
+
+void FXInternal::writeFunction(std::ostream& stream, const FX& f){
+  // Header: magic string, format version and a check of the binary layout
+  stream.write("CASADIFX",8);
+  writeBinary(stream,int(CASADI_SERIALIZATION_VERSION));
+  writeBinary(stream,int(0x01020304));
+  writeBinary(stream,int(sizeof(int)));
+  writeBinary(stream,int(sizeof(double)));
+
+  // The function
+  f->serialize(stream);
+}
+
+FX FXInternal::readFunction(std::istream& stream, const std::string& name){
+  // Check header
+  char magic[8];
+  int version=0, endian=0, sz_int=0, sz_double=0;
+  stream.read(magic,8);
+  readBinary(stream,version);
+  readBinary(stream,endian);
+  readBinary(stream,sz_int);
+  readBinary(stream,sz_double);
+  casadi_assert_message(stream.good() && string(magic,8)=="CASADIFX", "FX::load: " << name << " is not a CasADi function file");
+  casadi_assert_message(version==CASADI_SERIALIZATION_VERSION, "FX::load: " << name << " has format version " << version << ", expected " << CASADI_SERIALIZATION_VERSION);
+  casadi_assert_message(endian==0x01020304 && sz_int==sizeof(int) && sz_double==sizeof(double), "FX::load: " << name << " was written on a platform with a different binary layout");
+
+  // Read the function
+  FX ret = deserialize(stream);
+  casadi_assert_message(!stream.fail(), "FX::load: Error reading " << name);
+  return ret;
+}
+
+void FXInternal::writeBinary(std::ostream& stream, const std::string& v){
+  writeBinary(stream,vector<char>(v.begin(),v.end()));
+}
+
+void FXInternal::readBinary(std::istream& stream, std::string& v){
+  vector<char> c;
+  readBinary(stream,c);
+  v = string(c.begin(),c.end());
+}
+
+void FXInternal::writeBinary(std::ostream& stream, const CRSSparsity& v){
+  if(v.isNull()){
+    // Marker for a null pattern
+    writeBinary(stream,int(-1));
+  } else {
+    writeBinary(stream,v.size1());
+    writeBinary(stream,v.size2());
+    writeBinary(stream,v.col());
+    writeBinary(stream,v.rowind());
+  }
+}
+
+void FXInternal::readBinary(std::istream& stream, CRSSparsity& v){
+  int nrow=-2, ncol=-1;
+  readBinary(stream,nrow);
+  casadi_assert_message(stream.good() && nrow>=-1, "FXInternal::readBinary: Corrupt sparsity pattern");
+  if(nrow<0){
+    v = CRSSparsity();
+  } else {
+    readBinary(stream,ncol);
+    vector<int> col, rowind;
+    readBinary(stream,col);
+    readBinary(stream,rowind);
+    casadi_assert_message(stream.good() && ncol>=0 && rowind.size()==nrow+1 && rowind.back()==col.size(), "FXInternal::readBinary: Corrupt sparsity pattern");
+    v = CRSSparsity(nrow,ncol,col,rowind);
+  }
+}
+
+void FXInternal::serialize(std::ostream& stream) const{
+  casadi_error("FXInternal::serialize: serialization not defined for class " << typeid(*this).name());
+}
+
+FX FXInternal::deserialize(std::istream& stream){
+  // The type of the function
+  string type;
+  readBinary(stream,type);
+  if(type=="SXFunction"){
+    return SXFunctionInternal::deserialize(stream);
+  } else if(type=="MXFunction"){
+    return MXFunctionInternal::deserialize(stream);
+  } else {
+    casadi_error("FXInternal::deserialize: Unknown function type \"" << type << "\"");
   }
 }
 
@@ -1190,7 +1691,11 @@ void FXInternal::evaluateCompressed(int nfdir, int nadir){
   }
   
   // Evaluate compressed
-  evaluate(nfdir_compressed,nadir_compressed);
+  if(hasResultCache()){
+    evaluateCached(nfdir_compressed,nadir_compressed);
+  } else {
+    evaluate(nfdir_compressed,nadir_compressed);
+  }
 
   // Decompress forward directions in reverse order
   for(int dir=nfdir-1; dir>=0; --dir){
@@ -1223,6 +1728,99 @@ void FXInternal::evaluateCompressed(int nfdir, int nadir){
   }
 }
 
+void FXInternal::evaluateCached(int nfdir, int nadir){
+  // Assemble the key: the input nonzeros and the seeds
+  vector<double> key;
+  for(int ind=0; ind<getNumInputs(); ++ind){
+    key.insert(key.end(),inputNoCheck(ind).begin(),inputNoCheck(ind).end());
+  }
+  for(int dir=0; dir<nfdir; ++dir){
+    for(int ind=0; ind<getNumInputs(); ++ind){
+      key.insert(key.end(),fwdSeedNoCheck(ind,dir).begin(),fwdSeedNoCheck(ind,dir).end());
+    }
+  }
+  for(int dir=0; dir<nadir; ++dir){
+    for(int ind=0; ind<getNumOutputs(); ++ind){
+      key.insert(key.end(),adjSeedNoCheck(ind,dir).begin(),adjSeedNoCheck(ind,dir).end());
+    }
+  }
+  
+  // Hash the bit patterns of the key
+  std::size_t hash = 0;
+  hash_combine(hash,nfdir);
+  hash_combine(hash,nadir);
+  for(vector<double>::const_iterator it=key.begin(); it!=key.end(); ++it){
+    int bits[sizeof(double)/sizeof(int)];
+    memcpy(bits,&*it,sizeof(double));
+    for(int k=0; k<sizeof(double)/sizeof(int); ++k) hash_combine(hash,bits[k]);
+  }
+  
+  // Look for an entry with the same key
+  list<ResultCacheEntry>::iterator entry;
+  for(entry=result_cache_.begin(); entry!=result_cache_.end(); ++entry){
+    if(entry->hash==hash && entry->nfdir==nfdir && entry->nadir==nadir && entry->key==key) break;
+  }
+  
+  if(entry!=result_cache_.end()){
+    // Hit: copy the cached outputs and sensitivities
+    result_cache_hits_++;
+    const double* r = getPtr(entry->result);
+    for(int ind=0; ind<getNumOutputs(); ++ind){
+      outputNoCheck(ind).set(r);
+      r += outputNoCheck(ind).size();
+    }
+    for(int dir=0; dir<nfdir; ++dir){
+      for(int ind=0; ind<getNumOutputs(); ++ind){
+        fwdSensNoCheck(ind,dir).set(r);
+        r += fwdSensNoCheck(ind,dir).size();
+      }
+    }
+    for(int dir=0; dir<nadir; ++dir){
+      for(int ind=0; ind<getNumInputs(); ++ind){
+        adjSensNoCheck(ind,dir).set(r);
+        r += adjSensNoCheck(ind,dir).size();
+      }
+    }
+    
+    // Mark as most recently used
+    result_cache_.splice(result_cache_.begin(),result_cache_,entry);
+  } else {
+    // Miss: evaluate
+    result_cache_misses_++;
+    evaluate(nfdir,nadir);
+    
+    // Add an entry, reusing the least recently used one if the cache is full
+    if(result_cache_.size()<result_cache_size_){
+      result_cache_.push_front(ResultCacheEntry());
+    } else {
+      result_cache_.splice(result_cache_.begin(),result_cache_,--result_cache_.end());
+    }
+    entry = result_cache_.begin();
+    entry->hash = hash;
+    entry->nfdir = nfdir;
+    entry->nadir = nadir;
+    entry->key.swap(key);
+    entry->result.clear();
+    for(int ind=0; ind<getNumOutputs(); ++ind){
+      entry->result.insert(entry->result.end(),outputNoCheck(ind).begin(),outputNoCheck(ind).end());
+    }
+    for(int dir=0; dir<nfdir; ++dir){
+      for(int ind=0; ind<getNumOutputs(); ++ind){
+        entry->result.insert(entry->result.end(),fwdSensNoCheck(ind,dir).begin(),fwdSensNoCheck(ind,dir).end());
+      }
+    }
+    for(int dir=0; dir<nadir; ++dir){
+      for(int ind=0; ind<getNumInputs(); ++ind){
+        entry->result.insert(entry->result.end(),adjSensNoCheck(ind,dir).begin(),adjSensNoCheck(ind,dir).end());
+      }
+    }
+  }
+  
+  // Statistics
+  stats_["result_cache_hits"] = result_cache_hits_;
+  stats_["result_cache_misses"] = result_cache_misses_;
+}
+
 void FXInternal::evalSX(const std::vector<SXMatrix>& arg, std::vector<SXMatrix>& res, 
       const std::vector<std::vector<SXMatrix> >& fseed, std::vector<std::vector<SXMatrix> >& fsens, 
       const std::vector<std::vector<SXMatrix> >& aseed, std::vector<std::vector<SXMatrix> >& asens,
@@ -1295,8 +1893,38 @@ FX FXInternal::jacobian(int iind, int oind, bool compact, bool symmetric){
   } else if(bool(getOption("numeric_jacobian"))){
     ret = getNumericJacobian(iind,oind,compact,symmetric);
   } else {
-    // Use internal routine to calculate Jacobian
-    ret = getJacobian(iind,oind,compact, symmetric);
+    // Look for the Jacobian function in the on-disk cache
+    stringstream kind;
+    kind << "jacobian" << (compact ? "_compact" : "") << (symmetric ? "_sym" : "");
+    string fname = derivativeCacheFile(kind.str(),iind,oind,".fx");
+    if(!fname.empty()){
+      ret = readFunctionCache(fname);
+      
+      // Make sure that it has the layout of a Jacobian function of this function
+      if(!ret.isNull()){
+        bool valid = ret.getNumInputs()==getNumInputs() && ret.getNumOutputs()==1+getNumOutputs()
+                     && ret.output(0).size1()==(compact ? output(oind).size() : output(oind).numel()) 
+                     && ret.output(0).size2()==(compact ? input(iind).size() : input(iind).numel());
+        for(int ind=0; valid && ind<getNumInputs(); ++ind) valid = ret.input(ind).sparsity()==input(ind).sparsity();
+        for(int ind=0; valid && ind<getNumOutputs(); ++ind) valid = ret.output(1+ind).sparsity()==output(ind).sparsity();
+        if(valid){
+          if(verbose()) cout << "FXInternal::jacobian: loaded from " << fname << endl;
+        } else {
+          ret = FX();
+        }
+      }
+    }
+    
+    if(ret.isNull()){
+      // Use internal routine to calculate Jacobian
+      ret = getJacobian(iind,oind,compact, symmetric);
+      
+      // Save to the cache, the function needs to be initialized to be serialized
+      if(!fname.empty()){
+        ret.init();
+        writeFunctionCache(fname,ret);
+      }
+    }
   }
   
   // Give it a suitable name
@@ -1304,6 +1932,7 @@ FX FXInternal::jacobian(int iind, int oind, bool compact, bool symmetric){
   ss << "jacobian_" << getOption("name") << "_" << iind << "_" << oind;
   ret.setOption("name",ss.str());
   ret.setOption("verbose",getOption("verbose"));
+  if(hasSetOption("derivative_cache")) ret.setOption("derivative_cache",getOption("derivative_cache"));
   ret.setInputScheme(inputScheme);
   return ret;
 }
@@ -26,6 +26,7 @@
 #include "fx.hpp"
 #include "../weak_ref.hpp"
 #include <set>
+#include <list>
 #include "code_generator.hpp"
 
 // This macro is for documentation purposes
@@ -34,7 +35,13 @@
 // This macro is for documentation purposes
 #define OUTPUTSCHEME(name)
 
+// Version of the binary format written by FX::save, to be increased whenever the format changes
+#define CASADI_SERIALIZATION_VERSION 1
+
 namespace CasADi{
+
+  // Forward declaration
+  class ThreadPool;
   
 /** \brief Internal class for FX
   \author Joel Andersson 
@@ -58,6 +65,12 @@ class FXInternal : public OptionsFunctionalityNode{
     /** \brief  Evaluate with directional derivative compression */
     void evaluateCompressed(int nfdir, int nadir);
 
+    /** \brief  Evaluate, returning the results of a previous evaluation with identical inputs and seeds if available */
+    void evaluateCached(int nfdir, int nadir);
+    
+    /** \brief  Is the result cache enabled */
+    bool hasResultCache() const{ return result_cache_size_>0;}
+
     /** \brief Initialize
       Initialize and make the object ready for setting arguments and evaluation. This method is typically called after setting options but before evaluating. 
       If passed to another class (in the constructor), this class should invoke this function when initialized. */
@@ -227,6 +240,62 @@ class FXInternal : public OptionsFunctionalityNode{
     /** \brief Get the unidirectional or bidirectional partition */
     void getPartition(int iind, int oind, CRSSparsity& D1, CRSSparsity& D2, bool compact, bool symmetric);
 
+    /** \brief Combine a hash of the structure of the function (but not of numerical values that do not affect derivative sparsity) into seed.
+        Returns false if this is not supported by the class, in which case derivative information is not cached on disk. */
+    virtual bool structuralHash(std::size_t& seed) const{ return false;}
+    
+    /** \brief Name of a file in the on-disk derivative cache (empty string if not available) */
+    std::string derivativeCacheFile(const std::string& kind, int iind, int oind, const std::string& ext=".sp") const;
+
+    /** \brief Signature stored in the sparsity files of the derivative cache and compared when they are read, since the file name 
+        is only a hash: a structural hash with a different seed and the input and output sparsity patterns */
+    std::string derivativeCacheSignature() const;
+
+    /** \brief Write the function to a binary stream, see FX::save */
+    virtual void serialize(std::ostream& stream) const;
+    
+    /** \brief Read a function written by serialize from a binary stream */
+    static FX deserialize(std::istream& stream);
+
+    //@{
+    /** \brief Helper functions for the binary format: plain data, vectors of plain data, strings and sparsity patterns */
+    template<typename T>
+    static void writeBinary(std::ostream& stream, const T& v){ stream.write(reinterpret_cast<const char*>(&v),sizeof(T));}
+    template<typename T>
+    static void readBinary(std::istream& stream, T& v){ stream.read(reinterpret_cast<char*>(&v),sizeof(T));}
+    template<typename T>
+    static void writeBinary(std::ostream& stream, const std::vector<T>& v);
+    template<typename T>
+    static void readBinary(std::istream& stream, std::vector<T>& v);
+    static void writeBinary(std::ostream& stream, const std::string& v);
+    static void readBinary(std::istream& stream, std::string& v);
+    static void writeBinary(std::ostream& stream, const CRSSparsity& v);
+    static void readBinary(std::istream& stream, CRSSparsity& v);
+    //@}
+    
+    /** \brief Read a vector of sparsity patterns from a file in the derivative cache, returns false if the file does not exist, is invalid or has another signature */
+    static bool readSparsityCache(const std::string& fname, const std::string& signature, std::vector<CRSSparsity>& sp);
+    
+    /** \brief Write a vector of sparsity patterns (possibly null) to a file in the derivative cache */
+    static void writeSparsityCache(const std::string& fname, const std::string& signature, const std::vector<CRSSparsity>& sp);
+
+    /** \brief Read a derivative function from a file in the derivative cache, null if the file does not exist or was written for another function.
+        The signature is the serialized function itself, so that constants that do not enter the structural hash are compared as well */
+    FX readFunctionCache(const std::string& fname) const;
+    
+    /** \brief Signature of the function files in the derivative cache, i.e. the serialized function.
+        It is computed at the first use after init, empty if the function cannot be serialized */
+    const std::string& functionCacheSignature() const;
+    
+    /** \brief Write a derivative function to a file in the derivative cache, nothing is written if either function cannot be serialized */
+    void writeFunctionCache(const std::string& fname, const FX& f) const;
+    
+    /** \brief Write a function with the header of the binary format, see FX::save */
+    static void writeFunction(std::ostream& stream, const FX& f);
+    
+    /** \brief Read a function written by writeFunction, see FX::load */
+    static FX readFunction(std::istream& stream, const std::string& name);
+
     /// Verbose mode?
     bool verbose() const;
     
@@ -371,6 +440,32 @@ class FXInternal : public OptionsFunctionalityNode{
     /// A flavour of getJacSparsity that does hierachical block structure recognition for symmetric jacobians
     CRSSparsity getJacSparsityHierarchicalSymm(int iind, int oind);
     
+    /// A sweep of the sparsity propagation
+    struct SpSweep{
+      /// Seeds: bit bit[k] is set for the nonzeros [begin[k],end[k])
+      std::vector<int> begin, end, bit;
+      
+      /// A dependency on bit i in coarse row block cri is on seed direction i+lookup(cri,i), ignored if lookup(cri,i)==-bvec_size
+      IMatrix lookup;
+    };
+    
+    /** \brief Propagate the dependencies of a group of sweeps, on the copies of the function in sp_copies_ concurrently if 
+        sparsity_threads>1, and add the dependencies (fine row block, seed direction) to jrow and jcol in the order of the sweeps */
+    void spEvaluateSweeps(int iind, int oind, bool use_fwd, const std::vector<SpSweep>& sweeps, const std::vector<int>& coarse_row, 
+                          const std::vector<int>& fine_row, const std::vector<int>& fine_row_lookup, bool symmetric, 
+                          std::vector<int>& jrow, std::vector<int>& jcol);
+    
+    /// Propagate the dependencies of a single sweep through the function f
+    static void spEvaluateSweep(FXInternal* f, int iind, int oind, bool use_fwd, const SpSweep& sweep, const std::vector<int>& coarse_row, 
+                                const std::vector<int>& fine_row, const std::vector<int>& fine_row_lookup, bool symmetric, 
+                                std::vector<int>& jrow, std::vector<int>& jcol);
+    
+    /// Reset the sparsity propagation of the function and its copies
+    void spInitSweeps(bool use_fwd);
+    
+    /// Number of sweeps to collect before propagating them
+    int spSweepGroupSize() const;
+    
     /// Generate the sparsity of a Jacobian block
     void setJacSparsity(const CRSSparsity& sp, int iind, int oind, bool compact);
     
@@ -395,6 +490,12 @@ class FXInternal : public OptionsFunctionalityNode{
     /** \brief  Log the status of the solver, function given */
     void log(const std::string& fcn, const std::string& msg) const;
 
+    /** \brief  Log the status of the solver, no strings are constructed unless verbose */
+    inline void log(const char* msg) const{ if(verbose_) log(std::string(msg));}
+
+    /** \brief  Log the status of the solver, function given, no strings are constructed unless verbose */
+    inline void log(const char* fcn, const char* msg) const{ if(verbose_) log(std::string(fcn),std::string(msg));}
+
     /// Set of module names which are extra monitored
     std::set<std::string> monitors_;
     
@@ -413,8 +514,43 @@ class FXInternal : public OptionsFunctionalityNode{
     /// Cache for sparsities of the Jacobian blocks
     std::vector<std::vector<CRSSparsity> > jac_sparsity_, jac_sparsity_compact_;
 
+    /// Directory of the on-disk cache for Jacobian sparsity patterns and colorings (empty if disabled)
+    std::string derivative_cache_;
+    
+    /// Signature of the function files in the derivative cache, see functionCacheSignature
+    mutable std::string function_cache_signature_;
+    mutable bool function_cache_signature_set_;
+
+    /// An entry of the result cache
+    struct ResultCacheEntry{
+      /// Hash of the key
+      std::size_t hash;
+      
+      /// Number of directions
+      int nfdir, nadir;
+      
+      /// Input and seed nonzeros
+      std::vector<double> key;
+      
+      /// Output and sensitivity nonzeros
+      std::vector<double> result;
+    };
+    
+    /// Maximum number of entries of the result cache (0 if disabled)
+    int result_cache_size_;
+    
+    /// Cached results, most recently used first
+    std::list<ResultCacheEntry> result_cache_;
+    
+    /// Number of evaluations found and not found in the result cache
+    int result_cache_hits_, result_cache_misses_;
+
     /// Which derivative directions are currently being compressed
     std::vector<bool> compressed_fwd_, compressed_adj_;
+    
+    /// Copies of the function and thread pool propagating sparsity concurrently, only during getJacSparsity
+    std::vector<FX> sp_copies_;
+    ThreadPool* sp_pool_;
 
     /// User-provided Jacobian generator function
     JacobianGenerator jacgen_;
@@ -439,6 +575,23 @@ class FXInternal : public OptionsFunctionalityNode{
 };
 
 
+// Template implementations
+template<typename T>
+void FXInternal::writeBinary(std::ostream& stream, const std::vector<T>& v){
+  int n = v.size();
+  writeBinary(stream,n);
+  if(n>0) stream.write(reinterpret_cast<const char*>(&v.front()),n*sizeof(T));
+}
+
+template<typename T>
+void FXInternal::readBinary(std::istream& stream, std::vector<T>& v){
+  int n = -1;
+  readBinary(stream,n);
+  casadi_assert_message(stream.good() && n>=0, "FXInternal::readBinary: Corrupt data");
+  v.resize(n);
+  if(n>0) stream.read(reinterpret_cast<char*>(&v.front()),n*sizeof(T));
+}
+
 } // namespace CasADi
 
 
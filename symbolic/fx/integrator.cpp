@@ -22,6 +22,7 @@
 
 #include "integrator.hpp"
 #include "integrator_internal.hpp"
+#include "../matrix/matrix_tools.hpp"
 #include <cassert>
 
 using namespace std;
@@ -68,6 +69,36 @@ void Integrator::integrateB(double t_out){
   (*this)->integrateB(t_out);
 }
 
+std::vector<DMatrix> Integrator::evaluateEnsemble(const DMatrix& x0, const DMatrix& p){
+  assertInit();
+  
+  // Number of scenarios
+  int nscen = x0.size2();
+  int nx = input(INTEGRATOR_X0).size();
+  int np = input(INTEGRATOR_P).size();
+  casadi_assert_message(x0.size1()==nx && x0.dense(),
+                        "Integrator::evaluateEnsemble: Initial states must be a dense matrix with " << nx << " rows, got " << x0.dimString());
+  
+  // Parameters, one column is shared by all scenarios
+  DMatrix p_all;
+  if(np==0){
+    p_all = DMatrix(0,nscen);
+  } else {
+    casadi_assert_message(p.size1()==np && p.dense() && (p.size2()==nscen || p.size2()==1),
+                          "Integrator::evaluateEnsemble: Parameters must be a dense matrix with " << np << " rows and 1 or " << nscen << " columns, got " << p.dimString());
+    p_all = p.size2()==nscen ? p : repmat(p,1,nscen);
+  }
+  
+  // Allocate the results
+  vector<DMatrix> ret(2);
+  ret[0] = DMatrix(output(INTEGRATOR_XF).size(),nscen,0);
+  ret[1] = DMatrix(output(INTEGRATOR_QF).size(),nscen,0);
+  
+  // Integrate
+  if(nscen>0) (*this)->evaluateEnsemble(x0,p_all,ret[0],ret[1]);
+  return ret;
+}
+
 FX Integrator::getDAE(){
   return (*this)->f_;
 }
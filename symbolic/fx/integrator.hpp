@@ -197,6 +197,14 @@ public:
   /// Integrate backward until a specified time point
   void integrateB(double t_out);
 
+  /** \brief Integrate an ensemble of scenarios in one call
+   * Column k of \a x0 and \a p holds the initial state and the parameters of scenario k, a single column
+   * of parameters is shared by all scenarios. Both are dense, with one row per nonzero of input(INTEGRATOR_X0)
+   * and input(INTEGRATOR_P). Returns the states and the quadratures at the end of the time horizon 
+   * in the same format. Backward problems, if any, use the current values of input(INTEGRATOR_RX0) and input(INTEGRATOR_RP).
+   */
+  std::vector<DMatrix> evaluateEnsemble(const DMatrix& x0, const DMatrix& p);
+
   /// Check if the node is pointing to the right type of object
   virtual bool checkNode() const;
 
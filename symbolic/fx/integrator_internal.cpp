@@ -28,6 +28,10 @@
 #include "../sx/sx_tools.hpp"
 #include "mx_function.hpp"
 #include "sx_function.hpp"
+#include "thread_pool.hpp"
+#ifdef WITH_THREADS
+#include <atomic>
+#endif //WITH_THREADS
 
 INPUTSCHEME(IntegratorInput)
 OUTPUTSCHEME(IntegratorOutput)
@@ -46,6 +50,7 @@ IntegratorInternal::IntegratorInternal(const FX& f, const FX& g) : f_(f), g_(g){
   addOption("fwd_via_sct",              OT_BOOLEAN,     true, "Generate new functions for calculating forward directional derivatives");
   addOption("adj_via_sct",              OT_BOOLEAN,     true, "Generate new functions for calculating adjoint directional derivatives");
   addOption("augmented_options",        OT_DICTIONARY,  GenericType(), "Options to be passed down to the augmented integrator, if one is constructed.");
+  addOption("ensemble_threads",         OT_INTEGER,     1, "Number of threads integrating the scenarios of evaluateEnsemble, each with its own copy of the integrator (requires compilation with WITH_THREADS)");
   
   // Negative number of parameters for consistancy checking
   np_ = -1;
@@ -228,12 +233,89 @@ void IntegratorInternal::init(){
   tf_ = getOption("tf");
   fwd_via_sct_ = getOption("fwd_via_sct");
   adj_via_sct_ = getOption("adj_via_sct");
+  ensemble_threads_ = getOption("ensemble_threads");
+  casadi_assert_message(ensemble_threads_>=1, "IntegratorInternal::init: ensemble_threads must be positive");
+  
+  // The copies are created anew with the current options
+  ensemble_copies_.clear();
+}
+
+void IntegratorInternal::evaluateScenario(int k, const DMatrix& x0, const DMatrix& p, DMatrix& xf, DMatrix& qf){
+  int nscen = x0.size2();
+  
+  // Pass the initial state and the parameters of the scenario
+  vector<double>& x0_k = input(INTEGRATOR_X0).data();
+  for(int i=0; i<x0_k.size(); ++i) x0_k[i] = x0.data()[i*nscen+k];
+  vector<double>& p_k = input(INTEGRATOR_P).data();
+  for(int i=0; i<p_k.size(); ++i) p_k[i] = p.data()[i*nscen+k];
+
+  // Integrate
+  evaluate(0,0);
+  
+  // Collect the results
+  const vector<double>& xf_k = output(INTEGRATOR_XF).data();
+  for(int i=0; i<xf_k.size(); ++i) xf.data()[i*nscen+k] = xf_k[i];
+  const vector<double>& qf_k = output(INTEGRATOR_QF).data();
+  for(int i=0; i<qf_k.size(); ++i) qf.data()[i*nscen+k] = qf_k[i];
+}
+
+void IntegratorInternal::evaluateEnsemble(const DMatrix& x0, const DMatrix& p, DMatrix& xf, DMatrix& qf){
+  int nscen = x0.size2();
+  int nthreads = std::min(ensemble_threads_,nscen);
+  
+  // The scenarios overwrite the inputs, restore them afterwards
+  DMatrix x0_saved = input(INTEGRATOR_X0), p_saved = input(INTEGRATOR_P);
+  
+#ifndef WITH_THREADS
+  if(nthreads>1){
+    casadi_warning("IntegratorInternal::evaluateEnsemble: ensemble_threads requires thread pool support, integrating on one thread. Recompile CasADi with C++11 support and the option WITH_THREADS set to ON.");
+    nthreads = 1;
+  }
+#endif // WITH_THREADS
+  
+  if(nthreads==1){
+    // Integrate the scenarios one by one
+    for(int k=0; k<nscen; ++k){
+      evaluateScenario(k,x0,p,xf,qf);
+    }
+  } else {
+#ifdef WITH_THREADS
+    // Create the copies of the integrator for the additional threads
+    while(ensemble_copies_.size()<nthreads-1){
+      Integrator I;
+      I.assignNode(create(deepcopy(f_),deepcopy(g_)));
+      I.setOption(dictionary());
+      I.init();
+      ensemble_copies_.push_back(I);
+    }
+    
+    // Pass the inputs of the backward problem
+    for(int t=0; t<nthreads-1; ++t){
+      ensemble_copies_[t].setInput(input(INTEGRATOR_RX0),INTEGRATOR_RX0);
+      ensemble_copies_[t].setInput(input(INTEGRATOR_RP),INTEGRATOR_RP);
+    }
+    
+    // The threads take the scenarios in turn, thread 0 integrates with this integrator
+    ThreadPool pool(nthreads,false);
+    atomic<int> next(0);
+    pool.run([&](int thread){
+      IntegratorInternal* I = thread==0 ? this : static_cast<IntegratorInternal*>(ensemble_copies_[thread-1].get());
+      for(int k=next++; k<nscen; k=next++){
+        I->evaluateScenario(k,x0,p,xf,qf);
+      }
+    });
+#endif // WITH_THREADS
+  }
+  
+  input(INTEGRATOR_X0).set(x0_saved);
+  input(INTEGRATOR_P).set(p_saved);
 }
 
 void IntegratorInternal::deepCopyMembers(std::map<SharedObjectNode*,SharedObject>& already_copied){
   FXInternal::deepCopyMembers(already_copied);
   f_ = deepcopy(f_,already_copied);
   g_ = deepcopy(g_,already_copied);
+  ensemble_copies_.clear();
 }
 
 std::pair<FX,FX> IntegratorInternal::getAugmented(int nfwd, int nadj){
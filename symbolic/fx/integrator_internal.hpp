@@ -69,6 +69,15 @@ public:
   /** \brief  evaluate */
   virtual void evaluate(int nfdir, int nadir);
 
+  /** \brief Integrate an ensemble of scenarios, one column of x0 and p per scenario
+   * The default implementation integrates the scenarios one by one, on ensemble_threads threads
+   * each with its own copy of the integrator.
+   */
+  virtual void evaluateEnsemble(const DMatrix& x0, const DMatrix& p, DMatrix& xf, DMatrix& qf);
+  
+  /** \brief Integrate scenario k of an ensemble */
+  void evaluateScenario(int k, const DMatrix& x0, const DMatrix& p, DMatrix& xf, DMatrix& qf);
+
   /** \brief  Initialize */
   virtual void init();
 
@@ -121,6 +130,12 @@ public:
   /// Generate new functions for calculating forward/adjoint directional derivatives
   bool fwd_via_sct_, adj_via_sct_;
   
+  /// Number of threads integrating the scenarios of an ensemble
+  int ensemble_threads_;
+  
+  /// Copies of the integrator used by the additional threads, created at the first ensemble evaluation
+  std::vector<FX> ensemble_copies_;
+  
 };
   
 } // namespace CasADi
@@ -28,12 +28,17 @@ namespace CasADi{
 
 LinearSolverInternal::LinearSolverInternal(const CRSSparsity& sparsity) : sparsity_(sparsity){
   addOption("trans", OT_BOOLEAN, false);
+  addOption("nrhs",  OT_INTEGER, 1, "Number of right hand sides, the columns of the second input");
 }
 
 void LinearSolverInternal::init(){
   // Transpose?
   transpose_ = getOption("trans");
   
+  // Number of right hand sides
+  nrhs_ = getOption("nrhs");
+  casadi_assert_message(nrhs_>0,"LinearSolverInternal::init: \"nrhs\" must be positive");
+  
   casadi_assert_message(sparsity_.size1()==sparsity_.size2(),"LinearSolverInternal::init: the matrix must be square but got " << sparsity_.dimString());
   
   casadi_assert_message(!isSingular(sparsity_),"LinearSolverInternal::init: singularity - the matrix is structurally rank-deficient. sprank(J)=" << rank(sparsity_) << " (in stead of "<< sparsity_.size1() << ")");
@@ -41,7 +46,7 @@ void LinearSolverInternal::init(){
   // Allocate space for inputs
   input_.resize(2);
   input(0) = DMatrix(sparsity_);
-  input(1) = DMatrix(sparsity_.size1(),1,0);
+  input(1) = DMatrix(sparsity_.size1(),nrhs_,0);
   
   // Allocate space for outputs
   output_.resize(1);
@@ -93,11 +98,27 @@ void LinearSolverInternal::solve(){
   const vector<double>& b = input(1).data();
   vector<double>& x = output().data();
   
-  // Copy input to output
-  copy(b.begin(),b.end(),x.begin());
+  // A single right hand side can be solved for in place
+  if(nrhs_==1){
+    copy(b.begin(),b.end(),x.begin());
+    solve(getPtr(x),1,transpose_);
+    return;
+  }
+  
+  // The right hand sides are the columns of the (row major) input, make them contiguous
+  int n = sparsity_.size1();
+  vector<double> bt(b.size());
+  for(int i=0; i<n; ++i){
+    for(int r=0; r<nrhs_; ++r) bt[r*n+i] = b[i*nrhs_+r];
+  }
   
   // Solve the factorized system
-  solve(getPtr(x),1,transpose_);
+  solve(getPtr(bt),nrhs_,transpose_);
+  
+  // Copy result to output
+  for(int i=0; i<n; ++i){
+    for(int r=0; r<nrhs_; ++r) x[i*nrhs_+r] = bt[r*n+i];
+  }
 }
  
 } // namespace CasADi
@@ -64,6 +64,9 @@ class LinearSolverInternal : public FXInternal{
     // Transpose?
     bool transpose_;
     
+    // Number of right hand sides
+    int nrhs_;
+    
     // Get sparsity pattern
     int nrow() const{ return sparsity_.size1();}
     int ncol() const{ return sparsity_.size2();}
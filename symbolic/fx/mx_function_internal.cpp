@@ -23,14 +23,24 @@
 #include "mx_function_internal.hpp"
 #include "../mx/evaluation_mx.hpp"
 #include "../mx/mapping.hpp"
+#include "../mx/multiplication.hpp"
+#include "../mx/transpose.hpp"
+#include "../mx/densification.hpp"
+#include "../mx/norm.hpp"
+#include "../mx/solve.hpp"
 #include "../mx/mx_tools.hpp"
 #include "../sx/sx_tools.hpp"
 
 #include "../stl_vector_tools.hpp"
 #include "../casadi_types.hpp"
+#include "../matrix/sparsity_tools.hpp"
+#include "thread_pool.hpp"
 
 #include <stack>
 #include <typeinfo>
+#ifdef WITH_THREADS
+#include <atomic>
+#endif //WITH_THREADS
 
 using namespace std;
 
@@ -39,6 +49,10 @@ namespace CasADi{
 MXFunctionInternal::MXFunctionInternal(const std::vector<MX>& inputv, const std::vector<MX>& outputv) :
   XFunctionInternal<MXFunction,MXFunctionInternal,MX,MXNode>(inputv,outputv) {
   
+  addOption("incremental_evaluation", OT_BOOLEAN, false, "Keep the results of the previous call and, for calls without derivative directions, only reevaluate the operations that depend on inputs that have changed (disables live_variables)");
+  addOption("parallel_evaluation", OT_BOOLEAN, false, "Evaluate independent function calls concurrently on a thread pool during the forward sweep (disables live_variables). On a level with several function calls, every call but the first is replaced by a deep copy of its function, including the functions nested in it, so that the calls do not share memory.");
+  addOption("num_threads", OT_INTEGER, 0, "Number of threads of the thread pool used by parallel_evaluation (0: one per core)");
+  
   setOption("name", "unnamed_mx_function");
   setOption("numeric_jacobian", true);
   setOption("numeric_hessian", true);
@@ -137,10 +151,14 @@ MXFunctionInternal::MXFunctionInternal(const std::vector<MX>& inputv, const std:
   
   liftfun_ = 0;
   liftfun_ud_ = 0;
+  pool_ = 0;
 }
 
 
 MXFunctionInternal::~MXFunctionInternal(){
+#ifdef WITH_THREADS
+  delete pool_;
+#endif // WITH_THREADS
 }
 
 
@@ -185,8 +203,28 @@ void MXFunctionInternal::init(){
   vector<int> place_in_alg;
   place_in_alg.reserve(nodes.size());
   
+  // Incremental evaluation requires each result to keep its own place in the work vector
+  incremental_ = getOption("incremental_evaluation");
+  
+  // So does evaluating elements out of order
+  parallel_ = getOption("parallel_evaluation");
+  #ifdef WITH_THREADS
+  num_threads_ = getOption("num_threads");
+  casadi_assert_message(num_threads_>=0, "MXFunction: num_threads must be nonnegative");
+  if(num_threads_==0) num_threads_ = max(1,int(thread::hardware_concurrency()));
+  
+  // Free the thread pool, it will be recreated at the first evaluation
+  delete pool_;
+  pool_ = 0;
+  #else // WITH_THREADS
+  if(parallel_){
+    casadi_warning("MXFunction: parallel_evaluation is not available, evaluating serially. Recompile CasADi with C++11 support and the option WITH_THREADS set to ON.");
+    parallel_ = false;
+  }
+  #endif // WITH_THREADS
+  
   // Use live variables?
-  bool live_variables = getOption("live_variables");
+  bool live_variables = getOption("live_variables") && !incremental_ && !parallel_;
   
   // Input instructions
   vector<pair<int,MXNode*> > symb_loc;
@@ -399,6 +437,20 @@ void MXFunctionInternal::init(){
   // Allocate tape
   allocTape();
   
+  // Levels of concurrently evaluated elements
+  if(parallel_) buildLevels();
+  
+  // Flatten the algorithm
+  buildPlan();
+  allocPointers();
+  
+  // No results to reuse yet
+  cache_valid_ = false;
+  if(incremental_){
+    last_input_.resize(getNumInputs());
+    for(int ind=0; ind<getNumInputs(); ++ind) last_input_[ind] = input(ind).data();
+    work_changed_.resize(work_.size());
+  }
   
   // Allocate memory for directional derivatives
   MXFunctionInternal::updateNumSens(false);
@@ -429,49 +481,150 @@ void MXFunctionInternal::setLiftingFunction(LiftingFunction liftfun, void* user_
   liftfun_ud_ = user_data;
 }
 
-void MXFunctionInternal::updatePointers(const AlgEl& el, int nfdir, int nadir){
-  mx_input_.resize(el.arg.size());
-  mx_output_.resize(el.res.size());
+void MXFunctionInternal::buildPlan(){
+  plan_.resize(algorithm_.size());
+  plan_ind_.clear();
+  for(int k=0; k<algorithm_.size(); ++k){
+    const AlgEl& el = algorithm_[k];
+    PlanEl& p = plan_[k];
+    p.op = el.op;
+    p.node = el.op==OP_OUTPUT ? 0 : static_cast<MXNode*>(const_cast<MX&>(el.data).get());
+    p.narg = el.arg.size();
+    p.nres = el.res.size();
+    p.ind = plan_ind_.size();
+    plan_ind_.insert(plan_ind_.end(),el.arg.begin(),el.arg.end());
+    plan_ind_.insert(plan_ind_.end(),el.res.begin(),el.res.end());
+    p.nonlinear = p.node!=0 && p.node->isNonLinear();
+    
+    // Set by allocPointers, since it depends on the number of directions
+    p.ptr = -1;
+  }
+}
 
-  mx_fwdSeed_.resize(nfdir);
-  mx_fwdSens_.resize(nfdir);
-  for(int d=0; d<nfdir; ++d){
-    mx_fwdSeed_[d].resize(mx_input_.size());
-    mx_fwdSens_[d].resize(mx_output_.size());
+void MXFunctionInternal::buildLevels(){
+  // Level of the element that calculated each element of the work vector, zero for the inputs
+  vector<int> work_level(work_.size(),0);
+  
+  // An element depends only on elements of lower levels
+  vector<int> alg_level(algorithm_.size(),-1);
+  int nlevels = 0;
+  for(int k=0; k<algorithm_.size(); ++k){
+    const AlgEl& el = algorithm_[k];
+    if(el.op==OP_INPUT || el.op==OP_OUTPUT || el.op==OP_PARAMETER) continue;
+    int l = 0;
+    for(vector<int>::const_iterator i=el.arg.begin(); i!=el.arg.end(); ++i){
+      if(*i>=0) l = max(l,work_level[*i]);
+    }
+    for(vector<int>::const_iterator i=el.res.begin(); i!=el.res.end(); ++i){
+      if(*i>=0) work_level[*i] = l+1;
+    }
+    alg_level[k] = l;
+    nlevels = max(nlevels,l+1);
+  }
+  
+  // Sort the elements by level, keeping the order of the algorithm within a level
+  level_offset_.assign(nlevels+1,0);
+  for(int k=0; k<algorithm_.size(); ++k){
+    if(alg_level[k]>=0) level_offset_[alg_level[k]+1]++;
+  }
+  for(int l=0; l<nlevels; ++l) level_offset_[l+1] += level_offset_[l];
+  level_el_.resize(level_offset_.back());
+  vector<int> pos(level_offset_.begin(),level_offset_.end()-1);
+  for(int k=0; k<algorithm_.size(); ++k){
+    if(alg_level[k]>=0) level_el_[pos[alg_level[k]]++] = k;
+  }
+  
+  // Only levels with more than one function call are worth the synchronization
+  level_parallel_.resize(nlevels);
+  for(int l=0; l<nlevels; ++l){
+    int ncall = 0;
+    for(int i=level_offset_[l]; i<level_offset_[l+1]; ++i){
+      AlgEl& el = algorithm_[level_el_[i]];
+      if(el.op!=OP_CALL) continue;
+      
+      // Different functions can embed the same function, so every call but the first gets a deep copy, including the nested functions
+      if(ncall++>0){
+        el.data.makeUnique(false);
+        el.data->getFunction() = deepcopy(el.data->getFunction());
+      }
+    }
+    level_parallel_[l] = ncall>1;
   }
+}
 
-  mx_adjSens_.resize(nadir);
-  mx_adjSeed_.resize(nadir);
-  for(int d=0; d<nadir; ++d){
-    mx_adjSens_[d].resize(mx_input_.size());
-    mx_adjSeed_[d].resize(mx_output_.size());
+void MXFunctionInternal::allocPointers(){
+  // Get the size of the table and the largest number of arguments and results
+  int sz = 0, max_arg = 0, max_res = 0;
+  for(vector<PlanEl>::iterator it=plan_.begin(); it!=plan_.end(); ++it){
+    it->ptr = sz;
+    sz += it->narg+it->nres;
+    max_arg = max(max_arg,it->narg);
+    max_res = max(max_res,it->nres);
   }
   
-  for(int i=0; i<mx_input_.size(); ++i){
-    if(el.arg[i]>=0){
-      mx_input_[i] = &work_[el.arg[i]].data;
-      for(int d=0; d<nfdir; ++d) mx_fwdSeed_[d][i] = &work_[el.arg[i]].dataF[d];
-      for(int d=0; d<nadir; ++d) mx_adjSens_[d][i] = &work_[el.arg[i]].dataA[d];
-    } else {
-      mx_input_[i] = 0;
-      for(int d=0; d<nfdir; ++d) mx_fwdSeed_[d][i] = 0;
-      for(int d=0; d<nadir; ++d) mx_adjSens_[d][i] = 0;
+  // Fill the table, the work matrices of the directional derivatives are looked up from the work vector indices
+  ptr_arena_.resize(sz);
+  for(vector<PlanEl>::const_iterator it=plan_.begin(); it!=plan_.end(); ++it){
+    DMatrix** p = &ptr_arena_.front() + it->ptr;
+    const int* i = getPtr(plan_ind_) + it->ind;
+    const int* i_end = i + it->narg + it->nres;
+    if(it->op==OP_INPUT || it->op==OP_OUTPUT){
+      // Not evaluated via pointers
+      std::fill(p,p+(it->narg+it->nres),static_cast<DMatrix*>(0));
+      continue;
     }
+    for(; i!=i_end; ++i) *p++ = *i>=0 ? &work_[*i].data : 0;
   }
   
-  for(int i=0; i<mx_output_.size(); ++i){
-    if(el.res[i]>=0){
-      mx_output_[i] = &work_[el.res[i]].data;
-      for(int d=0; d<nfdir; ++d) mx_fwdSens_[d][i] = &work_[el.res[i]].dataF[d];
-      for(int d=0; d<nadir; ++d) mx_adjSeed_[d][i] = &work_[el.res[i]].dataA[d];
-    } else {
-      mx_output_[i] = 0;
-      for(int d=0; d<nfdir; ++d) mx_fwdSens_[d][i] = 0;
-      for(int d=0; d<nadir; ++d) mx_adjSeed_[d][i] = 0;
+  // Make room for the largest element so that updatePointers does not need to allocate
+  mx_input_.reserve(max_arg);
+  mx_output_.reserve(max_res);
+  max_arg_ = max_arg;
+  max_res_ = max_res;
+}
+
+void MXFunctionInternal::resizeDirections(DMatrixPtrVV& v, int ndir, int max_size){
+  if(v.size()!=ndir){
+    v.resize(ndir);
+    for(DMatrixPtrVV::iterator it=v.begin(); it!=v.end(); ++it) it->reserve(max_size);
+  }
+}
+
+void MXFunctionInternal::getDirections(const int* ind, int n, int ndir, bool fwd, DMatrixPtrVV& v){
+  for(int d=0; d<ndir; ++d){
+    v[d].resize(n);
+    for(int i=0; i<n; ++i){
+      v[d][i] = ind[i]>=0 ? &(fwd ? work_[ind[i]].dataF : work_[ind[i]].dataA)[d] : 0;
     }
   }
 }
 
+void MXFunctionInternal::getPointers(int k, int nfdir, DMatrixPtrV& input, DMatrixPtrV& output, DMatrixPtrVV& fwdSeed, DMatrixPtrVV& fwdSens){
+  int na = plan_[k].narg;
+  int nr = plan_[k].nres;
+  DMatrix* const* p = &ptr_arena_.front() + plan_[k].ptr;
+  
+  // Nondifferentiated inputs and outputs
+  input.assign(p,p+na);
+  output.assign(p+na,p+na+nr);
+  
+  // Forward directions
+  const int* arg = getPtr(plan_ind_) + plan_[k].ind;
+  getDirections(arg,na,nfdir,true,fwdSeed);
+  getDirections(arg+na,nr,nfdir,true,fwdSens);
+}
+
+void MXFunctionInternal::updatePointers(int k, int nfdir, int nadir){
+  getPointers(k,nfdir,mx_input_,mx_output_,mx_fwdSeed_,mx_fwdSens_);
+  
+  // Adjoint directions
+  int na = plan_[k].narg;
+  int nr = plan_[k].nres;
+  const int* arg = getPtr(plan_ind_) + plan_[k].ind;
+  getDirections(arg+na,nr,nadir,false,mx_adjSeed_);
+  getDirections(arg,na,nadir,false,mx_adjSens_);
+}
+
 void MXFunctionInternal::evaluate(int nfdir, int nadir){
   casadi_log("MXFunctionInternal::evaluate(" << nfdir << ", " << nadir<< "):begin "  << getOption("name"));
 
@@ -482,49 +635,70 @@ void MXFunctionInternal::evaluate(int nfdir, int nadir){
     casadi_error("Cannot evaluate \"" << ss.str() << "\" since variables " << free_vars_ << " are free.");
   }
   
+  // Reuse the results of the previous call if possible
+  if(incremental_ && nfdir==0 && nadir==0 && cache_valid_ && !liftfun_){
+    evaluateIncremental();
+    return;
+  }
+  
+  // Number of directions of the node evaluations, only allocating if the number has changed since the last call
+  casadi_assert(nfdir<=nfdir_ && nadir<=nadir_);
+  resizeDirections(mx_fwdSeed_,nfdir,max_arg_);
+  resizeDirections(mx_fwdSens_,nfdir,max_res_);
+  resizeDirections(mx_adjSeed_,nadir,max_res_);
+  resizeDirections(mx_adjSens_,nadir,max_arg_);
+  
   // Tape iterator
   vector<pair<pair<int,int>,DMatrix> >::iterator tape_it = tape_.begin();
   
-  // Evaluate all of the nodes of the algorithm: should only evaluate nodes that have not yet been calculated!
-  int alg_counter = 0;
-  for(vector<AlgEl>::iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it, ++alg_counter){
+  // Evaluate all of the elements of the plan
+  const int* ind = getPtr(plan_ind_);
+  if(parallel_ && !liftfun_){
+    // Independent function calls concurrently, the tape is empty without live variables
+    evaluateLevels(nfdir);
+  } else {
+    int alg_counter = 0;
+    for(vector<PlanEl>::const_iterator it=plan_.begin(); it!=plan_.end(); ++it, ++alg_counter){
+      const int* arg = ind + it->ind;
+      const int* res = arg + it->narg;
   
-    // Spill existing work elements if needed
-    if(nadir>0 && it->op!=OP_OUTPUT){
-      for(vector<int>::const_iterator c=it->res.begin(); c!=it->res.end(); ++c){
-        if(*c >=0 && tape_it!=tape_.end() && tape_it->first == make_pair(alg_counter,*c)){
-          tape_it->second.set(work_[*c].data);
-          tape_it++;
+      // Spill existing work elements if needed
+      if(nadir>0 && it->op!=OP_OUTPUT){
+        for(const int* c=res; c!=res+it->nres; ++c){
+          if(*c >=0 && tape_it!=tape_.end() && tape_it->first == make_pair(alg_counter,*c)){
+            tape_it->second.set(work_[*c].data);
+            tape_it++;
+          }
         }
       }
-    }
     
-    if(it->op==OP_INPUT){
-      // Pass the input and forward seeeds
-      work_[it->res.front()].data.set(input(it->arg.front()));
-      for(int dir=0; dir<nfdir; ++dir){
-        work_[it->res.front()].dataF.at(dir).set(fwdSeed(it->arg.front(),dir));
-      }
-    } else if(it->op==OP_OUTPUT){
-      // Get the outputs and forward sensitivities
-      work_[it->arg.front()].data.get(output(it->res.front()));
-      for(int dir=0; dir<nfdir; ++dir){
-        work_[it->arg.front()].dataF.at(dir).get(fwdSens(it->res.front(),dir));
-      }
-    } else if(it->op==OP_PARAMETER){
-      //casadi_error("The algorithm contains free parameters"); // FIXME
-    } else {
+      if(it->op==OP_INPUT){
+        // Pass the input and forward seeeds
+        work_[res[0]].data.set(input(arg[0]));
+        for(int dir=0; dir<nfdir; ++dir){
+          work_[res[0]].dataF[dir].set(fwdSeed(arg[0],dir));
+        }
+      } else if(it->op==OP_OUTPUT){
+        // Get the outputs and forward sensitivities
+        work_[arg[0]].data.get(output(res[0]));
+        for(int dir=0; dir<nfdir; ++dir){
+          work_[arg[0]].dataF[dir].get(fwdSens(res[0],dir));
+        }
+      } else if(it->op==OP_PARAMETER){
+        //casadi_error("The algorithm contains free parameters"); // FIXME
+      } else {
 
-      // Point pointers to the data corresponding to the element
-      updatePointers(*it,nfdir,0);
+        // Point pointers to the data corresponding to the element
+        updatePointers(alg_counter,nfdir,0);
 
-      // Evaluate
-      it->data->evaluateD(mx_input_, mx_output_, mx_fwdSeed_, mx_fwdSens_, mx_adjSeed_, mx_adjSens_);
+        // Evaluate
+        it->node->evaluateD(mx_input_, mx_output_, mx_fwdSeed_, mx_fwdSens_, mx_noDir_, mx_noDir_);
   
-      // Lifting
-      if(liftfun_ && it->data->isNonLinear()){
-        for(int i=0; i<it->res.size(); ++i){
-          liftfun_(&mx_output_[i]->front(),mx_output_[i]->size(),liftfun_ud_);
+        // Lifting
+        if(liftfun_ && it->nonlinear){
+          for(int i=0; i<it->nres; ++i){
+            liftfun_(&mx_output_[i]->front(),mx_output_[i]->size(),liftfun_ud_);
+          }
         }
       }
     }
@@ -541,50 +715,52 @@ void MXFunctionInternal::evaluate(int nfdir, int nadir){
     // Clear the adjoint seeds
     for(vector<FunctionIO>::iterator it=work_.begin(); it!=work_.end(); it++){
       for(int dir=0; dir<nadir; ++dir){
-        fill(it->dataA.at(dir).begin(),it->dataA.at(dir).end(),0.0);
+        fill(it->dataA[dir].begin(),it->dataA[dir].end(),0.0);
       }
     }
 
-    // Evaluate all of the nodes of the algorithm: should only evaluate nodes that have not yet been calculated!
-    int alg_counter = algorithm_.size()-1;
-    for(vector<AlgEl>::reverse_iterator it=algorithm_.rbegin(); it!=algorithm_.rend(); ++it, --alg_counter){
+    // Evaluate all of the elements of the plan in reverse order
+    int alg_counter = plan_.size()-1;
+    for(vector<PlanEl>::const_reverse_iterator it=plan_.rbegin(); it!=plan_.rend(); ++it, --alg_counter){
+      const int* arg = ind + it->ind;
+      const int* res = arg + it->narg;
       if(it->op==OP_INPUT){
         // Get the adjoint sensitivity
         for(int dir=0; dir<nadir; ++dir){
-          work_[it->res.front()].dataA.at(dir).get(adjSens(it->arg.front(),dir));
+          work_[res[0]].dataA[dir].get(adjSens(arg[0],dir));
         }
       } else if(it->op==OP_OUTPUT){
         // Pass the adjoint seeds
         for(int dir=0; dir<nadir; ++dir){
-          const DMatrix& aseed = adjSeed(it->res.front(),dir);
-          DMatrix& aseed_dest = work_[it->arg.front()].dataA.at(dir);
+          const DMatrix& aseed = adjSeed(res[0],dir);
+          DMatrix& aseed_dest = work_[arg[0]].dataA[dir];
           transform(aseed_dest.begin(),aseed_dest.end(),aseed.begin(),aseed_dest.begin(),std::plus<double>());
         }
       } else if(it->op==OP_PARAMETER){
         //casadi_error("The algorithm contains free parameters"); // FIXME
       } else {
         // Point pointers to the data corresponding to the element
-        updatePointers(*it,0,nadir);
+        updatePointers(alg_counter,0,nadir);
         
         // Evaluate
-        it->data->evaluateD(mx_input_, mx_output_, mx_fwdSeed_, mx_fwdSens_, mx_adjSeed_, mx_adjSens_);
+        it->node->evaluateD(mx_input_, mx_output_, mx_noDir_, mx_noDir_, mx_adjSeed_, mx_adjSens_);
       }
       
       if(it->op!=OP_OUTPUT){
         // Recover spilled work vector elements
-        for(vector<int>::const_reverse_iterator c=it->res.rbegin(); c!=it->res.rend(); ++c){
-          if(*c >=0 && tape_it!=tape_.rend() && tape_it->first==make_pair(alg_counter,*c)){
-            tape_it->second.get(work_[*c].data);
+        for(int i=it->nres-1; i>=0; --i){
+          const int c = res[i];
+          if(c >=0 && tape_it!=tape_.rend() && tape_it->first==make_pair(alg_counter,c)){
+            tape_it->second.get(work_[c].data);
             tape_it++;
           }
         }
         
         // Free memory for reuse
-        for(int oind=0; oind<it->res.size(); ++oind){
-          int el = it->res[oind];
-          if(el>=0){
+        for(const int* c=res; c!=res+it->nres; ++c){
+          if(*c>=0){
             for(int d=0; d<nadir; ++d){
-              work_[el].dataA.at(d).setZero();
+              work_[*c].dataA[d].setZero();
             }
           }
         }
@@ -593,9 +769,150 @@ void MXFunctionInternal::evaluate(int nfdir, int nadir){
     
     casadi_log("MXFunctionInternal::evaluate(" << nfdir << ", " << nadir<< "):adjoints:end"  << getOption("name"));
   }
+  
+  // All results in the work vector now correspond to the current inputs
+  if(incremental_){
+    for(int ind=0; ind<getNumInputs(); ++ind){
+      copy(input(ind).begin(),input(ind).end(),last_input_[ind].begin());
+    }
+    cache_valid_ = true;
+    if(gather_stats_){
+      // Count the operations as in evaluateIncremental
+      int num_evaluated = 0;
+      for(vector<PlanEl>::const_iterator it=plan_.begin(); it!=plan_.end(); ++it){
+        if(it->op!=OP_INPUT && it->op!=OP_OUTPUT && it->op!=OP_PARAMETER) num_evaluated++;
+      }
+      stats_["num_evaluated"] = num_evaluated;
+    }
+  }
   casadi_log("MXFunctionInternal::evaluate(" << nfdir << ", " << nadir<< "):end "  << getOption("name"));
 }
 
+void MXFunctionInternal::evaluateIncremental(){
+  // Find the inputs that have changed since the last call
+  vector<bool> input_changed(getNumInputs());
+  for(int ind=0; ind<getNumInputs(); ++ind){
+    const vector<double>& v = input(ind).data();
+    input_changed[ind] = !equal(v.begin(),v.end(),last_input_[ind].begin());
+    if(input_changed[ind]) copy(v.begin(),v.end(),last_input_[ind].begin());
+  }
+  
+  // Evaluate the elements of the plan that depend on changed inputs
+  fill(work_changed_.begin(),work_changed_.end(),false);
+  const int* ind = getPtr(plan_ind_);
+  int num_evaluated = 0;
+  int alg_counter = 0;
+  for(vector<PlanEl>::const_iterator it=plan_.begin(); it!=plan_.end(); ++it, ++alg_counter){
+    const int* arg = ind + it->ind;
+    const int* res = arg + it->narg;
+    if(it->op==OP_INPUT){
+      if(input_changed[arg[0]]){
+        work_[res[0]].data.set(input(arg[0]));
+        work_changed_[res[0]] = true;
+      }
+    } else if(it->op==OP_OUTPUT){
+      work_[arg[0]].data.get(output(res[0]));
+    } else if(it->op!=OP_PARAMETER){
+      // Skip if none of the arguments have changed
+      bool changed = false;
+      for(const int* c=arg; c!=arg+it->narg && !changed; ++c){
+        changed = *c>=0 && work_changed_[*c];
+      }
+      if(!changed) continue;
+      
+      // Reevaluate
+      updatePointers(alg_counter,0,0);
+      it->node->evaluateD(mx_input_, mx_output_, mx_noDir_, mx_noDir_, mx_noDir_, mx_noDir_);
+      num_evaluated++;
+      
+      // Mark the results as changed
+      for(const int* c=res; c!=res+it->nres; ++c){
+        if(*c>=0) work_changed_[*c] = true;
+      }
+    }
+  }
+  if(gather_stats_) stats_["num_evaluated"] = num_evaluated;
+}
+
+void MXFunctionInternal::evaluateLevels(int nfdir){
+#ifdef WITH_THREADS
+  // Create the thread pool and the pointer vectors of its threads
+  if(pool_==0){
+    pool_ = new ThreadPool(num_threads_,false);
+    int nthreads = pool_->size();
+    thread_input_.resize(nthreads);
+    thread_output_.resize(nthreads);
+    thread_fwdSeed_.assign(nthreads,DMatrixPtrVV());
+    thread_fwdSens_.assign(nthreads,DMatrixPtrVV());
+    for(int t=0; t<nthreads; ++t){
+      thread_input_[t].reserve(max_arg_);
+      thread_output_[t].reserve(max_res_);
+    }
+  }
+  for(int t=0; t<pool_->size(); ++t){
+    resizeDirections(thread_fwdSeed_[t],nfdir,max_arg_);
+    resizeDirections(thread_fwdSens_[t],nfdir,max_res_);
+  }
+  
+  // Pass the inputs and forward seeds
+  const int* ind = getPtr(plan_ind_);
+  for(vector<PlanEl>::const_iterator it=plan_.begin(); it!=plan_.end(); ++it){
+    if(it->op==OP_INPUT){
+      const int* arg = ind + it->ind;
+      const int* res = arg + it->narg;
+      work_[res[0]].data.set(input(arg[0]));
+      for(int dir=0; dir<nfdir; ++dir){
+        work_[res[0]].dataF[dir].set(fwdSeed(arg[0],dir));
+      }
+    }
+  }
+  
+  // Evaluate level by level
+  int num_parallel = 0;
+  for(int l=0; l+1<level_offset_.size(); ++l){
+    int begin = level_offset_[l], end = level_offset_[l+1];
+    if(level_parallel_[l]){
+      // The threads take the elements of the level in turn
+      atomic<int> next(begin);
+      pool_->run([&](int thread){
+        for(int i=next++; i<end; i=next++){
+          int k = level_el_[i];
+          getPointers(k,nfdir,thread_input_[thread],thread_output_[thread],thread_fwdSeed_[thread],thread_fwdSens_[thread]);
+          plan_[k].node->evaluateD(thread_input_[thread],thread_output_[thread],thread_fwdSeed_[thread],thread_fwdSens_[thread],mx_noDir_,mx_noDir_);
+        }
+      });
+      num_parallel++;
+    } else {
+      for(int i=begin; i<end; ++i){
+        int k = level_el_[i];
+        updatePointers(k,nfdir,0);
+        plan_[k].node->evaluateD(mx_input_, mx_output_, mx_fwdSeed_, mx_fwdSens_, mx_noDir_, mx_noDir_);
+      }
+    }
+  }
+  
+  // Get the outputs and forward sensitivities
+  for(vector<PlanEl>::const_iterator it=plan_.begin(); it!=plan_.end(); ++it){
+    if(it->op==OP_OUTPUT){
+      const int* arg = ind + it->ind;
+      const int* res = arg + it->narg;
+      work_[arg[0]].data.get(output(res[0]));
+      for(int dir=0; dir<nfdir; ++dir){
+        work_[arg[0]].dataF[dir].get(fwdSens(res[0],dir));
+      }
+    }
+  }
+  
+  if(gather_stats_){
+    stats_["num_levels"] = int(level_offset_.size())-1;
+    stats_["num_parallel_levels"] = num_parallel;
+    stats_["num_threads"] = pool_->size();
+  }
+#else // WITH_THREADS
+  casadi_error("MXFunctionInternal::evaluateLevels: CasADi was compiled without thread pool support");
+#endif // WITH_THREADS
+}
+
 void MXFunctionInternal::print(ostream &stream) const{
   FXInternal::print(stream);
   for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
@@ -635,7 +952,12 @@ void MXFunctionInternal::print(ostream &stream) const{
 }
 
 MXFunctionInternal* MXFunctionInternal::clone() const{
-  return new MXFunctionInternal(*this);
+  MXFunctionInternal* ret = new MXFunctionInternal(*this);
+  ret->pool_ = 0;
+  
+  // The copied pointers refer to the work matrices of this instance
+  if(isInit()) ret->allocPointers();
+  return ret;
 }
 
 void MXFunctionInternal::deepCopyMembers(std::map<SharedObjectNode*,SharedObject>& already_copied){
@@ -646,6 +968,13 @@ void MXFunctionInternal::deepCopyMembers(std::map<SharedObjectNode*,SharedObject
       it->data->getFunction() = deepcopy(it->data->getFunction(),already_copied);
     }
   }
+  
+  // The plan refers to the replaced nodes
+  if(isInit()){
+    if(parallel_) buildLevels();
+    buildPlan();
+    allocPointers();
+  }
 }
 
 void MXFunctionInternal::spInit(bool fwd){
@@ -661,7 +990,8 @@ void MXFunctionInternal::spEvaluate(bool fwd){
   if(fwd){ // Forward propagation
 
     // Propagate sparsity forward
-    for(vector<AlgEl>::iterator it=algorithm_.begin(); it!=algorithm_.end(); it++){
+    int alg_counter = 0;
+    for(vector<AlgEl>::iterator it=algorithm_.begin(); it!=algorithm_.end(); it++, alg_counter++){
       if(it->op==OP_INPUT){
         // Pass input seeds
         vector<double> &w = work_[it->res.front()].data.data();
@@ -680,7 +1010,7 @@ void MXFunctionInternal::spEvaluate(bool fwd){
         fill_n(get_bvec_t(w),w.size(),bvec_t(0));
       } else {
         // Point pointers to the data corresponding to the element
-        updatePointers(*it,0,0);
+        updatePointers(alg_counter,0,0);
 
         // Propagate sparsity forwards
         it->data->propagateSparsity(mx_input_, mx_output_,true);
@@ -690,7 +1020,8 @@ void MXFunctionInternal::spEvaluate(bool fwd){
   } else { // Backward propagation
 
     // Propagate sparsity backwards
-    for(vector<AlgEl>::reverse_iterator it=algorithm_.rbegin(); it!=algorithm_.rend(); it++){
+    int alg_counter = algorithm_.size()-1;
+    for(vector<AlgEl>::reverse_iterator it=algorithm_.rbegin(); it!=algorithm_.rend(); it++, alg_counter--){
       if(it->op==OP_INPUT){
         // Get the input sensitivities and clear it from the work vector
         vector<double> &w = work_[it->res.front()].data.data();
@@ -709,7 +1040,7 @@ void MXFunctionInternal::spEvaluate(bool fwd){
         }
       } else if(it->op!=OP_PARAMETER){
         // Point pointers to the data corresponding to the element
-        updatePointers(*it,0,0);
+        updatePointers(alg_counter,0,0);
         
         // Propagate sparsity backwards
         it->data->propagateSparsity(mx_input_, mx_output_,false);
@@ -1298,5 +1629,244 @@ void MXFunctionInternal::allocTape(){
     vinit_fcn = MXFunction(f_in,f_out);
   }
 
+bool MXFunctionInternal::structuralHash(std::size_t& seed) const{
+  // Input and output sparsity
+  for(int i=0; i<getNumInputs(); ++i) hash_combine(seed,int(input(i).sparsity().hash()));
+  for(int i=0; i<getNumOutputs(); ++i) hash_combine(seed,int(output(i).sparsity().hash()));
+  
+  // Operations, with the work vector indices of the arguments and results
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    hash_combine(seed,it->op);
+    hash_combine(seed,it->arg);
+    hash_combine(seed,it->res);
+    if(it->op!=OP_OUTPUT && !it->data->structuralHash(seed)) return false;
+  }
+  return true;
+}
+
+void MXFunctionInternal::serialize(std::ostream& stream) const{
+  casadi_assert_message(isInit(), "MXFunctionInternal::serialize: Function not initialized");
+  casadi_assert_message(free_vars_.empty(), "MXFunctionInternal::serialize: Cannot save a function with free variables " << free_vars_);
+
+  // Type and name
+  writeBinary(stream,string("MXFunction"));
+  writeBinary(stream,getOption("name").toString());
+  
+  // Input names and sparsity
+  writeBinary(stream,getNumInputs());
+  for(int ind=0; ind<getNumInputs(); ++ind){
+    writeBinary(stream,inputv_[ind].getName());
+    writeBinary(stream,input(ind).sparsity());
+  }
+  
+  // Output sparsity
+  writeBinary(stream,getNumOutputs());
+  for(int ind=0; ind<getNumOutputs(); ++ind) writeBinary(stream,output(ind).sparsity());
+  
+  // Embedded functions, each one written once
+  vector<FX> fcns;
+  map<const SharedObjectNode*,int> fcn_index;
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    if(it->op==OP_CALL){
+      const FX& f = it->data->getFunction();
+      if(fcn_index.find(f.get())==fcn_index.end()){
+        fcn_index[f.get()] = fcns.size();
+        fcns.push_back(f);
+      }
+    }
+  }
+  writeBinary(stream,int(fcns.size()));
+  for(vector<FX>::const_iterator it=fcns.begin(); it!=fcns.end(); ++it){
+    (*it)->serialize(stream);
+  }
+  
+  // The algorithm
+  writeBinary(stream,int(work_.size()));
+  writeBinary(stream,int(algorithm_.size()));
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    writeBinary(stream,it->op);
+    writeBinary(stream,it->arg);
+    writeBinary(stream,it->res);
+    
+    // Data that is not given by the operation and the dependencies
+    switch(it->op){
+      case OP_INPUT:
+      case OP_OUTPUT:
+      case OP_MATMUL:
+      case OP_TRANSPOSE:
+      case OP_DENSIFY:
+      case OP_NORM2:
+      case OP_NORMF:
+      case OP_NORM1:
+      case OP_NORMINF:
+      case OP_SOLVE:
+        break;
+      case OP_CONST:
+        writeBinary(stream,it->data.sparsity());
+        writeBinary(stream,it->data.getConstant().data());
+        break;
+      case OP_CALL:
+        writeBinary(stream,fcn_index[it->data->getFunction().get()]);
+        break;
+      case OP_MAPPING:
+      {
+        // Dependency index and input nonzero for each term of each output nonzero
+        const Mapping* m = static_cast<const Mapping*>(it->data.get());
+        writeBinary(stream,m->sparsity());
+        vector<int> offset(1,0), inz, iind;
+        for(vector<vector<Mapping::OutputNZ> >::const_iterator j=m->output_sorted_.begin(); j!=m->output_sorted_.end(); ++j){
+          for(vector<Mapping::OutputNZ>::const_iterator k=j->begin(); k!=j->end(); ++k){
+            inz.push_back(k->inz);
+            iind.push_back(k->iind);
+          }
+          offset.push_back(inz.size());
+        }
+        writeBinary(stream,offset);
+        writeBinary(stream,inz);
+        writeBinary(stream,iind);
+        break;
+      }
+      default:
+        casadi_assert_message(it->op>=0 && it->op<NUM_BUILT_IN_OPS && it->op!=OP_PARAMETER, "MXFunctionInternal::serialize: Cannot save operation " << it->op << " (" << typeid(*it->data.get()).name() << ")");
+    }
+  }
+}
+
+MXFunction MXFunctionInternal::deserialize(std::istream& stream){
+  // Name
+  string name;
+  readBinary(stream,name);
+  
+  // Symbolic inputs
+  int n_in=-1;
+  readBinary(stream,n_in);
+  casadi_assert_message(stream.good() && n_in>=0, "MXFunctionInternal::deserialize: Corrupt data");
+  vector<MX> arg(n_in);
+  for(int ind=0; ind<n_in; ++ind){
+    string iname;
+    CRSSparsity sp;
+    readBinary(stream,iname);
+    readBinary(stream,sp);
+    arg[ind] = msym(iname,sp);
+  }
+  
+  // Output sparsity
+  int n_out=-1;
+  readBinary(stream,n_out);
+  casadi_assert_message(stream.good() && n_out>=0, "MXFunctionInternal::deserialize: Corrupt data");
+  vector<CRSSparsity> res_sp(n_out);
+  for(int ind=0; ind<n_out; ++ind) readBinary(stream,res_sp[ind]);
+  vector<MX> res(n_out);
+  
+  // Embedded functions
+  int n_fcn=-1;
+  readBinary(stream,n_fcn);
+  casadi_assert_message(stream.good() && n_fcn>=0, "MXFunctionInternal::deserialize: Corrupt data");
+  vector<FX> fcns(n_fcn);
+  for(int k=0; k<n_fcn; ++k){
+    fcns[k] = FXInternal::deserialize(stream);
+    fcns[k].init();
+  }
+  
+  // Replay the algorithm
+  int worksize=-1, n_alg=-1;
+  readBinary(stream,worksize);
+  readBinary(stream,n_alg);
+  casadi_assert_message(stream.good() && worksize>=0 && n_alg>=0, "MXFunctionInternal::deserialize: Corrupt data");
+  vector<MX> w(worksize);
+  vector<MX> dep;
+  for(int i=0; i<n_alg; ++i){
+    int op;
+    vector<int> a, r;
+    readBinary(stream,op);
+    readBinary(stream,a);
+    readBinary(stream,r);
+    casadi_assert_message(stream.good(), "MXFunctionInternal::deserialize: Corrupt data");
+    
+    // Get the dependencies
+    dep.resize(a.size());
+    for(int k=0; k<a.size(); ++k){
+      dep[k] = a[k]<0 ? MX() : w.at(a[k]);
+    }
+    
+    // Create the node
+    switch(op){
+      case OP_INPUT:      w.at(r.at(0)) = arg.at(a.at(0)); break;
+      case OP_OUTPUT:     res.at(r.at(0)) = dep.at(0); break;
+      case OP_MATMUL:     w.at(r.at(0)) = MX::create(new Multiplication(dep.at(0),dep.at(1))); break;
+      case OP_TRANSPOSE:  w.at(r.at(0)) = MX::create(new Transpose(dep.at(0))); break;
+      case OP_DENSIFY:    w.at(r.at(0)) = MX::create(new Densification(dep.at(0))); break;
+      case OP_NORM2:      w.at(r.at(0)) = MX::create(new Norm2(dep.at(0))); break;
+      case OP_NORMF:      w.at(r.at(0)) = MX::create(new NormF(dep.at(0))); break;
+      case OP_NORM1:      w.at(r.at(0)) = MX::create(new Norm1(dep.at(0))); break;
+      case OP_NORMINF:    w.at(r.at(0)) = MX::create(new NormInf(dep.at(0))); break;
+      case OP_SOLVE:      w.at(r.at(0)) = MX::create(new Solve(dep.at(0),dep.at(1))); break;
+      case OP_CONST:
+      {
+        CRSSparsity sp;
+        vector<double> data;
+        readBinary(stream,sp);
+        readBinary(stream,data);
+        w.at(r.at(0)) = MX(DMatrix(sp,data));
+        break;
+      }
+      case OP_CALL:
+      {
+        int k=-1;
+        readBinary(stream,k);
+        vector<MX> fres = fcns.at(k).call(dep);
+        for(int j=0; j<r.size(); ++j){
+          if(r[j]>=0) w.at(r[j]) = fres.at(j);
+        }
+        break;
+      }
+      case OP_MAPPING:
+      {
+        CRSSparsity sp;
+        vector<int> offset, inz, iind;
+        readBinary(stream,sp);
+        readBinary(stream,offset);
+        readBinary(stream,inz);
+        readBinary(stream,iind);
+        casadi_assert_message(offset.size()==sp.size()+1 && offset.back()==inz.size() && iind.size()==inz.size(), "MXFunctionInternal::deserialize: Corrupt data");
+        
+        // Sort the terms by dependency
+        vector<vector<int> > inz_d(dep.size()), onz_d(dep.size());
+        for(int onz=0; onz<sp.size(); ++onz){
+          for(int k=offset[onz]; k<offset[onz+1]; ++k){
+            inz_d.at(iind[k]).push_back(inz[k]);
+            onz_d.at(iind[k]).push_back(onz);
+          }
+        }
+        
+        // Create the mapping
+        MX m = MX::create(new Mapping(sp));
+        for(int d=0; d<dep.size(); ++d){
+          m->assign(dep[d],inz_d[d],onz_d[d],true);
+        }
+        w.at(r.at(0)) = m;
+        break;
+      }
+      default:
+        casadi_assert_message(op>=0 && op<NUM_BUILT_IN_OPS && op!=OP_PARAMETER, "MXFunctionInternal::deserialize: Corrupt data");
+        if(dep.size()==1){
+          w.at(r.at(0)) = MX::unary(op,dep[0]);
+        } else {
+          w.at(r.at(0)) = MX::binary(op,dep.at(0),dep.at(1));
+        }
+    }
+  }
+  
+  // Outputs that do not depend on anything
+  for(int ind=0; ind<n_out; ++ind){
+    if(res[ind].isNull()) res[ind] = MX(res_sp[ind].size1(),res_sp[ind].size2());
+  }
+
+  // Create the function
+  MXFunction ret(arg,res);
+  ret.setOption("name",name);
+  return ret;
+}
+
 } // namespace CasADi
 
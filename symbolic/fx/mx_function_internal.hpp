@@ -34,6 +34,9 @@
 
 namespace CasADi{
 
+  // Forward declaration
+  class ThreadPool;
+
 /** \brief  Internal node class for MXFunction
   \author Joel Andersson 
   \date 2010
@@ -58,6 +61,12 @@ class MXFunctionInternal : public XFunctionInternal<MXFunction,MXFunctionInterna
     /** \brief  Evaluate the algorithm */
     virtual void evaluate(int nfdir, int nadir);
 
+    /** \brief  Evaluate without derivatives, only reevaluating the operations that depend on inputs that changed since the last call */
+    void evaluateIncremental();
+
+    /** \brief  Forward sweep evaluating the elements level by level, the independent function calls of a level concurrently */
+    void evaluateLevels(int nfdir);
+
     /** \brief  Print description */
     virtual void print(std::ostream &stream) const;
 
@@ -116,8 +125,58 @@ class MXFunctionInternal : public XFunctionInternal<MXFunction,MXFunctionInterna
     /** \brief Expand the matrix valued graph into a scalar valued graph */
     SXFunction expand(const std::vector<SXMatrix>& inputv );
     
-    // Update pointers to a particular element
-    void updatePointers(const AlgEl& el, int nfdir, int nadir);
+    /** \brief  An element of the execution plan, a flattened algorithm element */
+    struct PlanEl{
+      /// Operation
+      int op;
+      
+      /// Node to be evaluated (owned by the algorithm), null for outputs
+      MXNode* node;
+      
+      /// Number of arguments and results
+      int narg, nres;
+      
+      /// Offset of the argument indices, followed by the result indices, in plan_ind_
+      int ind;
+      
+      /// Offset in ptr_arena_
+      int ptr;
+      
+      /// Is the operation nonlinear (for the lifting function)
+      bool nonlinear;
+    };
+    
+    /** \brief  Execution plan: the algorithm flattened into contiguous arrays. 
+        Generated during initialization and not modified during evaluation. */
+    std::vector<PlanEl> plan_;
+    
+    /** \brief  Argument and result work vector indices of all the elements of the plan */
+    std::vector<int> plan_ind_;
+    
+    /** \brief Generate the execution plan from the algorithm */
+    void buildPlan();
+    
+    /** \brief Precompute the pointers to the work matrices of all elements of the plan */
+    void allocPointers();
+    
+    /** \brief Update pointers to a particular element (copied from the precomputed table, no allocation) */
+    void updatePointers(int k, int nfdir, int nadir);
+
+    /** \brief Get the pointers to the nondifferentiated and forward work matrices of a particular element */
+    void getPointers(int k, int nfdir, DMatrixPtrV& input, DMatrixPtrV& output, DMatrixPtrVV& fwdSeed, DMatrixPtrVV& fwdSens);
+    
+    /** \brief Point v[d] to the forward or adjoint work matrices of direction d of the n work vector elements ind */
+    void getDirections(const int* ind, int n, int ndir, bool fwd, DMatrixPtrVV& v);
+    
+    /** \brief Sort the algorithm elements by dependency level and give each concurrently evaluated call its own function */
+    void buildLevels();
+    
+    /** \brief Set the number of directions of a pointer vector, reserving room for max_size pointers per direction */
+    static void resizeDirections(DMatrixPtrVV& v, int ndir, int max_size);
+    
+    /** \brief Pointers to the nondifferentiated work matrices of all elements of the plan: inputs (na) followed by outputs (nr).
+        The pointers of the directional derivatives are looked up in plan_ind_, so the table does not grow with the number of directions. */
+    std::vector<DMatrix*> ptr_arena_;
     
     // Vectors to hold pointers during evaluation
     DMatrixPtrV mx_input_;
@@ -126,6 +185,43 @@ class MXFunctionInternal : public XFunctionInternal<MXFunction,MXFunctionInterna
     DMatrixPtrVV mx_fwdSens_;
     DMatrixPtrVV mx_adjSeed_;
     DMatrixPtrVV mx_adjSens_;
+    
+    /// Keep the results of the previous call and only reevaluate what depends on changed inputs
+    bool incremental_;
+    
+    /// Does the work vector contain the results for last_input_
+    bool cache_valid_;
+    
+    /// Input values of the previous call (incremental evaluation)
+    std::vector<std::vector<double> > last_input_;
+    
+    /// Marks the work vector elements that have changed during an incremental evaluation
+    std::vector<bool> work_changed_;
+    
+    /// Evaluate independent function calls concurrently
+    bool parallel_;
+    
+    /// Number of threads of the thread pool
+    int num_threads_;
+    
+    /// Thread pool, created at the first evaluation
+    ThreadPool* pool_;
+    
+    /// Elements of the plan (other than inputs and outputs) sorted by dependency level, level l is [level_offset_[l],level_offset_[l+1])
+    std::vector<int> level_el_, level_offset_;
+    
+    /// Is the level evaluated concurrently
+    std::vector<bool> level_parallel_;
+    
+    // Pointer vectors of each thread of the pool
+    std::vector<DMatrixPtrV> thread_input_, thread_output_;
+    std::vector<DMatrixPtrVV> thread_fwdSeed_, thread_fwdSens_;
+    
+    // Passed for the directions not being evaluated
+    DMatrixPtrVV mx_noDir_;
+    
+    // Largest number of arguments and results of an algorithm element
+    int max_arg_, max_res_;
 
     /// Get a vector of symbolic variables with the same dimensions as the inputs
     virtual std::vector<MX> symbolicInput() const{ return inputv_;}
@@ -136,6 +232,15 @@ class MXFunctionInternal : public XFunctionInternal<MXFunction,MXFunctionInterna
     /// Is the class able to propate seeds through the algorithm?
     virtual bool spCanEvaluate(bool fwd){ return true;}
 
+    /** \brief Combine a hash of the structure of the function into seed */
+    virtual bool structuralHash(std::size_t& seed) const;
+
+    /** \brief Write the function to a binary stream, including the embedded functions */
+    virtual void serialize(std::ostream& stream) const;
+
+    /** \brief Read a function written by serialize (after the type tag) */
+    static MXFunction deserialize(std::istream& stream);
+
     /// Reset the sparsity propagation
     virtual void spInit(bool fwd);
     
@@ -22,21 +22,55 @@
 
 #include "parallelizer_internal.hpp"
 #include "mx_function.hpp"
+#include "thread_pool.hpp"
 #include <algorithm>
 #ifdef WITH_OPENMP
 #include <omp.h>
 #endif //WITH_OPENMP
+#ifdef WITH_MPI
+#include <mpi.h>
+#include <cstdlib>
+#endif //WITH_MPI
+#ifdef WITH_THREADS
+#include <chrono>
+#endif //WITH_THREADS
 
 using namespace std;
 
 namespace CasADi{
+
+#ifdef WITH_MPI
+  /// Set if MPI was initialized by CasADi rather than by the program
+  static bool mpi_initialized_by_casadi = false;
+
+  /// Finalize MPI at exit if it was initialized by CasADi and the program has not finalized it
+  static void finalizeMPI(){
+    int finalized;
+    MPI_Finalized(&finalized);
+    if(mpi_initialized_by_casadi && !finalized) MPI_Finalize();
+  }
+#endif //WITH_MPI
+
+#ifdef WITH_THREADS
+  /// Wall time in seconds
+  static double wallTime(){
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+  }
+#endif //WITH_THREADS
   
-ParallelizerInternal::ParallelizerInternal(const std::vector<FX>& funcs) : funcs_(funcs){
-  addOption("parallelization", OT_STRING, "serial","","serial|openmp|mpi"); 
+ParallelizerInternal::ParallelizerInternal(const std::vector<FX>& funcs) : funcs_(funcs), pool_(0){
+  addOption("parallelization", OT_STRING, "serial","","serial|openmp|mpi|threads"); 
+  addOption("num_threads", OT_INTEGER, 0, "Number of threads of the thread pool (0: one per core)");
+  addOption("pin_threads", OT_BOOLEAN, false, "Pin each thread of the thread pool to a core, the cores are assigned round robin over all pinned pools");
   addOption("save_corrected_input", OT_BOOLEAN, false);
+  addOption("schedule", OT_STRING, "static", "Distribution of the tasks over the threads","static: fixed contiguous blocks of tasks|work_stealing: per-thread task queues, idle threads steal tasks from busy ones");
+  addOption("cost_model", OT_BOOLEAN, false, "Use the task execution times measured in previous calls to balance the initial distribution of the tasks (work_stealing schedule or threads parallelization)");
 }
 
 ParallelizerInternal::~ParallelizerInternal(){
+#ifdef WITH_THREADS
+  delete pool_;
+#endif // WITH_THREADS
 }
 
 
@@ -48,6 +82,8 @@ void ParallelizerInternal::init(){
     mode_ = OPENMP;
   } else if(getOption("parallelization")=="mpi") {
     mode_ = MPI;
+  } else if(getOption("parallelization")=="threads") {
+    mode_ = THREADS;
   } else {
     casadi_error("Parallelization mode " << getOption("parallelization") << " unknown.");
   }
@@ -59,7 +95,67 @@ void ParallelizerInternal::init(){
     mode_ = SERIAL;
   }
   #endif // WITH_OPENMP
+
+  // Switch to serial mode if MPI is not supported, otherwise make sure that MPI is initialized
+  #ifdef WITH_MPI
+  if(mode_ == MPI){
+    int initialized, finalized;
+    MPI_Initialized(&initialized);
+    MPI_Finalized(&finalized);
+    casadi_assert_message(!finalized, "Parallelizer: MPI has already been finalized by the program, the MPI parallelization is not available anymore.");
+    
+    // If the program has not initialized MPI, CasADi does and finalizes it at exit, otherwise it is left to the program
+    if(!initialized){
+      MPI_Init(0,0);
+      mpi_initialized_by_casadi = true;
+      atexit(finalizeMPI);
+    }
+  }
+  #else // WITH_MPI
+  if(mode_ == MPI){
+    casadi_warning("MPI parallelization is not available, switching to serial mode. Recompile CasADi setting the option WITH_MPI to ON.");
+    mode_ = SERIAL;
+  }
+  #endif // WITH_MPI
+  
+  // Switch to serial mode if the thread pool is not supported
+  #ifdef WITH_THREADS
+  num_threads_ = getOption("num_threads");
+  casadi_assert_message(num_threads_>=0, "Parallelizer: num_threads must be nonnegative");
+  if(num_threads_==0) num_threads_ = max(1,int(thread::hardware_concurrency()));
+  pin_threads_ = getOption("pin_threads");
+  
+  // Free the thread pool, it will be recreated at the first evaluation
+  delete pool_;
+  pool_ = 0;
+  #else // WITH_THREADS
+  if(mode_ == THREADS){
+    casadi_warning("Thread pool parallelization is not available, switching to serial mode. Recompile CasADi with C++11 support and the option WITH_THREADS set to ON.");
+    mode_ = SERIAL;
+  }
+  #endif // WITH_THREADS
   
+  // The reference counts of shared expressions are not atomic unless WITH_THREADSAFE_SYMBOLICS is set
+  #ifndef WITH_THREADSAFE_SYMBOLICS
+  if(mode_ == THREADS){
+    casadi_warning("Parallelizer: CasADi was compiled without WITH_THREADSAFE_SYMBOLICS, the functions are only evaluated safely on the thread pool "
+                   "if they do not create or release shared expressions during evaluation. Recompile CasADi setting the option WITH_THREADSAFE_SYMBOLICS to ON.");
+  }
+  #endif // WITH_THREADSAFE_SYMBOLICS
+  
+  // Get scheduling strategy
+  if(getOption("schedule")=="static"){
+    schedule_ = STATIC;
+  } else if(getOption("schedule")=="work_stealing"){
+    schedule_ = WORK_STEALING;
+  } else {
+    casadi_error("Schedule " << getOption("schedule") << " unknown.");
+  }
+  cost_model_ = getOption("cost_model");
+  
+  // No execution times have been measured yet
+  task_cost_.clear();
+  task_cost_.resize(funcs_.size(),-1);
   
   // Check if a node is a copy of another
   copy_of_.resize(funcs_.size(),-1);
@@ -80,8 +176,8 @@ void ParallelizerInternal::init(){
     if(!it->isInit())
       it->init();
     
-    // Make sure that the functions are unique if we are using OpenMP
-    if(mode_==OPENMP && it!=funcs_.begin())
+    // Make sure that the functions are unique if we are using threads
+    if((mode_==OPENMP || mode_==THREADS) && it!=funcs_.begin())
       it->makeUnique();
     
   }
@@ -127,53 +223,368 @@ void ParallelizerInternal::evaluate(int nfdir, int nadir){
     // Allocate some lists to collect statistics
     std::vector<int> task_allocation(funcs_.size());
     std::vector<int> task_order(funcs_.size());
-    std::vector<double> task_cputime(funcs_.size());
     std::vector<double> task_starttime(funcs_.size());
     std::vector<double> task_endtime(funcs_.size());
-    // A private counter
-    int cnt=0;
-    #pragma omp parallel for firstprivate(cnt)
-    for(int task=0; task<funcs_.size(); ++task) {
-      if (gather_stats_ && task==0) {
-        stats_["max_threads"] = omp_get_max_threads();
-        stats_["num_threads"] = omp_get_num_threads();
+    if(schedule_==STATIC){
+      // A private counter
+      int cnt=0;
+      #pragma omp parallel for firstprivate(cnt)
+      for(int task=0; task<funcs_.size(); ++task) {
+        if (gather_stats_ && task==0) {
+          stats_["max_threads"] = omp_get_max_threads();
+          stats_["num_threads"] = omp_get_num_threads();
+        }
+        task_allocation[task] = omp_get_thread_num();
+        task_starttime[task] = omp_get_wtime();
+        
+        // Do the actual work
+        evaluateTask(task,nfdir,nadir);
+        
+        task_endtime[task] = omp_get_wtime();
+        task_order[task] = cnt++;
+      }
+    } else {
+      // Fill the task queues
+      int nthreads = omp_get_max_threads();
+      distributeTasks(nthreads);
+      std::vector<int> task_stolen(funcs_.size(),0);
+
+      #pragma omp parallel num_threads(nthreads)
+      {
+        int thread = omp_get_thread_num();
+        if (gather_stats_ && thread==0) {
+          stats_["max_threads"] = omp_get_max_threads();
+          stats_["num_threads"] = omp_get_num_threads();
+        }
+        
+        // Process tasks until all queues are empty
+        int cnt=0;
+        int task;
+        bool stolen;
+        while(nextTask(thread,task,stolen)){
+          task_allocation[task] = thread;
+          task_stolen[task] = stolen;
+          task_starttime[task] = omp_get_wtime();
+          
+          // Do the actual work
+          evaluateTask(task,nfdir,nadir);
+          
+          task_endtime[task] = omp_get_wtime();
+          task_order[task] = cnt++;
+        }
+      }
+      if (gather_stats_) {
+        stats_["task_stolen"] = task_stolen;
       }
-      task_allocation[task] = omp_get_thread_num();
-      task_starttime[task] = omp_get_wtime();
-      
-      // Do the actual work
-      evaluateTask(task,nfdir,nadir);
-      
-      task_endtime[task] = omp_get_wtime();
-      task_cputime[task] =  task_endtime[task] - task_starttime[task];
-      task_order[task] = cnt++;
     }
     if (gather_stats_) {
       stats_["task_allocation"] = task_allocation;
       stats_["task_order"] = task_order;
-      stats_["task_cputime"] = task_cputime;
-    }
-    // Measure all times relative to the earliest start_time.
-    double start = *std::min_element(task_starttime.begin(),task_starttime.end());
-    for (int task=0; task<funcs_.size(); ++task) {
-      task_starttime[task] =  task_starttime[task] - start;
-      task_endtime[task] = task_endtime[task] - start;
-    }
-    if (gather_stats_) {
-      stats_["task_starttime"] = task_starttime;
-      stats_["task_endtime"] = task_endtime;
     }
     
+    // Update the cost model and get per-thread utilization
+    collectTaskStats(omp_get_max_threads(),task_allocation,task_starttime,task_endtime);
     #endif //WITH_OPENMP
     #ifndef WITH_OPENMP
       casadi_error("ParallelizerInternal::evaluate: OPENMP support was not available during CasADi compilation");
     #endif //WITH_OPENMP
   } else if(mode_ == MPI){
-    casadi_error("ParallelizerInternal::evaluate: MPI not implemented");
+    evaluateMPI(nfdir,nadir);
+  } else if(mode_ == THREADS){
+    evaluateThreads(nfdir,nadir);
   }
   first_call_ = false;
 }
 
+void ParallelizerInternal::evaluateMPI(int nfdir, int nadir){
+#ifdef WITH_MPI
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&size);
+  int ntask = funcs_.size();
+  
+  // Each process evaluates a contiguous block of tasks
+  vector<int> first(size+1);
+  for(int r=0; r<=size; ++r) first[r] = (r*ntask)/size;
+  
+  // Number of values to be sent to and received from each process
+  vector<int> in_count(size,0), in_displ(size,0), res_count(size,0), res_displ(size,0);
+  vector<Matrix<double>*> m;
+  for(int r=0; r<size; ++r){
+    for(int task=first[r]; task<first[r+1]; ++task){
+      getTaskInputs(task,nfdir,nadir,m);
+      for(vector<Matrix<double>*>::const_iterator it=m.begin(); it!=m.end(); ++it) in_count[r] += (*it)->size();
+      getTaskResults(task,nfdir,nadir,m);
+      for(vector<Matrix<double>*>::const_iterator it=m.begin(); it!=m.end(); ++it) res_count[r] += (*it)->size();
+    }
+    if(r>0){
+      in_displ[r] = in_displ[r-1] + in_count[r-1];
+      res_displ[r] = res_displ[r-1] + res_count[r-1];
+    }
+  }
+  
+  // Pack the inputs and seeds of all tasks on the root process
+  vector<double> buf;
+  if(rank==0){
+    buf.reserve(in_displ.back()+in_count.back());
+    for(int task=0; task<ntask; ++task){
+      getTaskInputs(task,nfdir,nadir,m);
+      for(vector<Matrix<double>*>::const_iterator it=m.begin(); it!=m.end(); ++it){
+        buf.insert(buf.end(),(*it)->begin(),(*it)->end());
+      }
+    }
+  }
+
+  // Scatter to the processes evaluating the tasks
+  vector<double> local(max(in_count[rank],res_count[rank]));
+  MPI_Scatterv(getPtr(buf),getPtr(in_count),getPtr(in_displ),MPI_DOUBLE,getPtr(local),in_count[rank],MPI_DOUBLE,0,MPI_COMM_WORLD);
+  const double* local_ptr = getPtr(local);
+  for(int task=first[rank]; task<first[rank+1]; ++task){
+    getTaskInputs(task,nfdir,nadir,m);
+    for(vector<Matrix<double>*>::const_iterator it=m.begin(); it!=m.end(); ++it){
+      (*it)->set(local_ptr);
+      local_ptr += (*it)->size();
+    }
+  }
+  
+  // Evaluate the local tasks
+  vector<double> task_cputime(ntask,0);
+  for(int task=first[rank]; task<first[rank+1]; ++task){
+    double starttime = MPI_Wtime();
+    evaluateTask(task,nfdir,nadir);
+    task_cputime[task] = MPI_Wtime() - starttime;
+  }
+
+  // Pack the local results
+  double* res_ptr = getPtr(local);
+  for(int task=first[rank]; task<first[rank+1]; ++task){
+    getTaskResults(task,nfdir,nadir,m);
+    for(vector<Matrix<double>*>::const_iterator it=m.begin(); it!=m.end(); ++it){
+      (*it)->get(res_ptr);
+      res_ptr += (*it)->size();
+    }
+  }
+  
+  // Gather the results of all tasks on all processes
+  buf.resize(res_displ.back()+res_count.back());
+  MPI_Allgatherv(getPtr(local),res_count[rank],MPI_DOUBLE,getPtr(buf),getPtr(res_count),getPtr(res_displ),MPI_DOUBLE,MPI_COMM_WORLD);
+  const double* buf_ptr = getPtr(buf);
+  for(int task=0; task<ntask; ++task){
+    getTaskResults(task,nfdir,nadir,m);
+    for(vector<Matrix<double>*>::const_iterator it=m.begin(); it!=m.end(); ++it){
+      if(task<first[rank] || task>=first[rank+1]) (*it)->set(buf_ptr);
+      buf_ptr += (*it)->size();
+    }
+  }
+  
+  if (gather_stats_) {
+    stats_["mpi_rank"] = rank;
+    stats_["mpi_size"] = size;
+    vector<int> task_allocation(ntask);
+    for(int r=0; r<size; ++r){
+      fill(task_allocation.begin()+first[r],task_allocation.begin()+first[r+1],r);
+    }
+    stats_["task_allocation"] = task_allocation;
+    MPI_Allreduce(MPI_IN_PLACE,getPtr(task_cputime),ntask,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+    stats_["task_cputime"] = task_cputime;
+  }
+#else // WITH_MPI
+  casadi_error("ParallelizerInternal::evaluate: MPI support was not available during CasADi compilation");
+#endif // WITH_MPI
+}
+
+void ParallelizerInternal::evaluateThreads(int nfdir, int nadir){
+#ifdef WITH_THREADS
+  // Start the workers
+  if(pool_==0){
+    pool_ = new ThreadPool(num_threads_,pin_threads_);
+  }
+  
+  // Statistics
+  int ntask = funcs_.size();
+  std::vector<int> task_allocation(ntask);
+  std::vector<int> task_order(ntask);
+  std::vector<int> task_stolen(ntask,0);
+  std::vector<double> task_starttime(ntask);
+  std::vector<double> task_endtime(ntask);
+  
+  // Fill the task queues, the static schedule is obtained by not stealing
+  distributeTasks(pool_->size());
+  bool steal = schedule_==WORK_STEALING;
+  
+  // Process tasks until all queues are empty
+  pool_->run([&](int thread){
+    int cnt=0;
+    int task;
+    bool stolen;
+    while(nextTask(thread,task,stolen,steal)){
+      task_allocation[task] = thread;
+      task_stolen[task] = stolen;
+      task_starttime[task] = wallTime();
+      
+      // Do the actual work
+      evaluateTask(task,nfdir,nadir);
+      
+      task_endtime[task] = wallTime();
+      task_order[task] = cnt++;
+    }
+  });
+  
+  if (gather_stats_) {
+    stats_["num_threads"] = pool_->size();
+    stats_["task_allocation"] = task_allocation;
+    stats_["task_order"] = task_order;
+    if(steal) stats_["task_stolen"] = task_stolen;
+  }
+  
+  // Update the cost model and get per-thread utilization
+  collectTaskStats(pool_->size(),task_allocation,task_starttime,task_endtime);
+#else // WITH_THREADS
+  casadi_error("ParallelizerInternal::evaluate: thread pool support was not available during CasADi compilation");
+#endif // WITH_THREADS
+}
+
+void ParallelizerInternal::getTaskInputs(int task, int nfdir, int nadir, std::vector<Matrix<double>*>& v){
+  v.clear();
+  for(int j=inind_[task]; j<inind_[task+1]; ++j) v.push_back(&input(j));
+  for(int j=outind_[task]; j<outind_[task+1]; ++j) v.push_back(&output(j));
+  for(int dir=0; dir<nfdir; ++dir){
+    for(int j=inind_[task]; j<inind_[task+1]; ++j) v.push_back(&fwdSeed(j,dir));
+  }
+  for(int dir=0; dir<nadir; ++dir){
+    for(int j=outind_[task]; j<outind_[task+1]; ++j) v.push_back(&adjSeed(j,dir));
+  }
+}
+
+void ParallelizerInternal::getTaskResults(int task, int nfdir, int nadir, std::vector<Matrix<double>*>& v){
+  v.clear();
+  for(int j=outind_[task]; j<outind_[task+1]; ++j) v.push_back(&output(j));
+  for(int dir=0; dir<nfdir; ++dir){
+    for(int j=outind_[task]; j<outind_[task+1]; ++j) v.push_back(&fwdSens(j,dir));
+  }
+  for(int dir=0; dir<nadir; ++dir){
+    for(int j=inind_[task]; j<inind_[task+1]; ++j) v.push_back(&adjSens(j,dir));
+  }
+  if(save_corrected_input_){
+    for(int j=inind_[task]; j<inind_[task+1]; ++j) v.push_back(&input(j));
+  }
+}
+
+void ParallelizerInternal::distributeTasks(int nthreads){
+  int ntask = funcs_.size();
+  queue_.clear();
+  queue_.resize(nthreads);
+  
+  // Are execution times available for all the tasks?
+  bool has_cost = cost_model_;
+  for(int task=0; task<ntask && has_cost; ++task){
+    has_cost = task_cost_[task]>=0;
+  }
+  
+  if(has_cost){
+    // Longest processing time first: assign the most expensive remaining task to the least loaded thread
+    vector<pair<double,int> > sorted(ntask);
+    for(int task=0; task<ntask; ++task){
+      sorted[task] = pair<double,int>(-task_cost_[task],task);
+    }
+    sort(sorted.begin(),sorted.end());
+    vector<double> load(nthreads,0);
+    for(vector<pair<double,int> >::const_iterator it=sorted.begin(); it!=sorted.end(); ++it){
+      int thread = min_element(load.begin(),load.end()) - load.begin();
+      load[thread] -= it->first;
+      
+      // Each queue is sorted by decreasing cost, so the cheap tasks at the back are the ones stolen
+      queue_[thread].push_back(it->second);
+    }
+  } else {
+    // Contiguous blocks, as in the static schedule
+    for(int task=0; task<ntask; ++task){
+      queue_[(task*nthreads)/ntask].push_back(task);
+    }
+  }
+}
+
+bool ParallelizerInternal::nextTask(int thread, int& task, bool& stolen, bool steal){
+  bool found = false;
+#ifdef WITH_THREADS
+  unique_lock<mutex> lock(queue_mutex_, defer_lock);
+  if(mode_==THREADS) lock.lock();
+#endif // WITH_THREADS
+  #pragma omp critical(casadi_parallelizer_queue)
+  {
+    // Take the first task from the own queue
+    if(!queue_[thread].empty()){
+      task = queue_[thread].front();
+      queue_[thread].pop_front();
+      stolen = false;
+      found = true;
+    } else if(steal){
+      // Steal the last task of the next nonempty queue
+      for(int k=1; k<queue_.size(); ++k){
+        std::deque<int>& victim = queue_[(thread+k) % queue_.size()];
+        if(!victim.empty()){
+          task = victim.back();
+          victim.pop_back();
+          stolen = true;
+          found = true;
+          break;
+        }
+      }
+    }
+  }
+  return found;
+}
+
+void ParallelizerInternal::collectTaskStats(int nthreads, const std::vector<int>& task_allocation, std::vector<double>& task_starttime, std::vector<double>& task_endtime){
+  int ntask = funcs_.size();
+  if(ntask==0) return;
+  
+  // Execution times
+  vector<double> task_cputime(ntask);
+  for(int task=0; task<ntask; ++task){
+    task_cputime[task] = task_endtime[task] - task_starttime[task];
+  }
+  
+  // Update the cost model, averaging with previous measurements to filter out noise
+  if(cost_model_){
+    for(int task=0; task<ntask; ++task){
+      if(task_cost_[task]<0){
+        task_cost_[task] = task_cputime[task];
+      } else {
+        task_cost_[task] = 0.5*(task_cost_[task] + task_cputime[task]);
+      }
+    }
+  }
+  
+  // Measure all times relative to the earliest start_time.
+  double start = *std::min_element(task_starttime.begin(),task_starttime.end());
+  for (int task=0; task<ntask; ++task) {
+    task_starttime[task] =  task_starttime[task] - start;
+    task_endtime[task] = task_endtime[task] - start;
+  }
+  double walltime = *std::max_element(task_endtime.begin(),task_endtime.end());
+  
+  if (gather_stats_) {
+    stats_["task_cputime"] = task_cputime;
+    stats_["task_starttime"] = task_starttime;
+    stats_["task_endtime"] = task_endtime;
+    
+    // Time spent by each thread executing tasks, and as a fraction of the total time
+    vector<double> thread_busytime(nthreads,0);
+    for(int task=0; task<ntask; ++task){
+      thread_busytime[task_allocation[task]] += task_cputime[task];
+    }
+    vector<double> thread_utilization(nthreads,0);
+    if(walltime>0){
+      for(int thread=0; thread<nthreads; ++thread){
+        thread_utilization[thread] = thread_busytime[thread]/walltime;
+      }
+    }
+    stats_["thread_busytime"] = thread_busytime;
+    stats_["thread_utilization"] = thread_utilization;
+  }
+}
+
 void ParallelizerInternal::evaluateTask(int task, int nfdir, int nadir){
   
   // Get a reference to the function
@@ -24,10 +24,17 @@
 #define PARALLELIZER_INTERNAL_HPP
 
 #include <vector>
+#include <deque>
+#ifdef WITH_THREADS
+#include <mutex>
+#endif // WITH_THREADS
 #include "parallelizer.hpp"
 #include "fx_internal.hpp"
 
 namespace CasADi{
+
+  // Forward declaration
+  class ThreadPool;
  
   /** \brief  Internal node class for Parallelizer
   \author Joel Andersson 
@@ -44,6 +51,7 @@ class ParallelizerInternal : public FXInternal{
     /// clone
     virtual ParallelizerInternal* clone() const{ 
       ParallelizerInternal* ret = new ParallelizerInternal(*this);
+      ret->pool_ = 0;
       for(std::vector<FX>::iterator it=ret->funcs_.begin(); it!=ret->funcs_.end(); ++it){
         it->makeUnique();
       }
@@ -59,6 +67,27 @@ class ParallelizerInternal : public FXInternal{
     /// Evaluate a single task
     virtual void evaluateTask(int task, int nfdir, int nadir);
 
+    /// Distribute the tasks over the queues of nthreads threads before a work-stealing evaluation
+    void distributeTasks(int nthreads);
+
+    /// Get the next task for a thread, from its own queue if possible, otherwise (if steal is true) stolen from another thread
+    bool nextTask(int thread, int& task, bool& stolen, bool steal=true);
+    
+    /// Evaluate the tasks with the thread pool
+    void evaluateThreads(int nfdir, int nadir);
+    
+    /// Evaluate the tasks distributed over the processes of MPI_COMM_WORLD
+    void evaluateMPI(int nfdir, int nadir);
+    
+    /// Get the matrices that the process evaluating a task needs: inputs, outputs (used for initialization) and seeds
+    void getTaskInputs(int task, int nfdir, int nadir, std::vector<Matrix<double>*>& v);
+
+    /// Get the matrices that the process evaluating a task returns: outputs, sensitivities and possibly corrected inputs
+    void getTaskResults(int task, int nfdir, int nadir, std::vector<Matrix<double>*>& v);
+    
+    /// Update the cost model and collect per-thread statistics after a parallel evaluation
+    void collectTaskStats(int nthreads, const std::vector<int>& task_allocation, std::vector<double>& task_starttime, std::vector<double>& task_endtime);
+
     /// Reset the sparsity propagation
     virtual void spInit(bool use_fwd);
     
@@ -99,11 +128,47 @@ class ParallelizerInternal : public FXInternal{
     std::vector<int> copy_of_;
     
     /// Parallelization modes
-    enum Mode{SERIAL,OPENMP,MPI};
+    enum Mode{SERIAL,OPENMP,MPI,THREADS};
     
     /// Mode
     Mode mode_;
     
+    /// Scheduling strategies
+    enum Schedule{STATIC,WORK_STEALING};
+    
+    /// Scheduling strategy
+    Schedule schedule_;
+    
+    /// Distribute the tasks according to the execution times measured in previous calls
+    bool cost_model_;
+    
+    /// Estimated cost of each task (negative if not yet measured)
+    std::vector<double> task_cost_;
+    
+    /// Task queues, one per thread (work-stealing scheduling and thread pool)
+    std::vector<std::deque<int> > queue_;
+    
+#ifdef WITH_THREADS
+    /// Mutex that is not shared with copies of the function
+    struct QueueMutex : public std::mutex{
+      QueueMutex(){}
+      QueueMutex(const QueueMutex&){}
+      QueueMutex& operator=(const QueueMutex&){ return *this;}
+    };
+    
+    /// Protects the task queues when using the thread pool
+    QueueMutex queue_mutex_;
+#endif // WITH_THREADS
+    
+    /// Number of threads of the thread pool
+    int num_threads_;
+    
+    /// Pin the threads of the thread pool to cores
+    bool pin_threads_;
+    
+    /// Thread pool, created at the first evaluation
+    ThreadPool* pool_;
+    
     /// Save corrected input values after evaluation
     bool save_corrected_input_;
     
@@ -100,6 +100,34 @@ SXMatrix SXFunction::hess(int iind, int oind){
   return (*this)->hess(iind,oind);
 }
 
+std::vector<DMatrix> SXFunction::evaluateBatch(const std::vector<DMatrix>& arg){
+  assertInit();
+  casadi_assert_message(arg.size()==getNumInputs(),"SXFunction::evaluateBatch: Wrong number of inputs. Expecting " << getNumInputs() << ", got " << arg.size());
+  
+  // Number of points
+  int npoints = arg.empty() ? 0 : arg.front().size2();
+  
+  // Pointers to the input nonzeros
+  vector<const double*> argp(arg.size());
+  for(int i=0; i<arg.size(); ++i){
+    casadi_assert_message(arg[i].size1()==input(i).size() && arg[i].size2()==npoints && arg[i].dense(),
+                          "SXFunction::evaluateBatch: Input " << i << " must be a dense " << input(i).size() << "-by-" << npoints << " matrix, got " << arg[i].dimString());
+    argp[i] = getPtr(arg[i].data());
+  }
+  
+  // Allocate the outputs
+  vector<DMatrix> ret(getNumOutputs());
+  vector<double*> resp(ret.size());
+  for(int i=0; i<ret.size(); ++i){
+    ret[i] = DMatrix(output(i).size(),npoints,0);
+    resp[i] = getPtr(ret[i].data());
+  }
+  
+  // Evaluate
+  (*this)->evaluateBatch(npoints,getPtr(argp),getPtr(resp));
+  return ret;
+}
+
 const SXMatrix& SXFunction::inputExpr(int ind) const{
   return (*this)->inputv_.at(ind);
 }
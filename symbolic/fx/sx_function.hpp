@@ -119,6 +119,13 @@ public:
   /// Check if the node is pointing to the right type of object
   virtual bool checkNode() const;
     
+  /** \brief Evaluate numerically at multiple points in a single sweep over the algorithm
+  *
+  * Input \a i is passed as a dense matrix with one row per nonzero of the input and one column per point.
+  * The outputs are returned in the same format.
+  */
+  std::vector<DMatrix> evaluateBatch(const std::vector<DMatrix>& arg);
+    
   /** \brief Get function input */
   const SXMatrix& inputExpr(int ind) const;
   
@@ -32,6 +32,7 @@
 #include "../sx/sx_node.hpp"
 #include "../casadi_types.hpp"
 #include "../matrix/crs_sparsity_internal.hpp"
+#include "../matrix/sparsity_tools.hpp"
 
 #ifdef WITH_LLVM
 #include "llvm/DerivedTypes.h"
@@ -49,6 +50,17 @@
 llvm::IRBuilder<> builder(llvm::getGlobalContext());
 #endif // WITH_LLVM
 
+// The following works for Linux, something simular is needed for Windows
+#ifdef WITH_DL 
+#include <dlfcn.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif // WITH_DL 
+
 namespace CasADi{
 
 using namespace std;
@@ -60,6 +72,13 @@ SXFunctionInternal::SXFunctionInternal(const vector<SXMatrix >& inputv, const ve
   addOption("just_in_time", OT_BOOLEAN,false,"Just-in-time compilation for numeric evaluation (experimental)");
   addOption("just_in_time_sparsity", OT_BOOLEAN,false,"Propagate sparsity patterns using just-in-time compilation to a CPU or GPU using OpenCL");
   addOption("just_in_time_opencl", OT_BOOLEAN,false,"Just-in-time compilation for numeric evaluation using OpenCL (experimental)");
+  addOption("vectorize_directions", OT_BOOLEAN,true,"Propagate all forward (adjoint) directions in a single sweep over the algorithm using a direction-contiguous work vector");
+  addOption("interpreter", OT_STRING,"switch","Virtual machine used for numerical evaluation without derivatives","switch|threaded");
+  addOption("just_in_time_c", OT_BOOLEAN,false,"Just-in-time compilation for numeric evaluation and directional derivatives by compiling generated C code with the system C compiler (requires WITH_DL)");
+  addOption("jit_compiler", OT_STRING,"cc","C compiler command used for the option \"just_in_time_c\"");
+  addOption("jit_flags", OT_STRING,"-O2","C compiler flags used for the option \"just_in_time_c\"");
+  addOption("jit_cache_dir", OT_STRING,GenericType(),"Directory where the compiled code is cached, keyed by a hash of the generated code. "
+                                                        "It must be owned by the user and not writable by others. Defaults to casadi_jit_<uid> in $TMPDIR or /tmp, created with mode 0700");
 
   // Check for duplicate entries among the input expressions
   bool has_duplicates = false;
@@ -91,6 +110,14 @@ SXFunctionInternal::SXFunctionInternal(const vector<SXMatrix >& inputv, const ve
   
   casadi_assert(!outputv_.empty()); // NOTE: Remove?
   
+  // Not vectorized until initialized
+  vectorize_directions_ = false;
+  threaded_interpreter_ = false;
+  just_in_time_c_ = false;
+#ifdef WITH_DL
+  jit_handle_ = 0;
+#endif // WITH_DL
+  
   // Reset OpenCL memory
 #ifdef WITH_OPENCL
   kernel_ = 0;
@@ -102,6 +129,9 @@ SXFunctionInternal::SXFunctionInternal(const vector<SXMatrix >& inputv, const ve
 }
 
 SXFunctionInternal::~SXFunctionInternal(){
+  // Unload just-in-time compiled code
+  jitFree();
+
   // Free OpenCL memory
 #ifdef WITH_OPENCL
   freeOpenCL();
@@ -154,6 +184,12 @@ void SXFunctionInternal::evaluateGen(T1 nfdir_c, T2 nadir_c){
     casadi_error("Cannot evaluate \"" << ss.str() << "\" since variables " << free_vars_ << " are free.");
   }
   
+  // Evaluate with code compiled by the system C compiler
+  if(just_in_time_c_){
+    evaluateJit(nfdir,nadir);
+    return;
+  }
+  
   #ifdef WITH_LLVM
   if(just_in_time_ && nfdir==0 && nadir==0){
     // Evaluate the jitted function
@@ -174,7 +210,9 @@ void SXFunctionInternal::evaluateGen(T1 nfdir_c, T2 nadir_c){
   const bool taping = nfdir>0 || nadir>0;
 
   // Evaluate the algorithm
-  if(!taping){
+  if(!taping && threaded_interpreter_){
+    evaluateThreaded();
+  } else if(!taping){
     for(vector<AlgEl>::iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
       switch(it->op){
         // Start by adding all of the built operations
@@ -212,6 +250,12 @@ void SXFunctionInternal::evaluateGen(T1 nfdir_c, T2 nadir_c){
   // Quick return if no sensitivities
   if(!taping) return;
 
+  // Propagate all directions at once in a direction-contiguous work vector
+  if(vectorize_directions_ && (nfdir>1 || nadir>1)){
+    evaluateDirGen(nfdir_c,nadir_c);
+    return;
+  }
+
   // Calculate forward sensitivities
   for(int dir=0; dir<nfdir; ++dir){
     vector<TapeEl<double> >::const_iterator it2 = pdwork_.begin();
@@ -257,6 +301,320 @@ void SXFunctionInternal::evaluateGen(T1 nfdir_c, T2 nadir_c){
   }
 }
 
+template<typename T1, typename T2>
+void SXFunctionInternal::evaluateDirGen(T1 nfdir_c, T2 nadir_c){
+  // The following parameters are known either at runtime or at compiletime
+  const int nfdir = nfdir_c.value;
+  const int nadir = nadir_c.value;
+
+  // Work vector with the directions stored contiguously for each element of the work vector
+  double* dwork = getPtr(dwork_);
+
+  // Calculate forward sensitivities, all directions at once
+  if(nfdir>0){
+    vector<TapeEl<double> >::const_iterator it2 = pdwork_.begin();
+    for(vector<AlgEl>::const_iterator it = algorithm_.begin(); it!=algorithm_.end(); ++it){
+      switch(it->op){
+        case OP_CONST:
+        {
+          double* r = dwork + it->res*nfdir;
+          for(int dir=0; dir<nfdir; ++dir) r[dir] = 0;
+          break;
+        }
+        case OP_INPUT:
+        {
+          double* r = dwork + it->res*nfdir;
+          for(int dir=0; dir<nfdir; ++dir) r[dir] = fwdSeedNoCheck(it->arg.i[0],dir).data()[it->arg.i[1]];
+          break;
+        }
+        case OP_OUTPUT:
+        {
+          const double* a = dwork + it->arg.i[0]*nfdir;
+          for(int dir=0; dir<nfdir; ++dir) fwdSensNoCheck(it->res,dir).data()[it->arg.i[1]] = a[dir];
+          break;
+        }
+        default: // Unary or binary operation
+        {
+          double* r = dwork + it->res*nfdir;
+          const double* a0 = dwork + it->arg.i[0]*nfdir;
+          const double* a1 = dwork + it->arg.i[1]*nfdir;
+          const double d0 = it2->d[0], d1 = it2->d[1];
+          for(int dir=0; dir<nfdir; ++dir) r[dir] = d0*a0[dir] + d1*a1[dir];
+          ++it2;
+        }
+      }
+    }
+  }
+
+  // Quick return if no adjoint sensitivities
+  if(nadir==0) return;
+
+  // Calculate adjoint sensitivities, all directions at once
+  fill_n(dwork,work_.size()*nadir,0);
+  vector<TapeEl<double> >::const_reverse_iterator it2 = pdwork_.rbegin();
+  for(vector<AlgEl>::const_reverse_iterator it = algorithm_.rbegin(); it!=algorithm_.rend(); ++it){
+    switch(it->op){
+      case OP_CONST:
+      {
+        double* r = dwork + it->res*nadir;
+        for(int dir=0; dir<nadir; ++dir) r[dir] = 0;
+        break;
+      }
+      case OP_INPUT:
+      {
+        double* r = dwork + it->res*nadir;
+        for(int dir=0; dir<nadir; ++dir){
+          adjSensNoCheck(it->arg.i[0],dir).data()[it->arg.i[1]] = r[dir];
+          r[dir] = 0;
+        }
+        break;
+      }
+      case OP_OUTPUT:
+      {
+        double* a = dwork + it->arg.i[0]*nadir;
+        for(int dir=0; dir<nadir; ++dir) a[dir] += adjSeedNoCheck(it->res,dir).data()[it->arg.i[1]];
+        break;
+      }
+      default: // Unary or binary operation
+      {
+        // Note: r may coincide with a0 or a1, and a0 with a1, the order of the statements below matters
+        double* r = dwork + it->res*nadir;
+        double* a0 = dwork + it->arg.i[0]*nadir;
+        double* a1 = dwork + it->arg.i[1]*nadir;
+        const double d0 = it2->d[0], d1 = it2->d[1];
+        for(int dir=0; dir<nadir; ++dir){
+          double seed = r[dir];
+          r[dir] = 0;
+          a0[dir] += d0 * seed;
+          a1[dir] += d1 * seed;
+        }
+        ++it2;
+      }
+    }
+  }
+}
+
+// Built-in operations that are dispatched directly by the threaded interpreter
+#define CASADI_THREADED_BUILTIN(M) \
+  M(OP_ASSIGN) \
+  M(OP_ADD) \
+  M(OP_SUB) \
+  M(OP_MUL) \
+  M(OP_DIV) \
+  M(OP_NEG) \
+  M(OP_EXP) \
+  M(OP_LOG) \
+  M(OP_POW) \
+  M(OP_CONSTPOW) \
+  M(OP_SQRT) \
+  M(OP_SIN) \
+  M(OP_COS) \
+  M(OP_TAN) \
+  M(OP_ASIN) \
+  M(OP_ACOS) \
+  M(OP_ATAN) \
+  M(OP_LT) \
+  M(OP_LE) \
+  M(OP_EQ) \
+  M(OP_NE) \
+  M(OP_NOT) \
+  M(OP_AND) \
+  M(OP_OR) \
+  M(OP_IF_ELSE_ZERO) \
+  M(OP_FLOOR) \
+  M(OP_CEIL) \
+  M(OP_FABS) \
+  M(OP_SIGN) \
+  M(OP_ERF) \
+  M(OP_FMIN) \
+  M(OP_FMAX) \
+  M(OP_INV) \
+  M(OP_SINH) \
+  M(OP_COSH) \
+  M(OP_TANH) \
+  M(OP_ASINH) \
+  M(OP_ACOSH) \
+  M(OP_ATANH) \
+  M(OP_ATAN2) \
+  M(OP_ERFINV) \
+  M(OP_LIFT) \
+  M(OP_PRINTME)
+
+void SXFunctionInternal::compileThreaded(){
+  threaded_.clear();
+  threaded_.reserve(algorithm_.size()+1);
+  threaded_const_.clear();
+  
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    ThreadedEl e;
+    e.op = it->op;
+    e.res = it->res;
+    if(it->op==OP_CONST){
+      // Constants are moved to the constant pool so that all operands are integers
+      e.arg[0] = threaded_const_.size();
+      e.arg[1] = 0;
+      threaded_const_.push_back(it->arg.d);
+    } else {
+      e.arg[0] = it->arg.i[0];
+      e.arg[1] = it->arg.i[1];
+    }
+    
+    // Fuse a multiplication with an immediately following addition that uses the product
+    vector<AlgEl>::const_iterator it_next = it+1;
+    if(it->op==OP_MUL && it_next!=algorithm_.end() && it_next->op==OP_ADD && 
+       (it_next->arg.i[0]==it->res || it_next->arg.i[1]==it->res)){
+      e.op = TH_MUL_ADD;
+      threaded_.push_back(e);
+      
+      // The second element holds the result of the addition and the other term
+      e.op = OP_ADD;
+      e.res = it_next->res;
+      e.arg[0] = it_next->arg.i[0]==it->res ? it_next->arg.i[1] : it_next->arg.i[0];
+      e.arg[1] = it->res;
+      threaded_.push_back(e);
+      ++it;
+      continue;
+    }
+    threaded_.push_back(e);
+  }
+  
+  // Terminate the instruction sequence
+  ThreadedEl e_end;
+  e_end.op = TH_END;
+  e_end.res = e_end.arg[0] = e_end.arg[1] = 0;
+  threaded_.push_back(e_end);
+}
+
+void SXFunctionInternal::evaluateThreaded(){
+  double* w = getPtr(work_);
+  const double* c = getPtr(threaded_const_);
+  const ThreadedEl* pc = getPtr(threaded_);
+  
+#ifdef __GNUC__
+  // Direct dispatch with computed goto (GCC extension): each instruction jumps directly to the next one
+  // The table is indexed by the operation, in the order of the enums Operation and ThreadedOp. Operations that
+  // cannot appear in an SXFunction algorithm are skipped, as in the switch of the plain interpreter
+  static void* const table[] = {
+    &&L_OP_ASSIGN,
+    &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV,
+    &&L_OP_NEG, &&L_OP_EXP, &&L_OP_LOG, &&L_OP_POW, &&L_OP_CONSTPOW,
+    &&L_OP_SQRT, &&L_OP_SIN, &&L_OP_COS, &&L_OP_TAN,
+    &&L_OP_ASIN, &&L_OP_ACOS, &&L_OP_ATAN,
+    &&L_OP_LT, &&L_OP_LE, &&L_OP_EQ, &&L_OP_NE, &&L_OP_NOT, &&L_OP_AND, &&L_OP_OR,
+    &&L_OP_FLOOR, &&L_OP_CEIL, &&L_OP_FABS, &&L_OP_SIGN, &&L_OP_IF_ELSE_ZERO,
+    &&L_OP_ERF, &&L_OP_FMIN, &&L_OP_FMAX,
+    &&L_OP_INV,
+    &&L_OP_SINH, &&L_OP_COSH, &&L_OP_TANH,
+    &&L_OP_ASINH, &&L_OP_ACOSH, &&L_OP_ATANH,
+    &&L_OP_ATAN2,
+    &&L_OP_CONST,
+    &&L_OP_INPUT, &&L_OP_OUTPUT,
+    &&L_SKIP, // OP_PARAMETER
+    &&L_SKIP, // OP_CALL
+    &&L_SKIP, // OP_MATMUL
+    &&L_SKIP, // OP_SOLVE
+    &&L_SKIP, // OP_TRANSPOSE
+    &&L_SKIP, // OP_MAPPING
+    &&L_SKIP, // OP_DENSIFY
+    &&L_SKIP, &&L_SKIP, &&L_SKIP, &&L_SKIP, // OP_NORM2, OP_NORM1, OP_NORMINF, OP_NORMF
+    &&L_OP_ERFINV,
+    &&L_OP_PRINTME,
+    &&L_OP_LIFT,
+    &&L_TH_MUL_ADD,
+    &&L_TH_END
+  };
+#ifdef USE_CXX11
+  static_assert(sizeof(table)/sizeof(*table)==NUM_THREADED_OPS, "The dispatch table must have one entry per operation");
+#endif // USE_CXX11
+  
+#define CASADI_THREADED_NEXT(N) pc += N; goto *table[pc->op]
+  goto *table[pc->op];
+  
+#define CASADI_THREADED_CASE(OP) L_##OP: BinaryOperation<OP>::fcn(w[pc->arg[0]],w[pc->arg[1]],w[pc->res]); CASADI_THREADED_NEXT(1);
+  CASADI_THREADED_BUILTIN(CASADI_THREADED_CASE)
+#undef CASADI_THREADED_CASE
+
+ L_OP_CONST:
+  w[pc->res] = c[pc->arg[0]];
+  CASADI_THREADED_NEXT(1);
+ L_OP_INPUT:
+  w[pc->res] = inputNoCheck(pc->arg[0]).data()[pc->arg[1]];
+  CASADI_THREADED_NEXT(1);
+ L_OP_OUTPUT:
+  outputNoCheck(pc->res).data()[pc->arg[1]] = w[pc->arg[0]];
+  CASADI_THREADED_NEXT(1);
+ L_TH_MUL_ADD:
+  w[pc[0].res] = w[pc[0].arg[0]] * w[pc[0].arg[1]];
+  w[pc[1].res] = w[pc[1].arg[0]] + w[pc[1].arg[1]];
+  CASADI_THREADED_NEXT(2);
+ L_SKIP:
+  CASADI_THREADED_NEXT(1);
+ L_TH_END:
+  return;
+#undef CASADI_THREADED_NEXT
+
+#else // __GNUC__
+  // Fallback: same instruction sequence, dispatched with a switch
+  for(;; ++pc){
+    switch(pc->op){
+#define CASADI_THREADED_CASE(OP) case OP: BinaryOperation<OP>::fcn(w[pc->arg[0]],w[pc->arg[1]],w[pc->res]); break;
+      CASADI_THREADED_BUILTIN(CASADI_THREADED_CASE)
+#undef CASADI_THREADED_CASE
+      case OP_CONST: w[pc->res] = c[pc->arg[0]]; break;
+      case OP_INPUT: w[pc->res] = inputNoCheck(pc->arg[0]).data()[pc->arg[1]]; break;
+      case OP_OUTPUT: outputNoCheck(pc->res).data()[pc->arg[1]] = w[pc->arg[0]]; break;
+      case TH_MUL_ADD:
+        w[pc[0].res] = w[pc[0].arg[0]] * w[pc[0].arg[1]];
+        w[pc[1].res] = w[pc[1].arg[0]] + w[pc[1].arg[1]];
+        ++pc;
+        break;
+      case TH_END: return;
+      default: break; // Skipped, as in the plain interpreter
+    }
+  }
+#endif // __GNUC__
+}
+
+void SXFunctionInternal::evaluateBatch(int npoints, const double* const* arg, double* const* res){
+  if (!free_vars_.empty()) {
+    std::stringstream ss;
+    repr(ss);
+    casadi_error("Cannot evaluate \"" << ss.str() << "\" since variables " << free_vars_ << " are free.");
+  }
+  
+  // The points are processed in blocks so that the work vector remains small enough to stay in cache
+  const int max_block = optimized_num_dir;
+  bwork_.resize(work_.size()*std::min(npoints,max_block));
+  double* w = getPtr(bwork_);
+  
+  for(int p0=0; p0<npoints; p0+=max_block){
+    // Number of points in the block
+    const int n = std::min(max_block,npoints-p0);
+    
+    // Evaluate the algorithm, each operation for all points in the block
+    for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+      switch(it->op){
+        case OP_CONST:
+          fill_n(w + it->res*n,n,it->arg.d); break;
+        case OP_INPUT:
+        {
+          const double* a = arg[it->arg.i[0]] + it->arg.i[1]*npoints + p0;
+          copy(a,a+n,w + it->res*n);
+          break;
+        }
+        case OP_OUTPUT:
+          if(res[it->res]!=0){
+            const double* a = w + it->arg.i[0]*n;
+            copy(a,a+n,res[it->res] + it->arg.i[1]*npoints + p0);
+          }
+          break;
+        default:
+          casadi_math<double>::fun(it->op,w + it->arg.i[0]*n,w + it->arg.i[1]*n,w + it->res*n,n);
+      }
+    }
+  }
+}
+
 SXMatrix SXFunctionInternal::hess(int iind, int oind){
   casadi_assert_message(output(oind).numel() == 1, "Function must be scalar");
   SXMatrix g = grad(iind,oind);
@@ -620,6 +978,18 @@ void SXFunctionInternal::init(){
     }
   }
   
+  // Propagate multiple directions in a single sweep?
+  vectorize_directions_ = getOption("vectorize_directions");
+
+  // Compile the algorithm for the threaded interpreter
+  threaded_interpreter_ = getOption("interpreter")=="threaded";
+  if(threaded_interpreter_){
+    compileThreaded();
+  } else {
+    threaded_.clear();
+    threaded_const_.clear();
+  }
+
   // Allocate memory for directional derivatives
   SXFunctionInternal::updateNumSens(false);
   
@@ -818,6 +1188,19 @@ void SXFunctionInternal::init(){
     #endif //WITH_LLVM
   }
 
+  // Initialize just-in-time compilation using the system C compiler
+  jitFree();
+  just_in_time_c_ = getOption("just_in_time_c");
+  if(just_in_time_c_){
+    // Make sure that there are no parameters
+    if (!free_vars_.empty()) {
+      std::stringstream ss;
+      repr(ss);
+      casadi_error("Cannot just-in-time compile \"" << ss.str() << "\" since variables " << free_vars_ << " are free.");
+    }
+    jitAlloc();
+  }
+
   // Initialize just-in-time compilation for numeric evaluation using OpenCL
   just_in_time_opencl_ = getOption("just_in_time_opencl");
   if(just_in_time_opencl_){
@@ -849,6 +1232,13 @@ void SXFunctionInternal::init(){
 void SXFunctionInternal::updateNumSens(bool recursive){
   // Call the base class if needed
   if(recursive) XFunctionInternal<SXFunction,SXFunctionInternal,SXMatrix,SXNode>::updateNumSens(recursive);
+  
+  // Direction-contiguous work vector for the vectorized sensitivity sweeps
+  if(vectorize_directions_){
+    dwork_.resize(work_.size()*std::max(nfdir_,nadir_));
+  } else {
+    dwork_.clear();
+  }
 }
 
 void SXFunctionInternal::evalSX(const vector<SXMatrix>& arg, vector<SXMatrix>& res, 
@@ -1101,7 +1491,315 @@ void SXFunctionInternal::evalSX(const vector<SXMatrix>& arg, vector<SXMatrix>& r
 }
 
 SXFunctionInternal* SXFunctionInternal::clone() const{
-  return new SXFunctionInternal(*this);
+  SXFunctionInternal* ret = new SXFunctionInternal(*this);
+#ifdef WITH_DL
+  // The clone needs its own reference to the just-in-time compiled code
+  if(jit_handle_!=0){
+    ret->jit_handle_ = dlopen(jit_name_.c_str(), RTLD_NOW | RTLD_LOCAL);
+  }
+#endif // WITH_DL
+  return ret;
+}
+
+void SXFunctionInternal::generateJit(std::ostream& cfile){
+  // Create a code generator object
+  CodeGenerator gen;
+  gen.addInclude("math.h");
+  
+  // The nominal evaluation, same as for generateCode
+  generateFunction(gen.function_, "evaluate", "const d*","d*","d",gen);
+  
+  // Functions for the partial derivatives of each type of operation used in the algorithm, generated from the symbolic rules
+  vector<bool> der_added(NUM_BUILT_IN_OPS,false);
+  SXMatrix xyf = ssym("xyf",3);
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    switch(it->op){
+      case OP_CONST:
+      case OP_INPUT:
+      case OP_OUTPUT:
+      case OP_PARAMETER:
+        break;
+      default:
+        if(!der_added[it->op]){
+          der_added[it->op] = true;
+          SX d[2];
+          casadi_math<SX>::der(it->op,xyf.at(0),xyf.at(1),xyf.at(2),d);
+          vector<SX> dv(d,d+2);
+          SXFunction der_fcn(xyf,SXMatrix(dv));
+          der_fcn.init();
+          der_fcn->generateFunction(gen.function_, "der" + CodeGenerator::numToString(it->op), "const d*","d*","d",gen);
+        }
+    }
+  }
+  
+  // Flush the code generator
+  cfile.precision(std::numeric_limits<double>::digits10+2);
+  cfile << std::scientific; // This is really only to force a decimal dot, would be better if it can be avoided
+  cfile << "/* This function was automatically generated by CasADi */" << endl;
+  gen.flush(cfile);
+  
+  // Wrapper for the nominal evaluation
+  int n_i = getNumInputs();
+  int n_o = getNumOutputs();
+  cfile << "int jit_eval(const d** x, d** r){" << endl;
+  cfile << "  evaluate(";
+  for(int i=0; i<n_i+n_o; ++i){
+    if(i!=0) cfile << ",";
+    if(i<n_i){
+      cfile << "x[" << i << "]";
+    } else {
+      cfile << "r[" << (i-n_i) << "]";
+    }
+  }
+  cfile << ");" << endl;
+  cfile << "  return 0;" << endl;
+  cfile << "}" << endl << endl;
+  
+  // Nominal evaluation while recording the partial derivatives of each operation
+  cfile << "int jit_tape(const d** x, d** r, d* pd, d* w){" << endl;
+  cfile << "  d t[3];" << endl;
+  int k=0;
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    cfile << "  ";
+    switch(it->op){
+      case OP_CONST:
+        cfile << "w[" << it->res << "]=" << it->arg.d << ";"; break;
+      case OP_INPUT:
+        cfile << "w[" << it->res << "]=x[" << it->arg.i[0] << "][" << it->arg.i[1] << "];"; break;
+      case OP_OUTPUT:
+        cfile << "r[" << it->res << "][" << it->arg.i[1] << "]=w[" << it->arg.i[0] << "];"; break;
+      default:
+        cfile << "t[0]=w[" << it->arg.i[0] << "]; t[1]=w[" << it->arg.i[1] << "]; w[" << it->res << "]=";
+        casadi_math<double>::printPre(it->op,cfile);
+        cfile << "t[0]";
+        if(casadi_math<double>::ndeps(it->op)==2){
+          casadi_math<double>::printSep(it->op,cfile);
+          cfile << "t[1]";
+        }
+        casadi_math<double>::printPost(it->op,cfile);
+        cfile << "; t[2]=w[" << it->res << "]; der" << it->op << "(t,pd+" << 2*k++ << ");";
+    }
+    cfile << endl;
+  }
+  cfile << "  return 0;" << endl;
+  cfile << "}" << endl << endl;
+
+  // Forward sweep for one direction
+  cfile << "int jit_fwd(const d* pd, const d** s, d** t, d* w){" << endl;
+  k=0;
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    cfile << "  ";
+    switch(it->op){
+      case OP_CONST:
+        cfile << "w[" << it->res << "]=0;"; break;
+      case OP_INPUT:
+        cfile << "w[" << it->res << "]=s[" << it->arg.i[0] << "][" << it->arg.i[1] << "];"; break;
+      case OP_OUTPUT:
+        cfile << "t[" << it->res << "][" << it->arg.i[1] << "]=w[" << it->arg.i[0] << "];"; break;
+      default:
+        cfile << "w[" << it->res << "]=pd[" << 2*k << "]*w[" << it->arg.i[0] << "]+pd[" << 2*k+1 << "]*w[" << it->arg.i[1] << "];";
+        k++;
+    }
+    cfile << endl;
+  }
+  cfile << "  return 0;" << endl;
+  cfile << "}" << endl << endl;
+
+  // Adjoint sweep for one direction
+  cfile << "int jit_adj(const d* pd, const d** s, d** t, d* w){" << endl;
+  cfile << "  d seed;" << endl;
+  cfile << "  int i;" << endl;
+  cfile << "  for(i=0; i<" << work_.size() << "; ++i) w[i]=0;" << endl;
+  for(vector<AlgEl>::const_reverse_iterator it=algorithm_.rbegin(); it!=algorithm_.rend(); ++it){
+    cfile << "  ";
+    switch(it->op){
+      case OP_CONST:
+        cfile << "w[" << it->res << "]=0;"; break;
+      case OP_INPUT:
+        cfile << "t[" << it->arg.i[0] << "][" << it->arg.i[1] << "]=w[" << it->res << "]; w[" << it->res << "]=0;"; break;
+      case OP_OUTPUT:
+        cfile << "w[" << it->arg.i[0] << "]+=s[" << it->res << "][" << it->arg.i[1] << "];"; break;
+      default:
+        k--;
+        cfile << "seed=w[" << it->res << "]; w[" << it->res << "]=0; ";
+        cfile << "w[" << it->arg.i[0] << "]+=pd[" << 2*k << "]*seed; w[" << it->arg.i[1] << "]+=pd[" << 2*k+1 << "]*seed;";
+    }
+    cfile << endl;
+  }
+  cfile << "  return 0;" << endl;
+  cfile << "}" << endl << endl;
+}
+
+#ifdef WITH_DL
+/// Quote a path for the shell
+static string jitShellQuote(const string& s){
+  string ret = "'";
+  for(string::const_iterator c=s.begin(); c!=s.end(); ++c){
+    if(*c=='\'') ret += "'\\''";
+    else ret += *c;
+  }
+  return ret + "'";
+}
+
+/// Check that a file or directory is owned by the user and that nobody else can modify it, since its contents end up being executed
+static bool jitIsPrivate(const string& name, bool dir){
+  struct stat st;
+  if(lstat(name.c_str(),&st)!=0) return false;
+  if(dir ? !S_ISDIR(st.st_mode) : !S_ISREG(st.st_mode)) return false;
+  return st.st_uid==geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH))==0;
+}
+#endif // WITH_DL
+
+void SXFunctionInternal::jitAlloc(){
+#ifdef WITH_DL
+  // Generate the code
+  stringstream ss;
+  generateJit(ss);
+  string src = ss.str();
+  
+  // Compiler command and flags
+  string compiler = getOption("jit_compiler");
+  string flags = getOption("jit_flags");
+  
+  // Hash of the generated code and the compilation command (64-bit FNV-1a)
+  string key = src + compiler + flags;
+  unsigned long long h = 14695981039346656037ULL;
+  for(string::const_iterator c=key.begin(); c!=key.end(); ++c){
+    h ^= static_cast<unsigned char>(*c);
+    h *= 1099511628211ULL;
+  }
+  
+  // Location in the cache, by default a private directory of the user
+  string cache_dir;
+  if(hasSetOption("jit_cache_dir")){
+    cache_dir = getOption("jit_cache_dir").toString();
+  } else {
+    const char* tmpdir = getenv("TMPDIR");
+    stringstream dir;
+    dir << (tmpdir ? tmpdir : "/tmp") << "/casadi_jit_" << geteuid();
+    cache_dir = dir.str();
+    if(mkdir(cache_dir.c_str(),S_IRWXU)!=0 && errno!=EEXIST){
+      casadi_error("SXFunctionInternal::jitAlloc: Cannot create the cache directory " << cache_dir);
+    }
+  }
+  casadi_assert_message(jitIsPrivate(cache_dir,true), "SXFunctionInternal::jitAlloc: The cache directory " << cache_dir << 
+                        " must be a directory owned by the user and not writable by the group or others");
+  stringstream base;
+  base << cache_dir << "/casadi_jit_" << hex << h;
+  jit_name_ = base.str() + ".so";
+
+  // Compile, unless the shared object is already in the cache
+  if(access(jit_name_.c_str(), F_OK)!=0){
+    // Unique names for the temporary files, so that neither threads nor processes compiling the same code collide
+    string src_name = base.str() + "_XXXXXX.c";
+    int src_fd = mkstemps(&src_name[0],2);
+    casadi_assert_message(src_fd>=0, "SXFunctionInternal::jitAlloc: Cannot create a temporary file in " << cache_dir);
+    string so_name = base.str() + "_XXXXXX.so";
+    int so_fd = mkstemps(&so_name[0],3);
+    if(so_fd<0){
+      close(src_fd);
+      remove(src_name.c_str());
+      casadi_error("SXFunctionInternal::jitAlloc: Cannot create a temporary file in " << cache_dir);
+    }
+    close(so_fd);
+    
+    // Write the source
+    FILE* cfile = fdopen(src_fd,"w");
+    bool written = cfile!=0 && fwrite(src.data(),1,src.size(),cfile)==src.size();
+    if(cfile!=0) written = fclose(cfile)==0 && written;
+    else close(src_fd);
+    
+    // Compile, the compiler and the flags are passed to the shell as given, the file names are quoted
+    string cmd = compiler + " " + flags + " -fPIC -shared " + jitShellQuote(src_name) + " -o " + jitShellQuote(so_name) + " -lm";
+    if(verbose()){
+      cout << "SXFunctionInternal::jitAlloc: compiling with \"" << cmd << "\"" << endl;
+    }
+    int flag = written ? system(cmd.c_str()) : -1;
+    remove(src_name.c_str());
+    if(flag!=0){
+      remove(so_name.c_str());
+      casadi_assert_message(written, "SXFunctionInternal::jitAlloc: Cannot write " << src_name);
+      casadi_error("SXFunctionInternal::jitAlloc: Compilation failed: \"" << cmd << "\"");
+    }
+    
+    // The linker creates the file with the permissions of the umask
+    chmod(so_name.c_str(),S_IRWXU);
+    
+    // Publish in the cache, the rename is atomic so that concurrent compilations never see a partially written file
+    flag = rename(so_name.c_str(),jit_name_.c_str());
+    if(flag!=0){
+      remove(so_name.c_str());
+      casadi_error("SXFunctionInternal::jitAlloc: Cannot move " << so_name << " to " << jit_name_);
+    }
+  } else if(verbose()){
+    cout << "SXFunctionInternal::jitAlloc: loading " << jit_name_ << " from the cache" << endl;
+  }
+  
+  // Never load a file that someone else could have planted or modified
+  casadi_assert_message(jitIsPrivate(jit_name_,false), "SXFunctionInternal::jitAlloc: " << jit_name_ << 
+                        " must be a regular file owned by the user and not writable by the group or others");
+  
+  // Load the shared object
+  jit_handle_ = dlopen(jit_name_.c_str(), RTLD_NOW | RTLD_LOCAL);
+  casadi_assert_message(jit_handle_!=0, "SXFunctionInternal::jitAlloc: Cannot open " << jit_name_ << ": " << dlerror());
+
+  // Get the functions
+  jit_eval_ = (jitEvalFcn)dlsym(jit_handle_, "jit_eval");
+  jit_tape_ = (jitTapeFcn)dlsym(jit_handle_, "jit_tape");
+  jit_fwd_ = (jitSweepFcn)dlsym(jit_handle_, "jit_fwd");
+  jit_adj_ = (jitSweepFcn)dlsym(jit_handle_, "jit_adj");
+  casadi_assert_message(jit_eval_!=0 && jit_tape_!=0 && jit_fwd_!=0 && jit_adj_!=0, "SXFunctionInternal::jitAlloc: Missing symbols in " << jit_name_);
+  
+  // Allocate pointers to arguments and results
+  jit_arg_.resize(std::max(getNumInputs(),getNumOutputs()));
+  jit_res_.resize(jit_arg_.size());
+#else // WITH_DL
+  casadi_error("Option \"just_in_time_c\" true requires CasADi to have been compiled with WITH_DL=ON");
+#endif // WITH_DL
+}
+
+void SXFunctionInternal::jitFree(){
+#ifdef WITH_DL
+  if(jit_handle_!=0){
+    dlclose(jit_handle_);
+    jit_handle_ = 0;
+  }
+#endif // WITH_DL
+}
+
+void SXFunctionInternal::evaluateJit(int nfdir, int nadir){
+#ifdef WITH_DL
+  const int n_i = getNumInputs();
+  const int n_o = getNumOutputs();
+  
+  // Pass inputs and outputs
+  for(int ind=0; ind<n_i; ++ind) jit_arg_[ind] = getPtr(inputNoCheck(ind).data());
+  for(int ind=0; ind<n_o; ++ind) jit_res_[ind] = getPtr(outputNoCheck(ind).data());
+
+  // Nominal evaluation only
+  if(nfdir==0 && nadir==0){
+    jit_eval_(getPtr(jit_arg_),getPtr(jit_res_));
+    return;
+  }
+  
+  // Evaluate and record the partial derivatives
+  double* pd = pdwork_.empty() ? 0 : pdwork_.front().d;
+  jit_tape_(getPtr(jit_arg_),getPtr(jit_res_),pd,getPtr(work_));
+  
+  // Forward sweeps
+  for(int dir=0; dir<nfdir; ++dir){
+    for(int ind=0; ind<n_i; ++ind) jit_arg_[ind] = getPtr(fwdSeedNoCheck(ind,dir).data());
+    for(int ind=0; ind<n_o; ++ind) jit_res_[ind] = getPtr(fwdSensNoCheck(ind,dir).data());
+    jit_fwd_(pd,getPtr(jit_arg_),getPtr(jit_res_),getPtr(work_));
+  }
+  
+  // Adjoint sweeps
+  for(int dir=0; dir<nadir; ++dir){
+    for(int ind=0; ind<n_o; ++ind) jit_arg_[ind] = getPtr(adjSeedNoCheck(ind,dir).data());
+    for(int ind=0; ind<n_i; ++ind) jit_res_[ind] = getPtr(adjSensNoCheck(ind,dir).data());
+    jit_adj_(pd,getPtr(jit_arg_),getPtr(jit_res_),getPtr(work_));
+  }
+#endif // WITH_DL
 }
 
 
@@ -1677,5 +2375,105 @@ void SXFunctionInternal::executeKernel(cl_kernel kernel){
 
 
 
+bool SXFunctionInternal::structuralHash(std::size_t& seed) const{
+  // Input and output sparsity
+  for(int i=0; i<getNumInputs(); ++i) hash_combine(seed,int(input(i).sparsity().hash()));
+  for(int i=0; i<getNumOutputs(); ++i) hash_combine(seed,int(output(i).sparsity().hash()));
+  
+  // Free variables cannot be hashed
+  if(!free_vars_.empty()) return false;
+
+  // The algorithm, the integer pair overlaps the value of the constants
+  for(vector<AlgEl>::const_iterator it=algorithm_.begin(); it!=algorithm_.end(); ++it){
+    hash_combine(seed,it->op);
+    hash_combine(seed,it->res);
+    hash_combine(seed,it->arg.i[0]);
+    hash_combine(seed,it->arg.i[1]);
+  }
+  return true;
+}
+
+void SXFunctionInternal::serialize(std::ostream& stream) const{
+  casadi_assert_message(isInit(), "SXFunctionInternal::serialize: Function not initialized");
+  casadi_assert_message(free_vars_.empty(), "SXFunctionInternal::serialize: Cannot save a function with free variables " << free_vars_);
+  
+  // Type and name
+  writeBinary(stream,string("SXFunction"));
+  writeBinary(stream,getOption("name").toString());
+  
+  // Input and output sparsity
+  writeBinary(stream,getNumInputs());
+  for(int ind=0; ind<getNumInputs(); ++ind) writeBinary(stream,input(ind).sparsity());
+  writeBinary(stream,getNumOutputs());
+  for(int ind=0; ind<getNumOutputs(); ++ind) writeBinary(stream,output(ind).sparsity());
+  
+  // The algorithm, as a single block in the same layout as in memory
+  writeBinary(stream,int(work_.size()));
+  writeBinary(stream,algorithm_);
+}
+
+SXFunction SXFunctionInternal::deserialize(std::istream& stream){
+  // Name
+  string name;
+  readBinary(stream,name);
+  
+  // Symbolic inputs
+  int n_in=-1;
+  readBinary(stream,n_in);
+  casadi_assert_message(stream.good() && n_in>=0, "SXFunctionInternal::deserialize: Corrupt data");
+  vector<SXMatrix> arg(n_in);
+  for(int ind=0; ind<n_in; ++ind){
+    CRSSparsity sp;
+    readBinary(stream,sp);
+    stringstream ss;
+    ss << "x_" << ind;
+    arg[ind] = ssym(ss.str(),sp);
+  }
+  
+  // Outputs
+  int n_out=-1;
+  readBinary(stream,n_out);
+  casadi_assert_message(stream.good() && n_out>=0, "SXFunctionInternal::deserialize: Corrupt data");
+  vector<SXMatrix> res(n_out);
+  for(int ind=0; ind<n_out; ++ind){
+    CRSSparsity sp;
+    readBinary(stream,sp);
+    res[ind] = SXMatrix(sp);
+  }
+  
+  // The algorithm
+  int worksize=-1;
+  readBinary(stream,worksize);
+  vector<AlgEl> algorithm;
+  readBinary(stream,algorithm);
+  casadi_assert_message(stream.good() && worksize>=0, "SXFunctionInternal::deserialize: Corrupt data");
+
+  // Replay the algorithm symbolically to recover the expression graph
+  vector<SX> w(worksize);
+  for(vector<AlgEl>::const_iterator it=algorithm.begin(); it!=algorithm.end(); ++it){
+    switch(it->op){
+      case OP_CONST:
+        w.at(it->res) = it->arg.d;
+        break;
+      case OP_INPUT:
+        w.at(it->res) = arg.at(it->arg.i[0]).at(it->arg.i[1]);
+        break;
+      case OP_OUTPUT:
+        res.at(it->res).at(it->arg.i[1]) = w.at(it->arg.i[0]);
+        break;
+      default:
+        casadi_assert_message(it->op>=0 && it->op<NUM_BUILT_IN_OPS && it->op!=OP_PARAMETER, "SXFunctionInternal::deserialize: Corrupt data");
+        SX f;
+        casadi_math<SX>::fun(it->op,w.at(it->arg.i[0]),w.at(it->arg.i[1]),f);
+        w.at(it->res) = f;
+    }
+  }
+
+  // Create the function
+  SXFunction ret(arg,res);
+  ret.setOption("name",name);
+  return ret;
+}
+
 } // namespace CasADi
 
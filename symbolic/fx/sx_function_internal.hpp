@@ -114,6 +114,21 @@ class SXFunctionInternal : public XFunctionInternal<SXFunction,SXFunctionInterna
   template<typename T1, typename T2>
   void evaluateGen(T1 nfdir_c, T2 nadir_c);
   
+  /** \brief  Propagate all forward and adjoint directions in a single sweep each, both arguments generic */
+  template<typename T1, typename T2>
+  void evaluateDirGen(T1 nfdir_c, T2 nadir_c);
+  
+  /** \brief  Compile the algorithm into the instruction sequence of the threaded interpreter */
+  void compileThreaded();
+  
+  /** \brief  Evaluate numerically (no derivatives) using the threaded interpreter */
+  void evaluateThreaded();
+  
+  /** \brief  Evaluate numerically at multiple points in a single sweep over the algorithm
+      Structure-of-arrays layout: nonzero k of input i at point p is found in arg[i][k*npoints+p], same for the outputs.
+      Outputs with a null pointer are not calculated. */
+  void evaluateBatch(int npoints, const double* const* arg, double* const* res);
+  
   /** \brief  evaluate symbolically while also propagating directional derivatives */
   virtual void evalSX(const std::vector<SXMatrix>& arg, std::vector<SXMatrix>& res, 
                       const std::vector<std::vector<SXMatrix> >& fseed, std::vector<std::vector<SXMatrix> >& fsens, 
@@ -143,10 +158,46 @@ class SXFunctionInternal : public XFunctionInternal<SXFunction,SXFunctionInterna
   /** \brief  all binary nodes of the tree in the order of execution */
   std::vector<AlgEl> algorithm_;
 
+  /** \brief  An instruction of the threaded interpreter, all operands are 32-bit integers */
+  struct ThreadedEl{
+    /// Built-in operation or superinstruction
+    int op;
+    
+    /// Output argument
+    int res;
+    
+    /// Input arguments (for constants: the location in the constant pool)
+    int arg[2];
+  };
+  
+  /** \brief  Instructions of the threaded interpreter, in addition to the built-in operations */
+  enum ThreadedOp{
+    /// Multiplication followed by an addition using its result, the next element holds the addition
+    TH_MUL_ADD = NUM_BUILT_IN_OPS,
+    
+    /// End of the instruction sequence
+    TH_END,
+    
+    /// Number of instructions
+    NUM_THREADED_OPS
+  };
+  
+  /** \brief  Instruction sequence for the threaded interpreter */
+  std::vector<ThreadedEl> threaded_;
+  
+  /** \brief  Constant pool for the threaded interpreter */
+  std::vector<double> threaded_const_;
+
   /** \brief  Working vector for numeric calculation */
   std::vector<double> work_;
   std::vector<TapeEl<double> > pdwork_;
 
+  /** \brief  Work vector for the directional derivatives, the directions of each element are stored contiguously */
+  std::vector<double> dwork_;
+
+  /** \brief  Work vector for the batched evaluation, the points of each element are stored contiguously */
+  std::vector<double> bwork_;
+
   /// work vector for symbolic calculations (allocated first time)
   std::vector<SX> s_work_;
   std::vector<SX> free_vars_;
@@ -178,12 +229,27 @@ class SXFunctionInternal : public XFunctionInternal<SXFunction,SXFunctionInterna
   /// Is the class able to propate seeds through the algorithm?
   virtual bool spCanEvaluate(bool fwd){ return true;}
 
+  /** \brief Combine a hash of the structure of the function into seed */
+  virtual bool structuralHash(std::size_t& seed) const;
+
+  /** \brief Write the function to a binary stream */
+  virtual void serialize(std::ostream& stream) const;
+
+  /** \brief Read a function written by serialize (after the type tag) */
+  static SXFunction deserialize(std::istream& stream);
+
   /// Reset the sparsity propagation
   virtual void spInit(bool fwd);
   
   /// Get jacobian of all nonzero outputs with respect to all nonzero inputs
   virtual FX getFullJacobian();
 
+  /// Propagate all directions in a single sweep over the algorithm
+  bool vectorize_directions_;
+
+  /// Use the threaded interpreter for numerical evaluation without derivatives
+  bool threaded_interpreter_;
+
   /// With just-in-time compilation
   bool just_in_time_;
 
@@ -193,6 +259,43 @@ class SXFunctionInternal : public XFunctionInternal<SXFunction,SXFunctionInterna
   /// With just-in-time compilation for the sparsity propagation
   bool just_in_time_sparsity_;
   
+  /// With just-in-time compilation using the system C compiler
+  bool just_in_time_c_;
+  
+  /// Generate the C code for just-in-time compilation with the system C compiler
+  void generateJit(std::ostream& cfile);
+
+  /// Compile, or load from the cache, the just-in-time compiled code
+  void jitAlloc();
+
+  /// Unload the just-in-time compiled code
+  void jitFree();
+
+  /// Evaluate using the just-in-time compiled code
+  void evaluateJit(int nfdir, int nadir);
+
+#ifdef WITH_DL
+  /// Handle to the loaded shared object
+  void* jit_handle_;
+  
+  /// File name of the shared object
+  std::string jit_name_;
+  
+  // Function pointer types of the just-in-time compiled functions
+  typedef int (*jitEvalFcn)(const double**,double**);
+  typedef int (*jitTapeFcn)(const double**,double**,double*,double*);
+  typedef int (*jitSweepFcn)(const double*,const double**,double**,double*);
+  
+  // Just-in-time compiled functions for the nominal evaluation, the taping and the forward and adjoint sweeps
+  jitEvalFcn jit_eval_;
+  jitTapeFcn jit_tape_;
+  jitSweepFcn jit_fwd_, jit_adj_;
+
+  // Pointers to the arguments and results of the just-in-time compiled functions
+  std::vector<const double*> jit_arg_;
+  std::vector<double*> jit_res_;
+#endif // WITH_DL
+
 #ifdef WITH_LLVM
   llvm::Module *jit_module_;
   llvm::Function *jit_function_;
@@ -0,0 +1,116 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "thread_pool.hpp"
+
+#ifdef WITH_THREADS
+#include "../casadi_exception.hpp"
+#include <atomic>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif // __linux__
+
+using namespace std;
+
+namespace CasADi{
+
+ThreadPool::ThreadPool(int nthreads, bool pin) : generation_(0), running_(0), stop_(false){
+  casadi_assert_message(nthreads>0, "ThreadPool: the number of threads must be positive");
+  int ncores = thread::hardware_concurrency();
+  
+  // Pinned pools continue where the previous one ended, so that the threads of several pools are spread over the cores
+  static atomic<int> next_core(0);
+  int first_core = pin ? next_core.fetch_add(nthreads) : 0;
+  
+  threads_.reserve(nthreads);
+  for(int i=0; i<nthreads; ++i){
+    threads_.push_back(thread(&ThreadPool::work,this,i));
+    
+    // Pin to a core
+    #ifdef __linux__
+    if(pin && ncores>0){
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET((first_core + i) % ncores, &cpuset);
+      pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+    }
+    #endif // __linux__
+  }
+}
+
+ThreadPool::~ThreadPool(){
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for(vector<thread>::iterator it=threads_.begin(); it!=threads_.end(); ++it){
+    it->join();
+  }
+}
+
+void ThreadPool::run(const function<void(int)>& job){
+  unique_lock<mutex> lock(mutex_);
+  job_ = job;
+  error_.clear();
+  running_ = threads_.size();
+  generation_++;
+  start_.notify_all();
+  
+  // Wait for all the workers to finish
+  while(running_>0) done_.wait(lock);
+  job_ = function<void(int)>();
+  
+  if(!error_.empty()){
+    throw CasadiException(error_);
+  }
+}
+
+void ThreadPool::work(int thread){
+  unsigned long generation = 0;
+  unique_lock<mutex> lock(mutex_);
+  while(true){
+    // Wait for a new job
+    while(!stop_ && generation_==generation) start_.wait(lock);
+    if(stop_) return;
+    generation = generation_;
+    
+    // Execute it without holding the lock
+    lock.unlock();
+    string error;
+    try{
+      job_(thread);
+    } catch(exception& ex){
+      error = ex.what();
+    }
+    lock.lock();
+    
+    // Report completion
+    if(!error.empty() && error_.empty()) error_ = error;
+    if(--running_==0) done_.notify_all();
+  }
+}
+
+} // namespace CasADi
+
+#endif // WITH_THREADS
@@ -0,0 +1,95 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010 by Joel Andersson, Moritz Diehl, K.U.Leuven. All rights reserved.
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#ifdef WITH_THREADS
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace CasADi{
+
+  /** \brief A persistent pool of worker threads
+      The workers are created once and sleep between jobs. A job is a function that is called once
+      on every worker with the index of the worker, in the style of an OpenMP parallel region.
+      \author Joel Andersson 
+      \date 2013
+  */
+  class ThreadPool{
+  public:
+    /** \brief Create a pool with nthreads workers, optionally pinned to one core each
+        The cores are assigned round robin over all pinned pools of the process */
+    ThreadPool(int nthreads, bool pin);
+    
+    /** \brief Stop and join the workers */
+    ~ThreadPool();
+    
+    /** \brief Number of workers */
+    int size() const{ return threads_.size();}
+    
+    /** \brief Call job(thread) on all workers and wait until all have returned
+        An exception thrown by a worker is rethrown as a CasadiException in the calling thread.
+    */
+    void run(const std::function<void(int)>& job);
+    
+  private:
+    /// Not copyable
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+    
+    /// Main loop of a worker
+    void work(int thread);
+    
+    /// Workers
+    std::vector<std::thread> threads_;
+    
+    /// Protects the members below
+    std::mutex mutex_;
+    
+    /// Signals a new job or shutdown to the workers, and the completion of a job to the caller
+    std::condition_variable start_, done_;
+    
+    /// Current job
+    std::function<void(int)> job_;
+    
+    /// Counter identifying the current job
+    unsigned long generation_;
+    
+    /// Number of workers still executing the current job
+    int running_;
+    
+    /// Shut down the workers
+    bool stop_;
+    
+    /// First error message of the current job
+    std::string error_;
+  };
+
+} // namespace CasADi
+
+#endif // WITH_THREADS
+#endif // THREAD_POOL_HPP
@@ -424,11 +424,19 @@ namespace CasADi{
     (*this)->getNZInplace(indices);
   }
 
-  CRSSparsity CRSSparsity::unidirectionalColoring(const CRSSparsity& AT, int cutoff) const{
+  CRSSparsity CRSSparsity::unidirectionalColoring(const CRSSparsity& AT, int cutoff, int ordering) const{
     if(AT.isNull()){
-      return (*this)->unidirectionalColoring(transpose(),cutoff);
+      return (*this)->unidirectionalColoring(transpose(),cutoff,ordering);
     } else {
-      return (*this)->unidirectionalColoring(AT,cutoff);
+      return (*this)->unidirectionalColoring(AT,cutoff,ordering);
+    }
+  }
+
+  CRSSparsity CRSSparsity::parallelUnidirectionalColoring(const CRSSparsity& AT, int cutoff, int ordering) const{
+    if(AT.isNull()){
+      return (*this)->parallelUnidirectionalColoring(transpose(),cutoff,ordering);
+    } else {
+      return (*this)->parallelUnidirectionalColoring(AT,cutoff,ordering);
     }
   }
 
@@ -436,10 +444,22 @@ namespace CasADi{
     return (*this)->starColoring(ordering,cutoff);
   }
 
+  CRSSparsity CRSSparsity::parallelStarColoring(int ordering, int cutoff) const{
+    return (*this)->parallelStarColoring(ordering,cutoff);
+  }
+
   std::vector<int> CRSSparsity::largestFirstOrdering() const{
     return (*this)->largestFirstOrdering();
   }
 
+  std::vector<int> CRSSparsity::smallestLastOrdering() const{
+    return (*this)->smallestLastOrdering();
+  }
+
+  std::vector<int> CRSSparsity::incidenceDegreeOrdering() const{
+    return (*this)->incidenceDegreeOrdering();
+  }
+
   CRSSparsity CRSSparsity::pmult(const std::vector<int>& p, bool permute_rows, bool permute_columns, bool invert_permutation) const{
     return (*this)->pmult(p,permute_rows,permute_columns,invert_permutation);
   }
@@ -475,6 +495,9 @@ namespace CasADi{
       return;
     }
     
+    // Only one thread at a time may access the cache
+    CASADI_CACHE_LOCK(cache_mutex_);
+
     // Record the current number of buckets (for garbage collection below)
 #ifdef USE_CXX11
     int bucket_count_before = cached_.bucket_count();
@@ -494,11 +517,11 @@ namespace CasADi{
 	// Get a weak reference to the cached sparsity pattern
 	WeakRef& wref = i->second;
       
+	// Get an owning reference to the cached pattern, null if it no longer exists
+	CRSSparsity ref = shared_cast<CRSSparsity>(wref.shared());
+      
 	// Check if the pattern still exists
-	if(wref.alive()){
-	
-	  // Get an owning reference to the cached pattern
-	  CRSSparsity ref = shared_cast<CRSSparsity>(wref.shared());
+	if(!ref.isNull()){
 	
 	  // Check if the pattern matches
 	  if(ref.isEqual(nrow,ncol,col,rowind)){
@@ -533,10 +556,9 @@ namespace CasADi{
 	  CachingMap::iterator j=i;
 	  j++; // Start at the next matching key
 	  for(; j!=eq.second; ++j){
-	    if(j->second.alive()){
-	    
-	      // Recover cached sparsity
-	      CRSSparsity ref = shared_cast<CRSSparsity>(j->second.shared());
+	    // Recover cached sparsity
+	    CRSSparsity ref = shared_cast<CRSSparsity>(j->second.shared());
+	    if(!ref.isNull()){
 	    
 	      // Match found if sparsity matches
 	      if(ref.isEqual(nrow,ncol,col,rowind)){
@@ -587,9 +609,13 @@ namespace CasADi{
 #endif // USE_CXX11    
   }
 
+#ifdef WITH_THREADSAFE_SYMBOLICS
+  std::mutex CRSSparsity::cache_mutex_;
+#endif // WITH_THREADSAFE_SYMBOLICS
   CRSSparsity::CachingMap CRSSparsity::cached_;
 
   void CRSSparsity::clearCache(){
+    CASADI_CACHE_LOCK(cache_mutex_);
     cached_.clear();
   }
 
@@ -94,6 +94,11 @@ namespace CasADi{
     typedef CACHING_MULTIMAP<std::size_t,WeakRef> CachingMap;
     static CachingMap cached_;
 
+#ifdef WITH_THREADSAFE_SYMBOLICS
+    /// Protects cached_
+    static std::mutex cache_mutex_;
+#endif // WITH_THREADSAFE_SYMBOLICS
+
   public:
   
     /// Default constructor
@@ -396,17 +401,38 @@ namespace CasADi{
     /// Get the location of all nonzero elements (inplace version)
     void getElements(std::vector<int>& loc, bool row_major=true) const;
     
-    /** \brief Perform a unidirectional coloring: A greedy distance-2 coloring algorithm (Algorithm 3.1 in A. H. GEBREMEDHIN, F. MANNE, A. POTHEN) */
-    CRSSparsity unidirectionalColoring(const CRSSparsity& AT=CRSSparsity(), int cutoff = std::numeric_limits<int>::max()) const;
+    /** \brief Perform a unidirectional coloring: A greedy distance-2 coloring algorithm (Algorithm 3.1 in A. H. GEBREMEDHIN, F. MANNE, A. POTHEN)
+	Ordering options: None (0), largest first (1), smallest last (2), incidence degree (3), applied to the graph of the rows sharing a column
+    */
+    CRSSparsity unidirectionalColoring(const CRSSparsity& AT=CRSSparsity(), int cutoff = std::numeric_limits<int>::max(), int ordering = 0) const;
+
+    /** \brief Perform a unidirectional coloring in parallel:
+	Speculative coloring with conflict resolution, the rows are colored concurrently (OpenMP) and conflicting rows 
+	are recolored in the next round. Without OpenMP, the result is the same as unidirectionalColoring.
+	Ordering options: see unidirectionalColoring
+    */
+    CRSSparsity parallelUnidirectionalColoring(const CRSSparsity& AT=CRSSparsity(), int cutoff = std::numeric_limits<int>::max(), int ordering = 0) const;
 
     /** \brief Perform a star coloring of a symmetric matrix:
 	A greedy distance-2 coloring algorithm (Algorithm 4.1 in A. H. GEBREMEDHIN, F. MANNE, A. POTHEN) 
-	Ordering options: None (0), largest first (1)
+	Ordering options: None (0), largest first (1), smallest last (2), incidence degree (3)
     */
     CRSSparsity starColoring(int ordering = 1, int cutoff = std::numeric_limits<int>::max()) const;
     
+    /** \brief Perform a star coloring of a symmetric matrix in parallel:
+	Speculative coloring with conflict resolution, see parallelUnidirectionalColoring.
+	Ordering options: None (0), largest first (1), smallest last (2), incidence degree (3)
+    */
+    CRSSparsity parallelStarColoring(int ordering = 1, int cutoff = std::numeric_limits<int>::max()) const;
+    
     /** \brief Order the rows by decreasing degree */
     std::vector<int> largestFirstOrdering() const;
+
+    /** \brief Order the rows by repeatedly removing a row of smallest degree, the row removed last comes first */
+    std::vector<int> smallestLastOrdering() const;
+
+    /** \brief Order the rows by repeatedly choosing a row with the largest number of neighbors already ordered */
+    std::vector<int> incidenceDegreeOrdering() const;
     
     /** \brief Permute rows and/or columns
 	Multiply the sparsity with a permutation matrix from the left and/or from the right
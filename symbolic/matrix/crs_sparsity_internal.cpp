@@ -2764,7 +2764,88 @@ namespace CasADi{
     fill(it,indices.end(),-1);
   }
 
-  CRSSparsity CRSSparsityInternal::unidirectionalColoring(const CRSSparsity& AT, int cutoff) const{
+  /// Mark color c as forbidden for vertex i, growing the marker vector if needed
+  static inline void markColor(vector<int>& marker, int c, int i){
+    if(c>=marker.size()) marker.resize(c+1,-1);
+    marker[c] = i;
+  }
+
+  /// Is color c marked for vertex i
+  static inline bool isMarked(const vector<int>& marker, int c, int i){
+    return c<marker.size() && marker[c]==i;
+  }
+
+  /// Read the color of a vertex which may be written concurrently by another thread
+  static inline int loadColor(const vector<int>& color, int i){
+    const int* p = &color[i];
+    int c;
+    #pragma omp atomic read
+    c = *p;
+    return c;
+  }
+
+  /// Set the color of a vertex which may be read concurrently by another thread
+  static inline void storeColor(vector<int>& color, int i, int c){
+    int* p = &color[i];
+    #pragma omp atomic write
+    *p = c;
+  }
+
+  /// Add the vertex with the largest index among the vertices of a conflict that are colored in the current round to the (thread local) conflict list
+  static void markConflict(const int* v, int n, const vector<char>& in_round, vector<int>& conflicts){
+    int v_max = -1;
+    for(int k=0; k<n; ++k){
+      if(in_round[v[k]]) v_max = max(v_max,v[k]);
+    }
+    if(v_max>=0) conflicts.push_back(v_max);
+  }
+
+  /// Renumber the colors consecutively, returns the number of colors
+  static int compressColors(vector<int>& color){
+    vector<int> new_color;
+    int num_colors = 0;
+    for(vector<int>::iterator it=color.begin(); it!=color.end(); ++it){
+      if(*it>=new_color.size()) new_color.resize(*it+1,-1);
+      if(new_color[*it]<0) new_color[*it] = num_colors++;
+      *it = new_color[*it];
+    }
+    return num_colors;
+  }
+
+  /// Insert a vertex into a bucket (doubly linked list)
+  static inline void bucketInsert(int v, int b, vector<int>& head, vector<int>& next, vector<int>& prev){
+    prev[v] = -1;
+    next[v] = head[b];
+    if(head[b]>=0) prev[head[b]] = v;
+    head[b] = v;
+  }
+
+  /// Remove a vertex from a bucket
+  static inline void bucketRemove(int v, int b, vector<int>& head, vector<int>& next, vector<int>& prev){
+    if(prev[v]>=0){
+      next[prev[v]] = next[v];
+    } else {
+      head[b] = next[v];
+    }
+    if(next[v]>=0) prev[next[v]] = prev[v];
+  }
+
+  CRSSparsity CRSSparsityInternal::unidirectionalColoring(const CRSSparsity& AT, int cutoff, int ordering) const{
+    // Reorder, if necessary
+    if(ordering!=0){
+      // Ordering of the rows, from the graph of rows sharing a column
+      vector<int> ord = patternProduct(shared_from_this<CRSSparsity>())->vertexOrdering(ordering);
+
+      // Create a new sparsity pattern with the rows permuted
+      CRSSparsity sp_permuted = pmult(ord,true,false,true);
+    
+      // Coloring for the permuted matrix
+      CRSSparsity ret_permuted = sp_permuted.unidirectionalColoring(sp_permuted.transpose(),cutoff,0);
+      if(ret_permuted.isNull()) return ret_permuted;
+        
+      // Permute result back
+      return ret_permuted.pmult(ord,false,true,false);
+    }
   
     // Allocate temporary vectors
     vector<int> forbiddenColors;
@@ -2855,16 +2936,15 @@ namespace CasADi{
   CRSSparsity CRSSparsityInternal::starColoring(int ordering, int cutoff) const{
     // Reorder, if necessary
     if(ordering!=0){
-      casadi_assert(ordering==1);
-    
       // Ordering
-      vector<int> ord = largestFirstOrdering();
+      vector<int> ord = vertexOrdering(ordering);
 
       // Create a new sparsity pattern 
       CRSSparsity sp_permuted = pmult(ord,true,true,true);
     
       // Star coloring for the permuted matrix
-      CRSSparsity ret_permuted = sp_permuted.starColoring(0);
+      CRSSparsity ret_permuted = sp_permuted.starColoring(0,cutoff);
+      if(ret_permuted.isNull()) return ret_permuted;
         
       // Permute result back
       return ret_permuted.pmult(ord,false,true,false);
@@ -2958,6 +3038,266 @@ namespace CasADi{
     return sp_triplet(num_colors,nrow_,color,range(color.size()));
   }
 
+  CRSSparsity CRSSparsityInternal::parallelUnidirectionalColoring(const CRSSparsity& AT, int cutoff, int ordering) const{
+    // Reorder, if necessary
+    if(ordering!=0){
+      vector<int> ord = patternProduct(shared_from_this<CRSSparsity>())->vertexOrdering(ordering);
+      CRSSparsity sp_permuted = pmult(ord,true,false,true);
+      CRSSparsity ret_permuted = sp_permuted.parallelUnidirectionalColoring(sp_permuted.transpose(),cutoff,0);
+      if(ret_permuted.isNull()) return ret_permuted;
+      return ret_permuted.pmult(ord,false,true,false);
+    }
+    
+    // Access the sparsity of the transpose
+    const vector<int>& AT_rowind = AT.rowind();
+    const vector<int>& AT_col = AT.col();
+    
+    // Color of each row, -1 if not colored
+    vector<int> color(nrow_,-1);
+    
+    // Rows to be colored in the current round, all rows to start with
+    vector<int> round = range(nrow_);
+    vector<char> recolor(nrow_,0);
+    while(!round.empty()){
+      int nround = round.size();
+      
+      // Tentative coloring, the rows of the round may see each other uncolored, hence the atomic access to the colors
+      #pragma omp parallel
+      {
+        vector<int> forbiddenColors;
+        #pragma omp for schedule(dynamic,64)
+        for(int k=0; k<nround; ++k){
+          int i = round[k];
+          
+          // Forbid the colors of all colored rows with an element in the same column
+          for(int el=rowind_[i]; el<rowind_[i+1]; ++el){
+            int c = col_[el];
+            for(int el_other=AT_rowind[c]; el_other<AT_rowind[c+1]; ++el_other){
+              int i_other = AT_col[el_other];
+              if(i_other==i) continue;
+              int color_other = loadColor(color,i_other);
+              if(color_other>=0) markColor(forbiddenColors,color_other,i);
+            }
+          }
+          
+          // Get the first nonforbidden color
+          int color_i = 0;
+          while(isMarked(forbiddenColors,color_i,i)) color_i++;
+          storeColor(color,i,color_i);
+        }
+      }
+      
+      // Detect conflicts: the row with the larger index is recolored, each row only sets its own flag
+      #pragma omp parallel for
+      for(int k=0; k<nround; ++k){
+        int i = round[k];
+        bool conflict = false;
+        for(int el=rowind_[i]; el<rowind_[i+1] && !conflict; ++el){
+          int c = col_[el];
+          for(int el_other=AT_rowind[c]; el_other<AT_rowind[c+1] && !conflict; ++el_other){
+            int i_other = AT_col[el_other];
+            conflict = i_other<i && color[i_other]==color[i];
+          }
+        }
+        recolor[i] = conflict;
+      }
+      
+      // Rows to be colored in the next round
+      int num_colors = 0;
+      vector<int> next_round;
+      for(int k=0; k<nround; ++k){
+        int i = round[k];
+        if(recolor[i]){
+          next_round.push_back(i);
+        } else {
+          num_colors = max(num_colors,color[i]+1);
+        }
+      }
+      for(vector<int>::const_iterator it=next_round.begin(); it!=next_round.end(); ++it){
+        color[*it] = -1;
+        recolor[*it] = 0;
+      }
+      round.swap(next_round);
+      
+      // Cutoff if too many colors
+      if(num_colors>cutoff) return CRSSparsity();
+    }
+
+    // Number of colors used
+    int num_colors = compressColors(color);
+    if(num_colors>cutoff) return CRSSparsity();
+
+    // Return sparsity in sparse triplet format
+    return sp_triplet(num_colors,nrow_,color,range(color.size()));
+  }
+
+  CRSSparsity CRSSparsityInternal::parallelStarColoring(int ordering, int cutoff) const{
+    // Reorder, if necessary
+    if(ordering!=0){
+      vector<int> ord = vertexOrdering(ordering);
+      CRSSparsity ret_permuted = pmult(ord,true,true,true).parallelStarColoring(0,cutoff);
+      if(ret_permuted.isNull()) return ret_permuted;
+      return ret_permuted.pmult(ord,false,true,false);
+    }
+    
+    // Color of each vertex, -1 if not colored
+    vector<int> color(nrow_,-1);
+    
+    // Vertices to be colored in the current round, all vertices to start with
+    vector<int> round = range(nrow_);
+    vector<char> in_round(nrow_,1), recolor(nrow_,0);
+    while(!round.empty()){
+      int nround = round.size();
+      
+      // Tentative coloring using Algorithm 4.1, with the colored vertices in place of the previous vertices.
+      // Other vertices of the round are colored concurrently, so each color is read once and atomically
+      #pragma omp parallel
+      {
+        vector<int> forbiddenColors, neighborColors, repeatedColors;
+        #pragma omp for schedule(dynamic,64)
+        for(int k=0; k<nround; ++k){
+          int i = round[k];
+          
+          // Colors appearing more than once among the neighbors
+          for(int w_el=rowind_[i]; w_el<rowind_[i+1]; ++w_el){
+            int w = col_[w_el];
+            if(w==i) continue;
+            int color_w = loadColor(color,w);
+            if(color_w<0) continue;
+            if(isMarked(neighborColors,color_w,i)){
+              markColor(repeatedColors,color_w,i);
+            } else {
+              markColor(neighborColors,color_w,i);
+            }
+          }
+          
+          for(int w_el=rowind_[i]; w_el<rowind_[i+1]; ++w_el){
+            int w = col_[w_el];
+            int color_w = loadColor(color,w);
+            
+            // Distance-1 neighbors
+            if(color_w>=0) markColor(forbiddenColors,color_w,i);
+            
+            for(int x_el=rowind_[w]; x_el<rowind_[w+1]; ++x_el){
+              int x = col_[x_el];
+              int color_x = loadColor(color,x);
+              if(color_x<0) continue;
+              
+              if(color_w<0){
+                // Distance-2 neighbors through an uncolored vertex
+                markColor(forbiddenColors,color_x,i);
+              } else if(w!=i && x!=i && isMarked(repeatedColors,color_w,i)){
+                // Another neighbor has the color of w: x would complete a two-colored path through i
+                markColor(forbiddenColors,color_x,i);
+              } else {
+                // Two-colored path i-w-x-y
+                for(int y_el=rowind_[x]; y_el<rowind_[x+1]; ++y_el){
+                  int y = col_[y_el];
+                  if(y==w) continue;
+                  int color_y = loadColor(color,y);
+                  if(color_y>=0 && color_y==color_w){
+                    markColor(forbiddenColors,color_x,i);
+                    break;
+                  }
+                }
+              }
+            }
+          }
+          
+          // Get the first nonforbidden color
+          int color_i = 0;
+          while(isMarked(forbiddenColors,color_i,i)) color_i++;
+          storeColor(color,i,color_i);
+        }
+      }
+      
+      // Detect conflicts, i.e. adjacent vertices with the same color and two-colored paths on four vertices.
+      // The colors are only read here, the vertices to recolor are collected per thread and merged afterwards
+      #pragma omp parallel
+      {
+        vector<int> conflicts;
+        #pragma omp for
+        for(int k=0; k<nround; ++k){
+          int v = round[k];
+          int p[4];
+          p[0] = v;
+          for(int el1=rowind_[v]; el1<rowind_[v+1]; ++el1){
+            p[1] = col_[el1];
+            if(p[1]==v) continue;
+          
+            // Adjacent vertices
+            if(color[p[1]]==color[v]){
+              markConflict(p,2,in_round,conflicts);
+              continue;
+            }
+          
+            // Paths v-p1-p2-p3 with v and p2, p1 and p3 having the same color
+            for(int el2=rowind_[p[1]]; el2<rowind_[p[1]+1]; ++el2){
+              p[2] = col_[el2];
+              if(p[2]==p[1] || p[2]==v || color[p[2]]!=color[v]) continue;
+              for(int el3=rowind_[p[2]]; el3<rowind_[p[2]+1]; ++el3){
+                p[3] = col_[el3];
+                if(p[3]==p[2] || p[3]==p[1] || p[3]==v || color[p[3]]!=color[p[1]]) continue;
+                markConflict(p,4,in_round,conflicts);
+              }
+            }
+          }
+        
+          // Paths q0-v-q2-q3 with q0 and q2, v and q3 having the same color
+          int q[4];
+          q[1] = v;
+          for(int el0=rowind_[v]; el0<rowind_[v+1]; ++el0){
+            q[0] = col_[el0];
+            if(q[0]==v || color[q[0]]<0) continue;
+            for(int el2=rowind_[v]; el2<rowind_[v+1]; ++el2){
+              q[2] = col_[el2];
+              if(q[2]==v || q[2]==q[0] || color[q[2]]!=color[q[0]]) continue;
+              for(int el3=rowind_[q[2]]; el3<rowind_[q[2]+1]; ++el3){
+                q[3] = col_[el3];
+                if(q[3]==q[2] || q[3]==v || q[3]==q[0] || color[q[3]]!=color[v]) continue;
+                markConflict(q,4,in_round,conflicts);
+              }
+            }
+          }
+        }
+        
+        // Merge the conflicts of the thread
+        #pragma omp critical(parallelStarColoring_conflicts)
+        for(vector<int>::const_iterator it=conflicts.begin(); it!=conflicts.end(); ++it){
+          recolor[*it] = 1;
+        }
+      }
+      
+      // Vertices to be colored in the next round
+      int num_colors = 0;
+      vector<int> next_round;
+      for(int k=0; k<nround; ++k){
+        int i = round[k];
+        in_round[i] = recolor[i];
+        if(recolor[i]){
+          next_round.push_back(i);
+        } else {
+          num_colors = max(num_colors,color[i]+1);
+        }
+      }
+      for(vector<int>::const_iterator it=next_round.begin(); it!=next_round.end(); ++it){
+        color[*it] = -1;
+        recolor[*it] = 0;
+      }
+      round.swap(next_round);
+      
+      // Cutoff if too many colors
+      if(num_colors>cutoff) return CRSSparsity();
+    }
+
+    // Number of colors used
+    int num_colors = compressColors(color);
+    if(num_colors>cutoff) return CRSSparsity();
+
+    // Return sparsity in sparse triplet format
+    return sp_triplet(num_colors,nrow_,color,range(color.size()));
+  }
+
   std::vector<int> CRSSparsityInternal::largestFirstOrdering() const{
     vector<int> degree = rowind_;
     int max_degree = 0;
@@ -2993,6 +3333,101 @@ namespace CasADi{
     return reverse_ordering;
   }
 
+  std::vector<int> CRSSparsityInternal::smallestLastOrdering() const{
+    // Degree of each vertex, not counting the diagonal
+    vector<int> degree(nrow_,0);
+    int max_degree = 0;
+    for(int k=0; k<nrow_; ++k){
+      for(int el=rowind_[k]; el<rowind_[k+1]; ++el){
+        if(col_[el]!=k) degree[k]++;
+      }
+      max_degree = max(max_degree,degree[k]);
+    }
+    
+    // Vertices sorted into buckets by degree
+    vector<int> head(max_degree+1,-1), next(nrow_), prev(nrow_);
+    for(int k=nrow_-1; k>=0; --k){
+      bucketInsert(k,degree[k],head,next,prev);
+    }
+    
+    // Remove the vertices in order of increasing degree, placing them from the back
+    vector<bool> removed(nrow_,false);
+    vector<int> ordering(nrow_);
+    int d = 0;
+    for(int pos=nrow_-1; pos>=0; --pos){
+      // The smallest degree decreases by at most one with each removal
+      d = max(d-1,0);
+      while(head[d]<0) d++;
+      
+      // Remove the vertex
+      int v = head[d];
+      bucketRemove(v,d,head,next,prev);
+      removed[v] = true;
+      ordering[pos] = v;
+      
+      // Update the degree of the neighbors
+      for(int el=rowind_[v]; el<rowind_[v+1]; ++el){
+        int w = col_[el];
+        if(w==v || removed[w]) continue;
+        bucketRemove(w,degree[w],head,next,prev);
+        bucketInsert(w,--degree[w],head,next,prev);
+      }
+    }
+    
+    return ordering;
+  }
+
+  std::vector<int> CRSSparsityInternal::incidenceDegreeOrdering() const{
+    // Largest degree, not counting the diagonal
+    int max_degree = 0;
+    for(int k=0; k<nrow_; ++k){
+      max_degree = max(max_degree,rowind_[k+1]-rowind_[k]);
+    }
+    
+    // Vertices sorted into buckets by the number of neighbors already ordered, all zero to start with
+    vector<int> incidence(nrow_,0);
+    vector<int> head(max_degree+1,-1), next(nrow_), prev(nrow_);
+    for(int k=nrow_-1; k>=0; --k){
+      bucketInsert(k,0,head,next,prev);
+    }
+    
+    // Order the vertex with the largest incidence degree next
+    vector<bool> ordered(nrow_,false);
+    vector<int> ordering(nrow_);
+    int d = 0;
+    for(int pos=0; pos<nrow_; ++pos){
+      while(head[d]<0) d--;
+      
+      // Order the vertex
+      int v = head[d];
+      bucketRemove(v,d,head,next,prev);
+      ordered[v] = true;
+      ordering[pos] = v;
+      
+      // Update the incidence degree of the neighbors
+      for(int el=rowind_[v]; el<rowind_[v+1]; ++el){
+        int w = col_[el];
+        if(w==v || ordered[w]) continue;
+        bucketRemove(w,incidence[w],head,next,prev);
+        bucketInsert(w,++incidence[w],head,next,prev);
+        d = max(d,incidence[w]);
+      }
+    }
+    
+    return ordering;
+  }
+
+  std::vector<int> CRSSparsityInternal::vertexOrdering(int ordering) const{
+    casadi_assert_message(ordering>=1 && ordering<=3, "CRSSparsity: Unknown ordering " << ordering << ". Options are none (0), largest first (1), smallest last (2) and incidence degree (3).");
+    if(ordering==1){
+      return largestFirstOrdering();
+    } else if(ordering==2){
+      return smallestLastOrdering();
+    } else {
+      return incidenceDegreeOrdering();
+    }
+  }
+
   CRSSparsity CRSSparsityInternal::pmult(const std::vector<int>& p, bool permute_rows, bool permute_columns, bool invert_permutation) const{
     // Invert p, possibly
     vector<int> p_inv;
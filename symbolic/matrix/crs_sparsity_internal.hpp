@@ -246,14 +246,29 @@ namespace CasADi{
     std::vector<int> rowind_;
     
     /// Perform a unidirectional coloring: A greedy distance-2 coloring algorithm (Algorithm 3.1 in A. H. GEBREMEDHIN, F. MANNE, A. POTHEN) 
-    CRSSparsity unidirectionalColoring(const CRSSparsity& AT, int cutoff) const;
+    CRSSparsity unidirectionalColoring(const CRSSparsity& AT, int cutoff, int ordering) const;
+
+    /// Perform a unidirectional coloring in parallel: speculative coloring with conflict resolution
+    CRSSparsity parallelUnidirectionalColoring(const CRSSparsity& AT, int cutoff, int ordering) const;
 
     /// Perform a star coloring of a symmetric matrix: A greedy distance-2 coloring algorithm (Algorithm 4.1 in A. H. GEBREMEDHIN, F. MANNE, A. POTHEN)
     CRSSparsity starColoring(int ordering, int cutoff) const;
 
+    /// Perform a star coloring of a symmetric matrix in parallel: speculative coloring with conflict resolution
+    CRSSparsity parallelStarColoring(int ordering, int cutoff) const;
+
     /// Order the rows by decreasing degree
     std::vector<int> largestFirstOrdering() const;
 
+    /// Order the rows by repeatedly removing a row of smallest degree, the row removed last comes first
+    std::vector<int> smallestLastOrdering() const;
+
+    /// Order the rows by repeatedly choosing a row with the largest number of neighbors already ordered
+    std::vector<int> incidenceDegreeOrdering() const;
+
+    /// Get an ordering by its number: largest first (1), smallest last (2), incidence degree (3)
+    std::vector<int> vertexOrdering(int ordering) const;
+
     /// Permute rows and/or columns
     CRSSparsity pmult(const std::vector<int>& p, bool permute_rows=true, bool permute_columns=true, bool invert_permutation=false) const;
     
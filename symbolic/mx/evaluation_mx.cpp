@@ -533,4 +533,9 @@ void EvaluationMX::generateOperation(std::ostream &stream, const std::vector<std
   stream << ");" << endl;  
 }
 
+bool EvaluationMX::structuralHash(std::size_t& seed) const{
+  MXNode::structuralHash(seed);
+  return fcn_->structuralHash(seed);
+}
+
 } // namespace CasADi
@@ -89,6 +89,9 @@ class EvaluationMX : public MultipleOutput{
 
     /** \brief Get the operation */
     virtual int getOp() const{ return OP_CALL;}
+
+    /** \brief Combine a hash of the structure of the node, including the called function, into seed */
+    virtual bool structuralHash(std::size_t& seed) const;
     
     // Function to be evaluated
     FX fcn_;
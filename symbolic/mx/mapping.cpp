@@ -663,4 +663,18 @@ void Mapping::generateOperation(std::ostream &stream, const std::vector<std::str
   }
 }
 
+bool Mapping::structuralHash(std::size_t& seed) const{
+  MXNode::structuralHash(seed);
+  
+  // Which nonzeros are mapped where
+  for(vector<vector<OutputNZ> >::const_iterator it=output_sorted_.begin(); it!=output_sorted_.end(); ++it){
+    hash_combine(seed,int(it->size()));
+    for(vector<OutputNZ>::const_iterator it2=it->begin(); it2!=it->end(); ++it2){
+      hash_combine(seed,it2->inz);
+      hash_combine(seed,it2->iind);
+    }
+  }
+  return true;
+}
+
 } // namespace CasADi
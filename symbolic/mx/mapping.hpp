@@ -119,6 +119,9 @@ class Mapping : public MXNode{
 
     /** \brief Get the operation */
     virtual int getOp() const{ return OP_MAPPING;}    
+
+    /** \brief Combine a hash of the structure of the node into seed */
+    virtual bool structuralHash(std::size_t& seed) const;
 };
 
 } // namespace CasADi
@@ -26,6 +26,7 @@
 #include <cassert>
 #include <typeinfo> 
 #include "../matrix/matrix_tools.hpp"
+#include "../matrix/sparsity_tools.hpp"
 
 using namespace std;
 
@@ -214,6 +215,20 @@ void MXNode::printPart(std::ostream &stream, int part) const{
   stream << ",";
 }
 
+bool MXNode::structuralHash(std::size_t& seed) const{
+  // Node class and operation
+  const char* cname = typeid(*this).name();
+  for(const char* c=cname; *c!=0; ++c) hash_combine(seed,int(*c));
+  hash_combine(seed,getOp());
+  
+  // Sparsity of the node and its dependencies
+  hash_combine(seed,int(sparsity().hash()));
+  for(int i=0; i<ndep(); ++i){
+    hash_combine(seed,dep(i).isNull() ? -1 : int(dep(i).sparsity().hash()));
+  }
+  return true;
+}
+
 FX& MXNode::getFunction(){
   throw CasadiException(string("MXNode::getFunction() not defined for class ") + typeid(*this).name());
 }
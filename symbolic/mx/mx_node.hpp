@@ -159,6 +159,9 @@ class MXNode : public SharedObjectNode{
     /** \brief Get the operation */
     virtual int getOp() const = 0;
 
+    /** \brief Combine a hash of the structure of the node into seed, returns false if not supported */
+    virtual bool structuralHash(std::size_t& seed) const;
+
     /** \brief  dependencies - functions that have to be evaluated before this one */
     const MX& dep(int ind=0) const;
     MX& dep(int ind=0);
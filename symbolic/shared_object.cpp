@@ -95,7 +95,7 @@ void SharedObject::count_up(){
 }
 
 void SharedObject::count_down(){
-  if(node && --node->count == 0){
+  if(node && refcount_release(node->count) == 0){
     delete node;
     node = 0;
   }  
@@ -120,7 +120,11 @@ SharedObjectNode::SharedObjectNode(){
 SharedObjectNode::~SharedObjectNode(){
    assert(count==0);
    if(weak_ref_!=0){
-     weak_ref_->kill();
+     // Make sure that no other thread is acquiring a reference through the weak reference
+     {
+       CASADI_CACHE_LOCK(WeakRef::mutex_);
+       weak_ref_->kill();
+     }
      delete weak_ref_;    
    }
 }
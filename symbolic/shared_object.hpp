@@ -25,6 +25,7 @@
 
 #include "printable_object.hpp"
 #include "casadi_exception.hpp"
+#include "casadi_types.hpp"
 #include <map>
 #include <vector>
 
@@ -161,6 +162,7 @@ class SharedObject : public PrintableObject{
 /// Internal class for the reference counting framework, see comments on the public class.
 class SharedObjectNode{
   friend class SharedObject;
+  friend class WeakRef;
   public:
   
   /// Default constructor
@@ -216,7 +218,7 @@ class SharedObjectNode{
 
   private:
     /// Number of references pointing to the object
-    unsigned int count;
+    refcount_t count;
 
     /// Weak pointer (non-owning) object for the object
     WeakRef* weak_ref_;
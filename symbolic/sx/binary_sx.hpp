@@ -62,11 +62,11 @@ class BinarySX : public SXNode{
     virtual ~BinarySX(){
       // Start destruction method if any of the dependencies has dependencies
       for(int c1=0; c1<2; ++c1){
-        // Get the node of the dependency and remove it from the smart pointer
+        // Get the node of the dependency and remove it from the smart pointer, non-null if this was the last reference
         SXNode* n1 = dep(c1).assignNoDelete(casadi_limits<SX>::nan);
         
         // Check if this was the last reference
-        if(n1->count==0){
+        if(n1!=0){
 
           // Check if binary
           if(!n1->hasDep()){ // n1 is not binary
@@ -91,11 +91,11 @@ class BinarySX : public SXNode{
               bool added_to_stack = false;
               for(int c2=0; c2<t->ndep(); ++c2){ // for all dependencies of the dependency
                 
-                // Get the node of the dependency of the top element and remove it from the smart pointer
+                // Get the node of the dependency of the top element and remove it from the smart pointer, non-null if this was the last reference
                 SXNode *n2 = t->dep(c2).assignNoDelete(casadi_limits<SX>::nan);
                 
                 // Check if this is the only reference to the element
-                if(n2->count == 0){
+                if(n2!=0){
                   
                   // Check if binary
                   if(!n2->hasDep()){
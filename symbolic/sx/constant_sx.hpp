@@ -93,28 +93,36 @@ class RealtypeSX : public ConstantSX{
     
     /// Destructor
     virtual ~RealtypeSX(){
-      size_t num_erased = cached_constants_.erase(value);
-      assert(num_erased==1);
+      CASADI_CACHE_LOCK(cache_mutex_);
+      
+      // Remove from the cache, unless it has already been replaced by another thread
+      CACHING_MAP<double,RealtypeSX*>::iterator it = cached_constants_.find(value);
+      if(it!=cached_constants_.end() && it->second==this) cached_constants_.erase(it);
     }
     
-    /// Static creator function (use instead of constructor)
+    /// Static creator function (use instead of constructor), the reference count of the returned node has already been increased
     inline static RealtypeSX* create(double value){
-      // Try to find the constant
+      CASADI_CACHE_LOCK(cache_mutex_);
+      
+      // Try to find the constant and acquire a reference to it
       CACHING_MAP<double,RealtypeSX*>::iterator it = cached_constants_.find(value);
+      if(it!=cached_constants_.end() && refcount_acquire(it->second->count)){
+        return it->second;
+      }
       
-      // If not found, add it,
-      if(it==cached_constants_.end()){
-        // Allocate a new object
-        RealtypeSX* n = new RealtypeSX(value);
+      // If not found or being deleted, allocate a new object
+      RealtypeSX* n = new RealtypeSX(value);
+      n->count = 1;
         
-        // Add to hash_table
-        cached_constants_.insert(it,std::make_pair(value,n));
-        
-        // Return it to caller
-        return n;
-      } else { // Else, returned the object
-        return it->second;
+      // Add to hash_table
+      if(it==cached_constants_.end()){
+        cached_constants_.insert(std::make_pair(value,n));
+      } else {
+        it->second = n;
       }
+      
+      // Return it to caller
+      return n;
     }
     
     //@{
@@ -126,6 +134,11 @@ class RealtypeSX : public ConstantSX{
   protected:
     /** \brief Hash map of all constants currently allocated (storage is allocated for it in sx.cpp) */
     static CACHING_MAP<double,RealtypeSX*> cached_constants_;
+
+#ifdef WITH_THREADSAFE_SYMBOLICS
+    /** \brief Protects cached_constants_ */
+    static std::mutex cache_mutex_;
+#endif // WITH_THREADSAFE_SYMBOLICS
     
     /** \brief  Data members */
     double value;
@@ -145,28 +158,36 @@ class IntegerSX : public ConstantSX{
 
     /// Destructor
     virtual ~IntegerSX(){
-      size_t num_erased = cached_constants_.erase(value);
-      assert(num_erased==1);
+      CASADI_CACHE_LOCK(cache_mutex_);
+      
+      // Remove from the cache, unless it has already been replaced by another thread
+      CACHING_MAP<int,IntegerSX*>::iterator it = cached_constants_.find(value);
+      if(it!=cached_constants_.end() && it->second==this) cached_constants_.erase(it);
     }
     
-    /// Static creator function (use instead of constructor)
+    /// Static creator function (use instead of constructor), the reference count of the returned node has already been increased
     inline static IntegerSX* create(int value){
-      // Try to find the constant
+      CASADI_CACHE_LOCK(cache_mutex_);
+      
+      // Try to find the constant and acquire a reference to it
       CACHING_MAP<int,IntegerSX*>::iterator it = cached_constants_.find(value);
+      if(it!=cached_constants_.end() && refcount_acquire(it->second->count)){
+        return it->second;
+      }
       
-      // If not found, add it,
-      if(it==cached_constants_.end()){
-        // Allocate a new object
-        IntegerSX* n = new IntegerSX(value);
+      // If not found or being deleted, allocate a new object
+      IntegerSX* n = new IntegerSX(value);
+      n->count = 1;
         
-        // Add to hash_table
-        cached_constants_.insert(it,std::make_pair(value,n));
-        
-        // Return it to caller
-        return n;
-      } else { // Else, returned the object
-        return it->second;
+      // Add to hash_table
+      if(it==cached_constants_.end()){
+        cached_constants_.insert(std::make_pair(value,n));
+      } else {
+        it->second = n;
       }
+      
+      // Return it to caller
+      return n;
     }
     
     //@{
@@ -182,6 +203,11 @@ class IntegerSX : public ConstantSX{
 
     /** \brief Hash map of all constants currently allocated (storage is allocated for it in sx.cpp) */
     static CACHING_MAP<int,IntegerSX*> cached_constants_;
+
+#ifdef WITH_THREADSAFE_SYMBOLICS
+    /** \brief Protects cached_constants_ */
+    static std::mutex cache_mutex_;
+#endif // WITH_THREADSAFE_SYMBOLICS
     
     /** \brief  Data members */
     int value;
@@ -35,6 +35,10 @@ using namespace std;
 namespace CasADi{
 
 // Allocate storage for the caching
+#ifdef WITH_THREADSAFE_SYMBOLICS
+std::mutex IntegerSX::cache_mutex_;
+std::mutex RealtypeSX::cache_mutex_;
+#endif // WITH_THREADSAFE_SYMBOLICS
 CACHING_MAP<int,IntegerSX*> IntegerSX::cached_constants_;
 CACHING_MAP<double,RealtypeSX*> RealtypeSX::cached_constants_;
 
@@ -63,12 +67,12 @@ SX::SX(double val){
     else if(intval == 1)        node = casadi_limits<SX>::one.node;
     else if(intval == 2)        node = casadi_limits<SX>::two.node;
     else if(intval == -1)       node = casadi_limits<SX>::minus_one.node;
-    else                        node = IntegerSX::create(intval);
+    else {                      node = IntegerSX::create(intval); return;} // reference already counted
     node->count++;
   } else {
     if(isnan(val))              node = casadi_limits<SX>::nan.node;
     else if(isinf(val))         node = val > 0 ? casadi_limits<SX>::inf.node : casadi_limits<SX>::minus_inf.node;
-    else                        node = RealtypeSX::create(val);
+    else {                      node = RealtypeSX::create(val); return;} // reference already counted
     node->count++;
   }
 }
@@ -79,7 +83,7 @@ SX::SX(const std::string& name){
 }
 
 SX::~SX(){
-  if(--node->count == 0) delete node;
+  if(refcount_release(node->count) == 0) delete node;
 }
 
 SX& SX::operator=(const SX &scalar){
@@ -87,7 +91,7 @@ SX& SX::operator=(const SX &scalar){
   if(node == scalar.node) return *this;
 
   // decrease the counter and delete if this was the last pointer	
-  if(--node->count == 0) delete node;
+  if(refcount_release(node->count) == 0) delete node;
 
   // save the new pointer
   node = scalar.node;
@@ -103,21 +107,19 @@ void SX::assignIfDuplicate(const SX& scalar, int depth){
 }
 
 SXNode* SX::assignNoDelete(const SX& scalar){
-  // Return value
-  SXNode* ret = node;
-
   // quick return if the old and new pointers point to the same object
-  if(node == scalar.node) return ret;
+  if(node == scalar.node) return 0;
 
   // decrease the counter but do not delete if this was the last pointer
-  --node->count;
+  SXNode* old_node = node;
+  bool last = refcount_release(old_node->count) == 0;
 
   // save the new pointer
   node = scalar.node;
   node->count++;
   
-  // Return a pointer to the old node
-  return ret;
+  // Return a pointer to the old node if this was the last reference to it
+  return last ? old_node : 0;
 }
 
 SX& SX::operator=(double scalar){
@@ -492,7 +494,7 @@ bool __nonzero__<SX>(const SX& val) { return val.__nonzero__();}
 
 const SX casadi_limits<SX>::zero(new ZeroSX(),false); // node corresponding to a constant 0
 const SX casadi_limits<SX>::one(new OneSX(),false); // node corresponding to a constant 1
-const SX casadi_limits<SX>::two(IntegerSX::create(2),false); // node corresponding to a constant 2
+const SX casadi_limits<SX>::two(IntegerSX::create(2),false); // node corresponding to a constant 2 (the reference taken by create keeps it alive)
 const SX casadi_limits<SX>::minus_one(new MinusOneSX(),false); // node corresponding to a constant -1
 const SX casadi_limits<SX>::nan(new NanSX(),false);
 const SX casadi_limits<SX>::inf(new InfSX(),false);
@@ -275,7 +275,10 @@ namespace CasADi{
     /** \brief Get the depth to which equalities are being checked for simplifications */
     static int getEqualityCheckingDepth();
     
-    /** \brief Assign the node to something, without invoking the deletion of the node, if the count reaches 0 */
+    /** \brief Assign the node to something, without invoking the deletion of the node, if the count reaches 0
+     * Returns the old node if this was the last reference to it, so that the caller is responsible for deleting it, and null otherwise.
+     * The decision is taken from the value returned by the decrement, so exactly one of several threads releasing a node gets it.
+     */
     SXNode* assignNoDelete(const SX& scalar);
     
     /** \brief SX nodes are not allowed to be null */
@@ -27,6 +27,7 @@
 #include <string>
 #include <sstream>
 #include <math.h>
+#include "../casadi_types.hpp"
 
 /** \brief  Scalar expression (which also works as a smart pointer class to this class) */
 #include "sx.hpp"
@@ -110,7 +111,7 @@ void mark();
 int temp;
 
 // Reference counter -- counts the number of parents of the node
-unsigned int count;
+refcount_t count;
 
 };
 
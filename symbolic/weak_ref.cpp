@@ -26,17 +26,25 @@ using namespace std;
 
 namespace CasADi{
   
+#ifdef WITH_THREADSAFE_SYMBOLICS
+  std::mutex WeakRef::mutex_;
+#endif // WITH_THREADSAFE_SYMBOLICS
+
   WeakRef::WeakRef(){
   }
     
   bool WeakRef::alive() const{
+    CASADI_CACHE_LOCK(mutex_);
     return !isNull() && (*this)->raw_ != 0;
   }
     
   SharedObject WeakRef::shared(){
+    CASADI_CACHE_LOCK(mutex_);
     SharedObject ret;
-    if(!isNull() && (*this)->raw_ !=0){
-      ret.assignNode((*this)->raw_);
+    
+    // Only return the object if it is not being deleted
+    if(!isNull() && (*this)->raw_ !=0 && refcount_acquire((*this)->raw_->count)){
+      ret.assignNodeNoCount((*this)->raw_);
     }
     return ret;
   }
@@ -65,6 +65,11 @@ namespace CasADi{
 
     /** \brief The shared object has been deleted */
     void kill();
+
+#ifdef WITH_THREADSAFE_SYMBOLICS
+    /** \brief Protects the acquisition of references through weak references against the deletion of the object */
+    static std::mutex mutex_;
+#endif // WITH_THREADSAFE_SYMBOLICS
 #endif // SWIG    
  };
   
@@ -456,6 +456,82 @@ class ADtests(casadiTestCase):
     f.init()
     print f.input().shape
     J=f.jacobian(0,0)
+
+  def test_vectorize_directions(self):
+    self.message("Multiple directions in a single sweep")
+    x=ssym("x",3)
+    res = [vertcat([x[0]*sin(x[1]),x[2]**3+x[0],exp(x[1]*x[2]),x[0]])]
+    fs = []
+    for vectorize in [True,False]:
+      f=SXFunction([x],res)
+      f.setOption("vectorize_directions",vectorize)
+      f.setOption("number_of_fwd_dir",5)
+      f.setOption("number_of_adj_dir",3)
+      f.init()
+      f.input().set([1.1,0.7,-0.4])
+      for d in range(5):
+        f.fwdSeed(0,d).set([d,1,2*d-1])
+      for d in range(3):
+        f.adjSeed(0,d).set([1,d,-d,0.5])
+      f.evaluate(5,3)
+      fs.append(f)
+    self.checkarray(fs[0].output(),fs[1].output(),"output")
+    for d in range(5):
+      self.checkarray(fs[0].fwdSens(0,d),fs[1].fwdSens(0,d),"fwdSens")
+    for d in range(3):
+      self.checkarray(fs[0].adjSens(0,d),fs[1].adjSens(0,d),"adjSens")
+
+  def test_derivative_cache(self):
+    self.message("On-disk cache for Jacobian sparsity and coloring")
+    import tempfile, os
+    cache = tempfile.mkdtemp()
+    x=ssym("x",5)
+    res = [vertcat([x[0]*sin(x[1]),x[2]**3+x[0],exp(x[1]*x[2]),x[4]*x[3]])]
+    Js = []
+    for k in range(2):
+      f=SXFunction([x],res)
+      f.setOption("derivative_cache",cache)
+      f.init()
+      J = f.jacobian()
+      J.init()
+      J.input().set([1.1,0.7,-0.4,0.2,3])
+      J.evaluate()
+      Js.append(J)
+    self.checkarray(Js[0].output(),Js[1].output(),"jacobian")
+    self.assertTrue(len(os.listdir(cache))>0)
+    self.assertTrue(any(f.endswith(".fx") for f in os.listdir(cache)))
+    
+    # No temporary files are left behind, and the files are only accessible by the user
+    for fn in os.listdir(cache):
+      self.assertTrue(fn.endswith(".sp") or fn.endswith(".fx"))
+      self.assertEqual(os.stat(os.path.join(cache,fn)).st_mode & 077,0)
+      
+    # Files that others could have modified are not read, but replaced
+    for fn in os.listdir(cache):
+      os.chmod(os.path.join(cache,fn),0666)
+    f=SXFunction([x],res)
+    f.setOption("derivative_cache",cache)
+    f.init()
+    J = f.jacobian()
+    J.init()
+    J.input().set([1.1,0.7,-0.4,0.2,3])
+    J.evaluate()
+    self.checkarray(Js[0].output(),J.output(),"jacobian")
+    for fn in os.listdir(cache):
+      self.assertEqual(os.stat(os.path.join(cache,fn)).st_mode & 022,0)
+    
+    # Functions that differ only in a constant have the same structural hash, the cached Jacobian function must not be reused
+    y=msym("y",2)
+    for a in [2.0,3.0]:
+      f=MXFunction([y],[a*sin(y)])
+      f.setOption("derivative_cache",cache)
+      f.setOption("numeric_jacobian",False)
+      f.init()
+      J = f.jacobian()
+      J.init()
+      J.input().set([0.3,0.4])
+      J.evaluate()
+      self.checkarray(J.output(),a*diag([cos(0.3),cos(0.4)]),"jacobian")
     
 if __name__ == '__main__':
     unittest.main()
@@ -74,7 +74,7 @@ class FXtests(casadiTestCase):
     #! Evaluate this function ten times in parallel
     p = Parallelizer([f]*2)
     
-    for mode in ["openmp","serial"]:
+    for mode in ["openmp","serial","threads"]:
       p.setOption("parallelization",mode)
       p.init()
       
@@ -108,6 +108,64 @@ class FXtests(casadiTestCase):
       self.checkarray(array([0,cos(n2[1])]),p.adjSens(2),"adjSens")
       self.checkarray(1,p.adjSens(3),"adjSens")
 
+  def test_Parallelizer_work_stealing(self):
+    self.message("Parallelizer work stealing")
+    x = MX("x",2)
+    y = MX("y")
+
+    f = MXFunction([x,y],[sin(x) + y])
+    f.init()
+    
+    p = Parallelizer([f]*5)
+    p.setOption("parallelization","threads")
+    p.setOption("num_threads",2)
+    p.setOption("schedule","work_stealing")
+    p.setOption("cost_model",True)
+    p.setOption("gather_stats",True)
+    p.init()
+    
+    for i in range(5):
+      p.input(2*i).set([i,2*i])
+      p.input(2*i+1).set(i)
+    
+    # The second call distributes the tasks using the measured execution times
+    for k in range(2):
+      p.evaluate()
+      for i in range(5):
+        self.checkarray(sin(DMatrix([i,2*i]))+i,p.output(i),"output")
+    
+    stats = p.getStats()
+    self.assertEqual(stats["num_threads"],2)
+    self.assertEqual(len(stats["task_cputime"]),5)
+    self.assertTrue(all([t>=0 for t in stats["task_cputime"]]))
+    self.assertEqual(len(stats["task_stolen"]),5)
+    self.assertEqual(len(stats["thread_utilization"]),2)
+    self.assertTrue(all([u>=0 and u<=1 for u in stats["thread_utilization"]]))
+    
+  def test_result_cache(self):
+    self.message("Result cache")
+    x = ssym("x",2)
+    f = SXFunction([x],[sin(x)*x[0]])
+    f.setOption("result_cache_size",2)
+    f.init()
+    
+    g = SXFunction([x],[sin(x)*x[0]])
+    g.init()
+    
+    for k,v in enumerate([[1,2],[1,2],[3,4],[1,2],[5,6],[3,4]]):
+      for fcn in [f,g]:
+        fcn.input().set(v)
+        fcn.fwdSeed().set([1,0])
+        fcn.adjSeed().set([0,1])
+        fcn.evaluate(1,1)
+      self.checkarray(f.output(),g.output(),"output")
+      self.checkarray(f.fwdSens(),g.fwdSens(),"fwdSens")
+      self.checkarray(f.adjSens(),g.adjSens(),"adjSens")
+    
+    # Hits for the second and fourth call, [3,4] has been evicted when it is used again
+    self.assertEqual(f.getStats()["result_cache_hits"],2)
+    self.assertEqual(f.getStats()["result_cache_misses"],4)
+    
   def test_MXFunctionSeed(self):
     self.message("MXFunctionSeed")
     x1 = MX("x",2)
@@ -157,7 +215,7 @@ class FXtests(casadiTestCase):
     
     #! Evaluate this function ten times in parallel
     pp = Parallelizer([f]*2)
-    for mode in ["serial","openmp"]:
+    for mode in ["serial","openmp","threads"]:
       pp.setOption("parallelization",mode)
       pp.init()
       
@@ -409,6 +467,81 @@ class FXtests(casadiTestCase):
         
         test(d.sparsity())
         
+  def test_coloring(self):
+    self.message("Graph coloring algorithms and orderings")
+    x = ssym("x",30)
+    e = x[0]**3
+    for i in range(1,30):
+      e += x[i-1]**2*x[i] + x[i]*x[(7*i)%30]
+    f_ref = SXFunction([x],[e])
+    f_ref.init()
+    H_ref = f_ref.hessian()
+    H_ref.init()
+    H_ref.input().set(range(30))
+    H_ref.evaluate()
+    for coloring in ["serial","parallel"]:
+      for ordering in ["natural","largest_first","smallest_last","incidence_degree"]:
+        f = SXFunction([x],[e])
+        f.setOption("coloring",coloring)
+        f.setOption("coloring_ordering",ordering)
+        f.init()
+        H = f.hessian()
+        H.init()
+        H.input().set(range(30))
+        H.evaluate()
+        self.checkarray(H.output(),H_ref.output(),"hessian %s %s" % (coloring,ordering))
+        self.assertTrue(f.getStats()["num_colors"]>0)
+    
+    # In the on-disk cache, each coloring option has its own entry and the statistics are also reported when it is used
+    import tempfile, os
+    cache = tempfile.mkdtemp()
+    G = f_ref.gradient()
+    G.init()
+    X = msym("x",30)
+    num_colors = {}
+    for k in range(2):
+      for ordering in ["natural","smallest_last"]:
+        f = MXFunction([X],[G.call([X])[0]])
+        f.setOption("derivative_cache",cache)
+        f.setOption("coloring_ordering",ordering)
+        f.init()
+        J = f.jacobian()
+        J.init()
+        if k==0:
+          num_colors[ordering] = f.getStats()["num_colors"]
+        else:
+          self.assertEqual(f.getStats()["num_colors"],num_colors[ordering])
+    self.assertEqual(len([fn for fn in os.listdir(cache) if "partition" in fn]),2)
+        
+    sp = H_ref.output().sparsity()
+    for ordering in range(4):
+      self.assertTrue(sp.parallelStarColoring(ordering).size1()>0)
+    for ordering in range(4):
+      for D in [sp.unidirectionalColoring(sp,2**30,ordering), sp.parallelUnidirectionalColoring(sp,2**30,ordering)]:
+        self.assertTrue(D.size1()>0)
+        self.assertEqual(D.size(),sp.size1())
+    
+  def test_sparsity_threads(self):
+    self.message("Jacobian sparsity propagation on several threads")
+    x = ssym("x",200)
+    e = SXMatrix(x)
+    for i in range(1,200):
+      e[i] = sin(x[i-1])*x[i] + x[(7*i)%200]
+    X = msym("X",200)
+    for out in [e, sumAll(e**2)]:
+      sp_ref = None
+      for threads in [1,2,4]:
+        f = SXFunction([x],[out])
+        f.setOption("sparsity_threads",threads)
+        f.init()
+        g = MXFunction([X],f.call([X*2]))
+        g.setOption("sparsity_threads",threads)
+        g.init()
+        if sp_ref is None:
+          sp_ref = f.jacSparsity()
+        self.assertTrue(f.jacSparsity()==sp_ref,"SXFunction, threads %d" % threads)
+        self.assertTrue(g.jacSparsity()==sp_ref,"MXFunction, threads %d" % threads)
+    
   @skip(memcheck)
   def test_hessians(self):
     def test(sp):
@@ -497,6 +630,38 @@ class FXtests(casadiTestCase):
       d = vertcat(v)
       
       test(d.sparsity())
+
+  def test_evaluate_compressed(self):
+    self.message("evaluateCompressed skips all-zero directions")
+    x = ssym("x",3)
+    y = ssym("y",2)
+    out = [sin(x)*y[0],mul(x.T,x)*y[1]]
+    X = msym("X",3)
+    Y = msym("Y",2)
+    s = SXFunction([x,y],out)
+    s.init()
+    for create in [lambda : SXFunction([x,y],out), lambda : MXFunction([X,Y],s.call([X,Y]))]:
+      f = [create(), create()]
+      for fk in f:
+        fk.setOption("number_of_fwd_dir",4)
+        fk.setOption("number_of_adj_dir",3)
+        fk.init()
+        fk.input(0).set([0.1,0.2,0.3])
+        fk.input(1).set([1.5,-0.5])
+        # Forward directions 1 and adjoint direction 0 are zero
+        for d in range(4):
+          fk.fwdSeed(0,d).set([0 if d%2 else 1+d,0,0])
+          fk.fwdSeed(1,d).set([0,1 if d==3 else 0])
+        for d in range(3):
+          fk.adjSeed(0,d).set([0,2 if d==1 else 0,0])
+          fk.adjSeed(1,d).set(1 if d==2 else 0)
+      f[0].evaluate(4,3)
+      f[1].evaluateCompressed(4,3)
+      for i in range(2):
+        for d in range(4):
+          self.checkarray(f[1].fwdSens(i,d),f[0].fwdSens(i,d),"forward sensitivities")
+        for d in range(3):
+          self.checkarray(f[1].adjSens(i,d),f[0].adjSens(i,d),"adjoint sensitivities")
         
 if __name__ == '__main__':
     unittest.main()
@@ -54,6 +54,8 @@ class NLPtests(casadiTestCase):
     for Solver, options in [(KinsolSolver,{"linear_solver": CSparse}), 
                             (NLPImplicitSolver,{"linear_solver": CSparse,"nlp_solver": IpoptSolver}), 
                             (NewtonImplicitSolver,{"linear_solver": CSparse}),
+                            (NewtonImplicitSolver,{"linear_solver": CSparse,"linear_solver_options": {"refactorize": True, "nrhs_block": 2}}),
+                            (NewtonImplicitSolver,{"linear_solver": CSparseLDL}),
                            ]:
       self.message(Solver.__name__)
       message = Solver.__name__
@@ -103,6 +105,66 @@ class NLPtests(casadiTestCase):
       refsol.input().set(n)
       self.checkfx(solver,refsol,digits=6,gradient=False,hessian=False,sens_der=False,failmessage=message)
       
+  def test_csparse_refactorize(self):
+    self.message("CSparse refactorization and blocks of right hand sides, n=5")
+    A0 = DMatrix([[4,1,0,0,2],[0,3,1,0,0],[1,0,5,2,0],[0,2,0,6,1],[3,0,0,1,7]])
+    makeSparse(A0)
+    B = DMatrix([[1,2,3],[0,1,-1],[2,0,1],[-1,1,0],[0.5,3,2]])
+    for transpose in [False,True]:
+      message = "trans=%s" % str(transpose)
+      ref = CSparse(A0.sparsity())
+      ref.setOption("trans",transpose)
+      ref.setOption("nrhs",B.size2())
+      ref.init()
+      solver = CSparse(A0.sparsity())
+      solver.setOption("trans",transpose)
+      solver.setOption("nrhs",B.size2())
+      solver.setOption("refactorize",True)
+      solver.setOption("nrhs_block",2)
+      solver.init()
+      for k in range(4):
+        A = DMatrix(A0)
+        A.set([a*(1+0.05*k*sin(i)) for i,a in enumerate(A0.data())])
+        for f in [ref,solver]:
+          f.setInput(A,0)
+          f.setInput(B,1)
+          f.evaluate()
+        self.checkarray(solver.output(),ref.output(),digits=10,failmessage=message)
+        if transpose:
+          self.checkarray(mul(trans(A),solver.output()),B,digits=10,failmessage=message)
+        else:
+          self.checkarray(mul(A,solver.output()),B,digits=10,failmessage=message)
+      self.assertTrue(solver.getStats()["n_refactorizations"]>0)
+      
+  def test_csparse_ldl(self):
+    self.message("CSparseLDL on a positive definite and on a quasi-definite matrix")
+    spd = DMatrix([[5,1,1,1,1],[1,4,0,0,0],[1,0,3,0,0],[1,0,0,6,0],[1,0,0,0,2]])
+    kkt = DMatrix([[6,1,1,1,1,0],[1,4,0,0,0,1],[1,0,3,0,1,0],[1,0,0,5,0,1],[1,0,1,0,-0.5,0],[0,1,0,1,0,-0.5]])
+    for A in [spd,kkt]:
+      makeSparse(A)
+      n = A.size1()
+      B = DMatrix([[i+1,1-0.5*i] for i in range(n)])
+      ref = CSparse(A.sparsity())
+      ref.setOption("nrhs",2)
+      ref.init()
+      ref.setInput(A,0)
+      ref.setInput(B,1)
+      ref.evaluate()
+      for ordering in ["amd","natural"]:
+        solver = CSparseLDL(A.sparsity())
+        solver.setOption("nrhs",2)
+        solver.setOption("ordering",ordering)
+        solver.init()
+        solver.setInput(A,0)
+        solver.setInput(B,1)
+        solver.evaluate()
+        self.checkarray(solver.output(),ref.output(),digits=10,failmessage=ordering)
+    
+    A = DMatrix([[1,1],[0,1]])
+    makeSparse(A)
+    solver = CSparseLDL(A.sparsity())
+    self.assertRaises(RuntimeError,lambda : solver.init())
+      
   def testKINSol1c(self):
     self.message("Scalar KINSol problem, n=0, constraint")
     x=SX("x")
@@ -259,6 +259,7 @@ class Integrationtests(casadiTestCase):
               yield d
             #yield {"linear_solver_type" +post: "banded", "lower_bandwidth"+post: 0, "upper_bandwidth"+post: 0 }
             yield {"linear_solver_type" +post: "user_defined", "linear_solver"+post: CSparse }
+            yield {"linear_solver_type" +post: "sparse", "linear_solver"+post: CSparse, "linear_solver_options"+post: {"refactorize": True} }
               
           for a_options in solveroptions("B"):
             for f_options in solveroptions():
@@ -1313,6 +1314,111 @@ class Integrationtests(casadiTestCase):
     integrator.fwdSeed(0).set([1])
     integrator.evaluate(1,0) # fail
     
+  def test_dormand_prince_fwd_sens(self):
+    self.message("Forward sensitivities with DormandPrinceIntegrator")
+    t=ssym("t")
+    x=ssym("x",2)
+    p=ssym("p")
+    f=SXFunction(daeIn(t=t,x=x,p=p),daeOut(ode=vertcat([x[1],p*(1-x[0]**2)*x[1]-x[0]]),quad=x[0]**2))
+    # The integrator must raise the number of directions of the right hand side itself
+    f.setOption("number_of_fwd_dir",0)
+    f.init()
+    results = []
+    for Integrator in [CVodesIntegrator, DormandPrinceIntegrator]:
+      integrator = Integrator(f)
+      integrator.setOption("abstol",1e-10)
+      integrator.setOption("reltol",1e-10)
+      integrator.setOption("tf",2.3)
+      integrator.setOption("number_of_fwd_dir",2)
+      integrator.init()
+      integrator.input(INTEGRATOR_X0).set([1,0.5])
+      integrator.input(INTEGRATOR_P).set(1.2)
+      integrator.fwdSeed(INTEGRATOR_X0,0).set([1,0])
+      integrator.fwdSeed(INTEGRATOR_P,0).set(0)
+      integrator.fwdSeed(INTEGRATOR_X0,1).set([0,0])
+      integrator.fwdSeed(INTEGRATOR_P,1).set(1)
+      integrator.evaluate(2,0)
+      results.append([DMatrix(integrator.fwdSens(i,d)) for d in range(2) for i in [INTEGRATOR_XF,INTEGRATOR_QF]])
+    for a,b in zip(results[0],results[1]):
+      self.checkarray(b,a,"forward sensitivities",digits=6)
+    
+  def test_ensemble(self):
+    self.message("Ensemble of scenarios")
+    t=ssym("t")
+    x=ssym("x",2)
+    p=ssym("p")
+    f=SXFunction(daeIn(t=t,x=x,p=p),daeOut(ode=vertcat([x[1],p*(1-x[0]**2)*x[1]-x[0]]),quad=x[0]**2))
+    f.init()
+    N = 7
+    x0 = DMatrix([[1+0.1*k for k in range(N)],[0.5]*N])
+    p0 = DMatrix([[1+0.2*k for k in range(N)]])
+    for Integrator, options in [(CVodesIntegrator,{}),(CVodesIntegrator,{"ensemble_threads": 3}),(DormandPrinceIntegrator,{}),(DormandPrinceIntegrator,{"ensemble_shared_steps": False})]:
+      integrator = Integrator(f)
+      integrator.setOption(options)
+      integrator.setOption("abstol",1e-10)
+      integrator.setOption("reltol",1e-10)
+      integrator.setOption("tf",2.3)
+      integrator.init()
+      xf, qf = integrator.evaluateEnsemble(x0,p0)
+      for k in range(N):
+        integrator.input(INTEGRATOR_X0).set(x0[:,k])
+        integrator.input(INTEGRATOR_P).set(p0[0,k])
+        integrator.evaluate()
+        self.checkarray(xf[:,k],integrator.output(INTEGRATOR_XF),"ensemble states",digits=8)
+        self.checkarray(qf[:,k],integrator.output(INTEGRATOR_QF),"ensemble quadratures",digits=8)
+      
+      # Shared parameters
+      xf, qf = integrator.evaluateEnsemble(x0,DMatrix(1.5))
+      integrator.input(INTEGRATOR_X0).set(x0[:,N-1])
+      integrator.input(INTEGRATOR_P).set(1.5)
+      integrator.evaluate()
+      self.checkarray(xf[:,N-1],integrator.output(INTEGRATOR_XF),"ensemble states, shared parameters",digits=8)
+
+  def test_checkpoint_memory_budget(self):
+    self.message("Adjoint sensitivities with a checkpoint memory budget")
+    t=ssym("t")
+    x=ssym("x",2)
+    p=ssym("p",2)
+    rx=ssym("rx",2)
+    f=SXFunction(daeIn(t=t,x=x,p=p),daeOut(ode=vertcat([x[1],-p[0]*x[0]-p[1]*x[1]]),quad=x[0]**2))
+    f.init()
+    # Adjoint of the quadrature, its backward quadrature is the gradient with respect to p
+    g=SXFunction(rdaeIn(rx=rx,t=t,x=x,p=p),rdaeOut(ode=vertcat([-p[0]*rx[1]+2*x[0],rx[0]-p[1]*rx[1]]),quad=vertcat([-x[0]*rx[1],-x[1]*rx[1]])))
+    g.init()
+    for Integrator in [CVodesIntegrator, IdasIntegrator]:
+      adjsens = []
+      for budget in [0, 0.05, 0.01]:
+        integrator = Integrator(f,g)
+        integrator.setOption("abstol",1e-12)
+        integrator.setOption("reltol",1e-12)
+        integrator.setOption("tf",20.0)
+        integrator.setOption("max_num_steps",100000)
+        integrator.setOption("checkpoint_memory_budget",budget)
+        integrator.setOption("gather_stats",True)
+        integrator.init()
+        steps_per_checkpoint = []
+        checkpoint_memory = []
+        for r in range(2):
+          integrator.input(INTEGRATOR_X0).set([1,0])
+          integrator.input(INTEGRATOR_P).set([2,0.1])
+          integrator.evaluate()
+          adjsens.append(DMatrix(integrator.output(INTEGRATOR_RQF)))
+          steps_per_checkpoint.append(integrator.getStats()["steps_per_checkpoint"])
+          checkpoint_memory.append(integrator.getStats()["checkpoint_memory"])
+        if budget>0:
+          # The first pass is bounded using expected_num_steps, which defaults to max_num_steps
+          self.assertTrue(steps_per_checkpoint[0]!=20)
+          # Adapted again only if the taped steps did not fit the budget
+          self.assertTrue(checkpoint_memory[1]<=budget*1e6)
+          if checkpoint_memory[0]<=budget*1e6:
+            self.assertEqual(steps_per_checkpoint[1],steps_per_checkpoint[0])
+          else:
+            self.assertTrue(steps_per_checkpoint[1]<steps_per_checkpoint[0])
+        else:
+          self.assertEqual(steps_per_checkpoint,[20,20])
+      for a in adjsens[1:]:
+        self.checkarray(a,adjsens[0],"adjoint sensitivities",digits=7)
+    
 if __name__ == '__main__':
     unittest.main()
 
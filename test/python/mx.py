@@ -1974,8 +1974,129 @@ class MXtests(casadiTestCase):
     f.evaluate()
     
     self.assertAlmostEqual(f.output(),4.6)
+
+  def test_save_load(self):
+    self.message("Binary serialization of SXFunction and MXFunction")
+    import tempfile, os
+    d = tempfile.mkdtemp()
+    x = ssym("x",3)
+    f = SXFunction([x],[vertcat([sin(x[0])*x[1],x[2]**2+3])])
+    f.init()
+    X = msym("X",3)
+    P = msym("P",2,2)
+    g = MXFunction([X,P],[mul(P,X[0:2]) + f.call([X])[0][1:3]*2,exp(X)])
+    g.init()
+    for fcn in [f,g]:
+      fname = os.path.join(d,"fcn.casadi")
+      fcn.save(fname)
+      fcn2 = FX.load(fname)
+      fcn2.init()
+      for i in range(fcn.getNumInputs()):
+        fcn.input(i).set(range(1,fcn.input(i).size()+1))
+        fcn2.input(i).set(range(1,fcn.input(i).size()+1))
+      self.checkfx(fcn2,fcn,sens_der=False,hessian=False)
+
+  def test_incremental_evaluation(self):
+    self.message("Incremental evaluation of MXFunction")
+    x = ssym("x",2)
+    f = SXFunction([x],[sin(x)*x[0]])
+    f.init()
+    X = msym("X",2)
+    P = msym("P",2,2)
+    out = [mul(P,P)+3, f.call([X])[0]*2+P[0,0], exp(X)]
+    g = MXFunction([X,P],out)
+    g.init()
+    h = MXFunction([X,P],out)
+    h.setOption("incremental_evaluation",True)
+    h.setOption("gather_stats",True)
+    h.init()
     
-    
+    n = [0]*3
+    for k,(xv,pv) in enumerate([([1,2],[1,2,3,4]),([1,3],[1,2,3,4]),([1,3],[2,2,3,4]),([1,3],[2,2,3,4])]):
+      for fcn in [g,h]:
+        fcn.input(0).set(xv)
+        fcn.input(1).set(pv)
+        fcn.evaluate()
+      for i in range(3):
+        self.checkarray(h.output(i),g.output(i),"incremental evaluation")
+      if k>0:
+        n[k-1] = h.getStats()["num_evaluated"]
+      else:
+        n_full = h.getStats()["num_evaluated"]
+    
+    # Changing only one input reevaluates less than a full evaluation, unchanged inputs reevaluate nothing
+    self.assertTrue(n[0]>0 and n[1]>0)
+    self.assertTrue(n[0]<n_full and n[1]<n_full)
+    self.assertEqual(n[2],0)
+    
+    # Derivatives are computed with a full evaluation
+    h.fwdSeed(0).set([1,0])
+    h.fwdSeed(1).setAll(0)
+    g.fwdSeed(0).set([1,0])
+    g.fwdSeed(1).setAll(0)
+    h.evaluate(1,0)
+    g.evaluate(1,0)
+    self.checkarray(h.fwdSens(1),g.fwdSens(1),"incremental evaluation")
+
+  def test_parallel_evaluation(self):
+    self.message("Concurrent evaluation of independent calls in MXFunction")
+    x = ssym("x",2)
+    f = SXFunction([x],[sin(x)*x[0]])
+    f.init()
+    X = msym("X",2,3)
+    y = [f.call([f.call([X[:,j]])[0]*2])[0] for j in range(3)]
+    out = [y[0]+y[1]*y[2], exp(X)]
+    g = MXFunction([X],out)
+    h = MXFunction([X],out)
+    h.setOption("parallel_evaluation",True)
+    h.setOption("num_threads",2)
+    h.setOption("gather_stats",True)
+    for fcn in [g,h]:
+      fcn.setOption("number_of_fwd_dir",1)
+      fcn.setOption("number_of_adj_dir",1)
+      fcn.init()
+      fcn.input(0).set(range(6))
+      fcn.fwdSeed(0).set([1,0,0,2,0,1])
+      fcn.adjSeed(0).set([1,2])
+      fcn.adjSeed(1).setAll(0)
+      fcn.evaluate(1,1)
+    for i in range(2):
+      self.checkarray(h.output(i),g.output(i),"parallel evaluation")
+      self.checkarray(h.fwdSens(i),g.fwdSens(i),"parallel evaluation")
+    self.checkarray(h.adjSens(0),g.adjSens(0),"parallel evaluation")
+    self.assertTrue(h.getStats()["num_parallel_levels"]>0)
+
+  def test_parallel_evaluation_shared(self):
+    self.message("Concurrent evaluation of different functions embedding the same function")
+    a = msym("a",20)
+    b = a
+    for k in range(10):
+      b = sin(b)*a+b
+    f = MXFunction([a],[b])
+    f.init()
+    wrappers = []
+    for i in range(2):
+      u = msym("u",20)
+      w = MXFunction([u],[f.call([u*(i+1)])[0]+i])
+      w.init()
+      wrappers.append(w)
+    X = msym("X",20)
+    out = [w.call([X])[0] for w in wrappers]
+    g = MXFunction([X],out)
+    h = MXFunction([X],out)
+    h.setOption("parallel_evaluation",True)
+    h.setOption("num_threads",2)
+    h.setOption("gather_stats",True)
+    for fcn in [g,h]:
+      fcn.init()
+    for r in range(50):
+      for fcn in [g,h]:
+        fcn.input(0).set([0.01*r]*20)
+        fcn.evaluate()
+      for i in range(2):
+        self.checkarray(h.output(i),g.output(i),"parallel evaluation, shared function")
+    self.assertTrue(h.getStats()["num_parallel_levels"]>0)
+
 if __name__ == '__main__':
     unittest.main()
 
@@ -423,6 +423,36 @@ class Simulatortests(casadiTestCase):
 
     self.assertAlmostEqual(sim.output()[-1],q0*exp((tend**3-0.7**3)/(3*p)),9,"Evaluation output mismatch")
     
+  def test_simulator_dormand_prince(self):
+    self.message("Dormand-Prince integration: simulator with dense output")
+    num=self.num
+    tc = DMatrix(n.linspace(0,num['tend'],100))
+    integrator = DormandPrinceIntegrator(self.f)
+    integrator.setOption("reltol",1e-12)
+    integrator.setOption("abstol",1e-12)
+    integrator.setOption("t0",0)
+    integrator.setOption("tf",2.3)
+    integrator.init()
+    sim = Simulator(integrator,tc)
+    sim.init()
+    sim.input(0).set([num['q0']])
+    sim.input(1).set([num['p']])
+    sim.evaluate()
+    
+    self.checkarray(sim.output(),num['q0']*exp(tc**3/(3*num['p'])),"Evaluation output mismatch",digits=7)
+    self.assertTrue(integrator.getStats()["num_steps"]<100)
+    
+    # Forward sensitivities integrated along with the states
+    integrator.setOption("fwd_via_sct",False)
+    integrator.init()
+    integrator.input(0).set([num['q0']])
+    integrator.input(1).set([num['p']])
+    integrator.fwdSeed(0).set(0)
+    integrator.fwdSeed(1).set(1)
+    integrator.evaluate(1,0)
+    tend=num['tend']
+    qend = num['q0']*exp(tend**3/(3*num['p']))
+    self.assertAlmostEqual(integrator.fwdSens()[0],-qend*tend**3/(3*num['p']**2),7,"Forward sensitivity mismatch")
     
   def test_simulator_sensitivities(self):
     self.message("Forward sensitivities")
@@ -1000,6 +1000,59 @@ class SXtests(casadiTestCase):
     f.init()
     h = f.hessian()
 
+  def test_evaluateBatch(self):
+    self.message("Evaluation at multiple points")
+    x = ssym('x',2)
+    y = ssym('y')
+    f = SXFunction([x,y],[vertcat([sin(x[0])*y,x[1]**2+x[0]]),y*3])
+    f.init()
+    N = 100
+    X = DMatrix([[0.01*p for p in range(N)],[1-0.02*p for p in range(N)]])
+    Y = DMatrix([[p for p in range(N)]])
+    res = f.evaluateBatch([X,Y])
+    for p in range(N):
+      f.input(0).set(X[:,p])
+      f.input(1).set(Y[:,p])
+      f.evaluate()
+      self.checkarray(f.output(0),res[0][:,p],"evaluateBatch")
+      self.checkarray(f.output(1),res[1][:,p],"evaluateBatch")
+
+  def test_threaded_interpreter(self):
+    self.message("Threaded interpreter")
+    x = ssym('x',3)
+    y = ssym('y')
+    r = [vertcat([x[0]*x[1]+y,sin(x[2])*y+x[0]*x[0],fmax(x[1],y)-3]),x[2]*y]
+    f = SXFunction([x,y],r)
+    f.init()
+    g = SXFunction([x,y],r)
+    g.setOption("interpreter","threaded")
+    g.init()
+    for fcn in [f,g]:
+      fcn.input(0).set([0.3,-1.2,2.5])
+      fcn.input(1).set(0.7)
+    self.checkfx(g,f,hessian=False)
+
+  def test_just_in_time_c(self):
+    self.message("Just-in-time compilation with the system C compiler")
+    x = ssym('x',3)
+    y = ssym('y')
+    r = [vertcat([x[0]*x[1]+y,sin(x[2])*y+x[0]*x[0],fmax(x[1],y)-3]),x[2]*y]
+    f = SXFunction([x,y],r)
+    f.init()
+    g = SXFunction([x,y],r)
+    g.setOption("just_in_time_c",True)
+    try:
+      g.init()
+    except Exception as e:
+      # Only a build without WITH_DL is a reason to skip, compilation or loading errors are failures
+      if "WITH_DL" not in str(e): raise
+      self.message("skipped, WITH_DL not available")
+      return
+    for fcn in [f,g]:
+      fcn.input(0).set([0.3,-1.2,2.5])
+      fcn.input(1).set(0.7)
+    self.checkfx(g,f,hessian=False)
+
 if __name__ == '__main__':
     unittest.main()
 